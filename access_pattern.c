@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "access_pattern.h"
+#include "bench.h"
+#include "topology.h"
+
+#define HUGE_PAGE_BYTES (2 * 1024 * 1024)  // Block of the 2m-random pattern
+#define SMALL_PAGE_BYTES 4096              // Block of the page-random pattern
+
+static size_t gcd(size_t a, size_t b) {
+    while (b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Shuffle lines[first .. first + n) in place (Fisher-Yates)
+static void shuffle(uint32_t *lines, size_t first, size_t n) {
+    for (size_t i = n - 1; i > 0 && n > 1; i--) {
+        size_t j = bench_random_index(i + 1);
+        uint32_t tmp = lines[first + i];
+        lines[first + i] = lines[first + j];
+        lines[first + j] = tmp;
+    }
+}
+
+int pattern_parse(const char *spec, access_pattern_t *pattern) {
+    const char *arg = strchr(spec, ':');
+    size_t len = arg ? (size_t)(arg - spec) : strlen(spec);
+
+    memset(pattern, 0, sizeof(*pattern));
+    snprintf(pattern->name, sizeof(pattern->name), "%s", spec);
+    pattern->zipf_s = PATTERN_ZIPF_S;
+    if (arg) {
+        arg++;
+    }
+
+    if (len == 3 && strncmp(spec, "seq", len) == 0) {
+        pattern->kind = PATTERN_SEQ;
+    } else if (len == 8 && strncmp(spec, "seq-back", len) == 0) {
+        pattern->kind = PATTERN_SEQ_BACK;
+    } else if (len == 6 && strncmp(spec, "stride", len) == 0 && arg) {
+        pattern->kind = PATTERN_STRIDE;
+        pattern->stride = bench_parse_size(arg);
+    } else if (len == 11 && strncmp(spec, "page-random", len) == 0) {
+        pattern->kind = PATTERN_BLOCK_RANDOM;
+        pattern->stride = SMALL_PAGE_BYTES;
+    } else if (len == 9 && strncmp(spec, "2m-random", len) == 0) {
+        pattern->kind = PATTERN_BLOCK_RANDOM;
+        pattern->stride = HUGE_PAGE_BYTES;
+    } else if (len == 12 && strncmp(spec, "block-random", len) == 0 && arg) {
+        pattern->kind = PATTERN_BLOCK_RANDOM;
+        pattern->stride = bench_parse_size(arg);
+    } else if (len == 6 && strncmp(spec, "random", len) == 0) {
+        pattern->kind = PATTERN_RANDOM;
+    } else if (len == 4 && strncmp(spec, "zipf", len) == 0) {
+        pattern->kind = PATTERN_ZIPF;
+        if (arg) {
+            pattern->zipf_s = atof(arg);
+        }
+        return pattern->zipf_s > 0 ? 0 : -1;
+    } else {
+        return -1;
+    }
+    if ((pattern->kind == PATTERN_STRIDE || pattern->kind == PATTERN_BLOCK_RANDOM) && pattern->stride == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int pattern_parse_list(const char *list, access_pattern_t *patterns, int max_patterns) {
+    char buf[512];
+    int n = 0;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *save, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (n == max_patterns || pattern_parse(tok, &patterns[n]) != 0) {
+            return -1;
+        }
+        n++;
+    }
+    return n;
+}
+
+void pattern_build(const access_pattern_t *pattern, size_t size, size_t line_size, pattern_schedule_t *sched) {
+    size_t n = size / line_size;
+    size_t count = n;
+
+    sched->line_size = line_size;
+    sched->lines = (uint32_t *) malloc(count * sizeof(uint32_t));
+    if (!sched->lines) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    sched->count = count;
+
+    switch (pattern->kind) {
+    case PATTERN_SEQ:
+        for (size_t i = 0; i < n; i++) {
+            sched->lines[i] = (uint32_t)i;
+        }
+        break;
+    case PATTERN_SEQ_BACK:
+        for (size_t i = 0; i < n; i++) {
+            sched->lines[i] = (uint32_t)(n - 1 - i);
+        }
+        break;
+    case PATTERN_STRIDE: {
+        // A stride of k lines visits lines 0, k, 2k, ..., then 1, k+1, ..., so every line is
+        // touched once per pass and the working set does not shrink with the stride
+        size_t step = pattern->stride > line_size ? pattern->stride / line_size : 1;
+        size_t i = 0;
+        for (size_t phase = 0; phase < step && phase < n; phase++) {
+            for (size_t line = phase; line < n; line += step) {
+                sched->lines[i++] = (uint32_t)line;
+            }
+        }
+        break;
+    }
+    case PATTERN_BLOCK_RANDOM: {
+        size_t block = pattern->stride > line_size ? pattern->stride / line_size : 1;
+        for (size_t i = 0; i < n; i++) {
+            sched->lines[i] = (uint32_t)i;
+        }
+        for (size_t first = 0; first < n; first += block) {
+            shuffle(sched->lines, first, first + block <= n ? block : n - first);
+        }
+        break;
+    }
+    case PATTERN_RANDOM:
+        for (size_t i = 0; i < n; i++) {
+            sched->lines[i] = (uint32_t)i;
+        }
+        shuffle(sched->lines, 0, n);
+        break;
+    case PATTERN_ZIPF: {
+        // Ranks from the continuous bounded power law, which tracks the discrete Zipf
+        // distribution closely without an n-entry CDF table. Rank r is mapped to line
+        // (r * mult) mod n with mult coprime to n, so hot lines are spread over the buffer.
+        double s = pattern->zipf_s;
+        size_t mult = 2654435761u % n | 1;
+        while (gcd(mult, n) != 1) {
+            mult += 2;
+        }
+        for (size_t i = 0; i < count; i++) {
+            double u = bench_random_unit();
+            double r = fabs(s - 1.0) < 1e-9 ? pow((double)n, u)
+                                            : pow((pow((double)n, 1.0 - s) - 1.0) * u + 1.0, 1.0 / (1.0 - s));
+            size_t rank = (size_t)r - 1;
+            if (rank >= n) {
+                rank = n - 1;
+            }
+            sched->lines[i] = (uint32_t)(rank * mult % n);
+        }
+        break;
+    }
+    }
+}
+
+void pattern_free(pattern_schedule_t *sched) {
+    free(sched->lines);
+    sched->lines = NULL;
+    sched->count = 0;
+}
+
+// Dependent loads: the address of each load includes the value of the previous one, which
+// is always zero, so the loads cannot overlap. The schedule reads are independent of them.
+static uint64_t walk_dependent(const char *base, const uint32_t *lines, size_t count, size_t line_size,
+                               long accesses, size_t *pos) {
+    uint64_t x = 0;
+    size_t i = *pos;
+
+    for (long a = 0; a < accesses; a++) {
+        x = *(const uint64_t *)(base + (size_t)lines[i] * line_size + x);
+        if (++i == count) {
+            i = 0;
+        }
+    }
+    *pos = i;
+    return x;
+}
+
+// Independent loads, free to overlap as far as the core and prefetchers allow
+static uint64_t walk_independent(const char *base, const uint32_t *lines, size_t count, size_t line_size,
+                                 long accesses, size_t *pos) {
+    uint64_t sum = 0;
+    size_t i = *pos;
+
+    for (long a = 0; a < accesses; a++) {
+        sum += *(const uint64_t *)(base + (size_t)lines[i] * line_size);
+        if (++i == count) {
+            i = 0;
+        }
+    }
+    *pos = i;
+    return sum;
+}
+
+double pattern_walk_trial(void *arg) {
+    pattern_walk_t *w = (pattern_walk_t *)arg;
+    const pattern_schedule_t *s = w->sched;
+    perf_counters_t *pc = get_perf_counters();
+    struct timespec start, end;
+
+    perf_counters_start(pc);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (w->dependent) {
+        w->sink += walk_dependent(w->base, s->lines, s->count, s->line_size, w->accesses, &w->pos);
+    } else {
+        w->sink += walk_independent(w->base, s->lines, s->count, s->line_size, w->accesses, &w->pos);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, &w->counters);
+
+    return measure_elapsed_ns(&start, &end) / (double)w->accesses;
+}
+
+double pattern_measure(const access_pattern_t *pattern, const char *buffer, size_t size, long accesses,
+                       int dependent, int max_trials, measure_stats_t *stats, perf_sample_t *counters) {
+    pattern_schedule_t sched;
+    pattern_walk_t walk;
+    measure_config_t cfg;
+
+    pattern_build(pattern, size, get_topology()->line_size, &sched);
+    memset(&walk, 0, sizeof(walk));
+    walk.base = buffer;
+    walk.sched = &sched;
+    walk.accesses = accesses;
+    walk.dependent = dependent;
+
+    // The warmup trials also leave the working set resident at the level under test
+    measure_config_default(&cfg, max_trials);
+    measure_run(&cfg, pattern_walk_trial, &walk, stats);
+
+    *counters = walk.counters;
+    pattern_free(&sched);
+    return stats->median;
+}
@@ -0,0 +1,74 @@
+#ifndef ACCESS_PATTERN_H
+#define ACCESS_PATTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "perf_counters.h"
+#include "measure.h"
+
+#define PATTERN_MAX 32                // Upper bound on patterns in one list
+#define PATTERN_ZIPF_S 0.99           // Default Zipf exponent (YCSB's hot/cold skew)
+
+// Patterns run when none are given: sequential, prefetcher-sized strides, page- and
+// huge-page-local random, fully random and skewed
+#define PATTERN_DEFAULT_LIST "seq,seq-back,stride:256,stride:1K,stride:4K,page-random,2m-random,random,zipf"
+
+// Order in which the cache lines of a buffer are visited
+typedef enum {
+    PATTERN_SEQ,                      // Lines in ascending order
+    PATTERN_SEQ_BACK,                 // Lines in descending order
+    PATTERN_STRIDE,                   // Every 'stride' bytes, one pass per line offset within the stride
+    PATTERN_BLOCK_RANDOM,             // Blocks of 'stride' bytes in order, lines shuffled within each block
+    PATTERN_RANDOM,                   // All lines shuffled
+    PATTERN_ZIPF                      // Lines drawn with Zipf(zipf_s) popularity, hot lines scattered
+} pattern_kind_t;
+
+typedef struct {
+    char name[32];                    // Spec it was parsed from, e.g. "stride:256"
+    pattern_kind_t kind;
+    size_t stride;                    // Stride or block size in bytes
+    double zipf_s;                    // Zipf exponent
+} access_pattern_t;
+
+// Precomputed visiting order: 'count' line indices into the buffer, walked cyclically
+typedef struct {
+    uint32_t *lines;
+    size_t count;
+    size_t line_size;
+} pattern_schedule_t;
+
+// State of one repeated walk over a schedule, usable as a measure_run() trial
+typedef struct {
+    const char *base;                 // Buffer the schedule indexes; must be zeroed for dependent walks
+    const pattern_schedule_t *sched;
+    long accesses;                    // Loads per trial
+    int dependent;                    // 1: each load's address depends on the previous load
+    size_t pos;                       // Where the next trial continues in the schedule
+    uint64_t sink;                    // Keeps the loaded values live
+    perf_sample_t counters;           // Counters over the last trial
+} pattern_walk_t;
+
+// Parse one spec: seq, seq-back, stride:<bytes>, page-random, 2m-random, block-random:<bytes>,
+// random or zipf[:<s>]. Sizes accept K/M/G suffixes. Returns 0 on success.
+int pattern_parse(const char *spec, access_pattern_t *pattern);
+
+// Parse a comma-separated list of specs; returns how many were parsed, or -1 on a bad spec
+int pattern_parse_list(const char *list, access_pattern_t *patterns, int max_patterns);
+
+// Build the visiting order of a pattern over 'size' bytes of 'line_size'-byte lines
+void pattern_build(const access_pattern_t *pattern, size_t size, size_t line_size, pattern_schedule_t *sched);
+
+void pattern_free(pattern_schedule_t *sched);
+
+// Function to time one trial of walk->accesses loads, returning ns per load. Dependent walks
+// add each loaded (zero) value to the next address, so they measure latency; independent
+// walks let loads overlap and measure throughput.
+double pattern_walk_trial(void *arg);
+
+// Function to walk a pattern over the first 'size' bytes of a zeroed buffer until the time
+// per load converges; returns the median ns per load
+double pattern_measure(const access_pattern_t *pattern, const char *buffer, size_t size, long accesses,
+                       int dependent, int max_trials, measure_stats_t *stats, perf_sample_t *counters);
+
+#endif
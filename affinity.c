@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "affinity.h"
+#include "topology.h"
+
+int get_allowed_cpus(int *cpus, int max_cpus) {
+    cpu_set_t set;
+    int n = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        perror("sched_getaffinity");
+        exit(EXIT_FAILURE);
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < max_cpus; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus[n++] = cpu;
+        }
+    }
+    return n;
+}
+
+int pin_thread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int save_thread_affinity(cpu_mask_t *mask) {
+    return pthread_getaffinity_np(pthread_self(), sizeof(mask->bits), (cpu_set_t *)mask->bits);
+}
+
+int restore_thread_affinity(const cpu_mask_t *mask) {
+    return pthread_setaffinity_np(pthread_self(), sizeof(mask->bits), (const cpu_set_t *)mask->bits);
+}
+
+static const char *placement_names[PLACE_NUM_POLICIES] = {"allowed", "compact", "scatter", "smt", "llc", "list"};
+
+// One allowed CPU with its sort key for a placement
+typedef struct {
+    int cpu;
+    cpu_location_t loc;
+    int sibling;            // Index among the allowed SMT siblings of its core
+    int num_siblings;       // Allowed SMT siblings of its core, itself included
+    int core_rank;          // Index of its core among the cores of its LLC domain
+    int llc_rank;           // Index of its LLC domain
+    int key[3];
+} place_info_t;
+
+static int same_core(const cpu_location_t *a, const cpu_location_t *b) {
+    return a->package == b->package && a->die == b->die && a->core >= 0 && a->core == b->core;
+}
+
+static int compare_place(const void *a, const void *b) {
+    const place_info_t *pa = (const place_info_t *)a;
+    const place_info_t *pb = (const place_info_t *)b;
+    for (int k = 0; k < 3; k++) {
+        if (pa->key[k] != pb->key[k]) {
+            return pa->key[k] < pb->key[k] ? -1 : 1;
+        }
+    }
+    return pa->cpu - pb->cpu;
+}
+
+// Function to parse a CPU list such as "0,2,8-11", accepting only allowed CPUs
+static int parse_cpu_list(const char *list, const int *allowed, int num_allowed, int *cpus, int max_cpus) {
+    const char *s = list;
+    int n = 0;
+
+    while (*s) {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if (end == s) {
+            fprintf(stderr, "Invalid CPU list '%s'\n", list);
+            return -1;
+        }
+        if (*end == '-') {
+            s = end + 1;
+            last = strtol(s, &end, 10);
+            if (end == s || last < first) {
+                fprintf(stderr, "Invalid CPU list '%s'\n", list);
+                return -1;
+            }
+        }
+        for (long cpu = first; cpu <= last && n < max_cpus; cpu++) {
+            int found = 0;
+            for (int i = 0; i < num_allowed; i++) {
+                found |= allowed[i] == cpu;
+            }
+            if (!found) {
+                fprintf(stderr, "CPU %ld is not in the allowed set\n", cpu);
+                return -1;
+            }
+            cpus[n++] = (int)cpu;
+        }
+        s = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            fprintf(stderr, "Invalid CPU list '%s'\n", list);
+            return -1;
+        }
+    }
+    return n;
+}
+
+int get_placement_cpus(const char *placement, int *cpus, int max_cpus) {
+    static int allowed[PLACE_MAX_CPUS];
+    static place_info_t info[PLACE_MAX_CPUS];
+    int num_allowed = get_allowed_cpus(allowed, PLACE_MAX_CPUS);
+    placement_t policy = PLACE_LIST;
+    int num_cores = 0, num_llcs = 0, n = 0;
+
+    for (int p = 0; p < PLACE_LIST; p++) {
+        if (strcmp(placement, placement_names[p]) == 0) {
+            policy = (placement_t)p;
+        }
+    }
+    if (policy == PLACE_LIST) {
+        if (!isdigit((unsigned char)placement[0])) {
+            fprintf(stderr, "Unknown placement '%s' (allowed, compact, scatter, smt, llc or a CPU list)\n", placement);
+            return -1;
+        }
+        return parse_cpu_list(placement, allowed, num_allowed, cpus, max_cpus);
+    }
+
+    // Rank every CPU within its core and every core within its LLC domain, in CPU order
+    for (int i = 0; i < num_allowed; i++) {
+        place_info_t *p = &info[i];
+        p->cpu = allowed[i];
+        get_cpu_location(p->cpu, &p->loc);
+        p->sibling = 0;
+        p->num_siblings = 1;
+        p->core_rank = -1;
+        p->llc_rank = -1;
+        for (int j = 0; j < i; j++) {
+            if (same_core(&info[j].loc, &p->loc)) {
+                p->sibling++;
+                p->core_rank = info[j].core_rank;
+                info[j].num_siblings++;
+            }
+            if (info[j].loc.llc == p->loc.llc) {
+                p->llc_rank = info[j].llc_rank;
+            }
+        }
+        if (p->llc_rank < 0) {
+            p->llc_rank = num_llcs++;
+        }
+        if (p->core_rank < 0) {
+            p->core_rank = 0;
+            for (int j = 0; j < i; j++) {
+                if (info[j].loc.llc == p->loc.llc && info[j].sibling == 0) {
+                    p->core_rank++;
+                }
+            }
+            num_cores++;
+        }
+    }
+    for (int i = 0; i < num_allowed; i++) {
+        for (int j = 0; j < num_allowed; j++) {
+            if (j != i && same_core(&info[j].loc, &info[i].loc)) {
+                info[i].num_siblings = info[j].num_siblings > info[i].num_siblings ? info[j].num_siblings
+                                                                                    : info[i].num_siblings;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_allowed; i++) {
+        place_info_t *p = &info[i];
+        int keep = 1;
+        switch (policy) {
+            case PLACE_COMPACT:
+            case PLACE_SMT:
+                keep = policy == PLACE_COMPACT || p->num_siblings > 1;
+                p->key[0] = p->llc_rank; p->key[1] = p->core_rank; p->key[2] = p->sibling;
+                break;
+            case PLACE_SCATTER:
+                p->key[0] = p->sibling; p->key[1] = p->core_rank; p->key[2] = p->llc_rank;
+                break;
+            case PLACE_LLC:
+                keep = p->sibling == 0 && p->core_rank == 0;
+                p->key[0] = p->llc_rank; p->key[1] = 0; p->key[2] = 0;
+                break;
+            default:
+                p->key[0] = p->key[1] = p->key[2] = 0;
+                break;
+        }
+        if (keep) {
+            info[n++] = *p;
+        }
+    }
+    qsort(info, n, sizeof(place_info_t), compare_place);
+    if (n == 0) {
+        fprintf(stderr, "Placement '%s' has no CPUs on this host (%d core(s), %d LLC domain(s))\n", placement,
+                num_cores, num_llcs);
+        return -1;
+    }
+
+    if (n > max_cpus) {
+        n = max_cpus;
+    }
+    for (int i = 0; i < n; i++) {
+        cpus[i] = info[i].cpu;
+    }
+    return n;
+}
+
+void placement_spread(const int *cpus, int num_cpus, int *cores, int *llcs) {
+    cpu_location_t locs[PLACE_MAX_CPUS];
+
+    *cores = 0;
+    *llcs = 0;
+    for (int i = 0; i < num_cpus && i < PLACE_MAX_CPUS; i++) {
+        int new_core = 1, new_llc = 1;
+        get_cpu_location(cpus[i], &locs[i]);
+        for (int j = 0; j < i; j++) {
+            if (same_core(&locs[j], &locs[i]) || cpus[j] == cpus[i]) {
+                new_core = 0;
+            }
+            if (locs[j].llc == locs[i].llc) {
+                new_llc = 0;
+            }
+        }
+        *cores += new_core;
+        *llcs += new_llc;
+    }
+}
+
+void placement_write_header(FILE *out, const char *placement, const int *cpus, int num_cpus) {
+    int cores, llcs;
+
+    placement_spread(cpus, num_cpus, &cores, &llcs);
+    fprintf(out, "# Placement: %s, CPUs", placement);
+    for (int i = 0; i < num_cpus; i++) {
+        fprintf(out, "%s%d", i ? "," : " ", cpus[i]);
+    }
+    fprintf(out, " (%d core(s), %d LLC domain(s))\n", cores, llcs);
+}
@@ -0,0 +1,47 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdio.h>
+
+#define PLACE_MAX_CPUS 1024     // Allowed CPUs considered by a placement
+
+// Order in which threads are placed on the allowed CPUs (the 'placement' parameter)
+typedef enum {
+    PLACE_ALLOWED,     // Ascending CPU numbers, as the OS enumerates them
+    PLACE_COMPACT,     // Every SMT sibling of a core, then the next core of the LLC domain, then the next domain
+    PLACE_SCATTER,     // One thread per physical core, round-robin over LLC domains, then the second siblings
+    PLACE_SMT,         // Only cores with two or more allowed siblings, filled sibling by sibling
+    PLACE_LLC,         // One CPU per last-level-cache domain (L3 / CCX)
+    PLACE_LIST,        // An explicit CPU list such as "0,2,8-11"
+    PLACE_NUM_POLICIES
+} placement_t;
+
+// Collect the CPUs this process may run on, in ascending order; returns how many
+int get_allowed_cpus(int *cpus, int max_cpus);
+
+// Pin the calling thread to one CPU; returns 0 on success
+int pin_thread(int cpu);
+
+// A thread's CPU mask, saved before pinning the thread so it can be put back
+typedef struct {
+    unsigned long bits[PLACE_MAX_CPUS / (8 * sizeof(unsigned long))];
+} cpu_mask_t;
+
+// Save or restore the calling thread's CPU mask; return 0 on success
+int save_thread_affinity(cpu_mask_t *mask);
+int restore_thread_affinity(const cpu_mask_t *mask);
+
+// Order the allowed CPUs by a placement, given as a policy name (allowed, compact, scatter,
+// smt, llc) or a CPU list, using the SMT sibling, die and LLC layout from sysfs. Thread i
+// belongs on cpus[i]; a policy may offer fewer CPUs than there are allowed (smt, llc).
+// Returns how many CPUs it offers, or -1 after reporting an unknown policy, a CPU outside
+// the allowed set or a policy with no CPUs on this host.
+int get_placement_cpus(const char *placement, int *cpus, int max_cpus);
+
+// Physical cores and LLC domains covered by the first 'num_cpus' CPUs
+void placement_spread(const int *cpus, int num_cpus, int *cores, int *llcs);
+
+// Write a placement as a '#'-prefixed comment line with the CPUs in thread order
+void placement_write_header(FILE *out, const char *placement, const int *cpus, int num_cpus);
+
+#endif
@@ -0,0 +1,634 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "bandwidth_kernels.h"
+
+#define TRIAD_SCALAR 3.0  // Scalar multiplier used by the triad kernels
+
+// Kernels are compiled per instruction set with target attributes so the binary runs on
+// any x86-64 host; the scalar ones are kept from being auto-vectorized.
+#define SCALAR_KERNEL __attribute__((optimize("no-tree-vectorize")))
+#define SSE_KERNEL __attribute__((target("sse2")))
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#define AVX512_KERNEL __attribute__((target("avx512f")))
+
+// ---------------------------------------------------------------- scalar
+
+SCALAR_KERNEL static double scalar_read(void *dst, const void *src1, const void *src2, size_t bytes) {
+    const uint64_t *a = (const uint64_t *)src1;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    (void)dst; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i += 4) {
+        s0 += a[i];
+        s1 += a[i + 1];
+        s2 += a[i + 2];
+        s3 += a[i + 3];
+    }
+    return (double)(s0 + s1 + s2 + s3);
+}
+
+SCALAR_KERNEL static double scalar_write(void *dst, const void *src1, const void *src2, size_t bytes) {
+    uint64_t *a = (uint64_t *)dst;
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i += 4) {
+        a[i] = i;
+        a[i + 1] = i;
+        a[i + 2] = i;
+        a[i + 3] = i;
+    }
+    return 0.0;
+}
+
+SCALAR_KERNEL static double scalar_write_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    long long *a = (long long *)dst;
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(long long); i += 4) {
+        _mm_stream_si64(&a[i], (long long)i);
+        _mm_stream_si64(&a[i + 1], (long long)i);
+        _mm_stream_si64(&a[i + 2], (long long)i);
+        _mm_stream_si64(&a[i + 3], (long long)i);
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+SCALAR_KERNEL static double scalar_copy(void *dst, const void *src1, const void *src2, size_t bytes) {
+    uint64_t *a = (uint64_t *)dst;
+    const uint64_t *b = (const uint64_t *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i += 4) {
+        a[i] = b[i];
+        a[i + 1] = b[i + 1];
+        a[i + 2] = b[i + 2];
+        a[i + 3] = b[i + 3];
+    }
+    return 0.0;
+}
+
+SCALAR_KERNEL static double scalar_copy_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    long long *a = (long long *)dst;
+    const long long *b = (const long long *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(long long); i += 4) {
+        _mm_stream_si64(&a[i], b[i]);
+        _mm_stream_si64(&a[i + 1], b[i + 1]);
+        _mm_stream_si64(&a[i + 2], b[i + 2]);
+        _mm_stream_si64(&a[i + 3], b[i + 3]);
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+SCALAR_KERNEL static double scalar_triad(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    for (size_t i = 0; i < bytes / sizeof(double); i += 4) {
+        a[i] = b[i] + TRIAD_SCALAR * c[i];
+        a[i + 1] = b[i + 1] + TRIAD_SCALAR * c[i + 1];
+        a[i + 2] = b[i + 2] + TRIAD_SCALAR * c[i + 2];
+        a[i + 3] = b[i + 3] + TRIAD_SCALAR * c[i + 3];
+    }
+    return 0.0;
+}
+
+SCALAR_KERNEL static double scalar_triad_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    long long *a = (long long *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    for (size_t i = 0; i < bytes / sizeof(double); i++) {
+        union { double d; long long ll; } v = { b[i] + TRIAD_SCALAR * c[i] };
+        _mm_stream_si64(&a[i], v.ll);
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+// ---------------------------------------------------------------- SSE
+
+SSE_KERNEL static double sse_read(void *dst, const void *src1, const void *src2, size_t bytes) {
+    const __m128i *a = (const __m128i *)src1;
+    __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+    (void)dst; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m128i); i += 4) {
+        s0 = _mm_add_epi64(s0, _mm_load_si128(&a[i]));
+        s1 = _mm_add_epi64(s1, _mm_load_si128(&a[i + 1]));
+        s2 = _mm_add_epi64(s2, _mm_load_si128(&a[i + 2]));
+        s3 = _mm_add_epi64(s3, _mm_load_si128(&a[i + 3]));
+    }
+    __m128i s = _mm_add_epi64(_mm_add_epi64(s0, s1), _mm_add_epi64(s2, s3));
+    return (double)(_mm_cvtsi128_si64(s) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(s, s)));
+}
+
+SSE_KERNEL static double sse_write(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m128i *a = (__m128i *)dst;
+    __m128i v = _mm_set1_epi64x(1);
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m128i); i += 4) {
+        _mm_store_si128(&a[i], v);
+        _mm_store_si128(&a[i + 1], v);
+        _mm_store_si128(&a[i + 2], v);
+        _mm_store_si128(&a[i + 3], v);
+    }
+    return 0.0;
+}
+
+SSE_KERNEL static double sse_write_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m128i *a = (__m128i *)dst;
+    __m128i v = _mm_set1_epi64x(1);
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m128i); i += 4) {
+        _mm_stream_si128(&a[i], v);
+        _mm_stream_si128(&a[i + 1], v);
+        _mm_stream_si128(&a[i + 2], v);
+        _mm_stream_si128(&a[i + 3], v);
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+SSE_KERNEL static double sse_copy(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m128i *a = (__m128i *)dst;
+    const __m128i *b = (const __m128i *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m128i); i += 4) {
+        _mm_store_si128(&a[i], _mm_load_si128(&b[i]));
+        _mm_store_si128(&a[i + 1], _mm_load_si128(&b[i + 1]));
+        _mm_store_si128(&a[i + 2], _mm_load_si128(&b[i + 2]));
+        _mm_store_si128(&a[i + 3], _mm_load_si128(&b[i + 3]));
+    }
+    return 0.0;
+}
+
+SSE_KERNEL static double sse_copy_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m128i *a = (__m128i *)dst;
+    const __m128i *b = (const __m128i *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m128i); i += 4) {
+        _mm_stream_si128(&a[i], _mm_load_si128(&b[i]));
+        _mm_stream_si128(&a[i + 1], _mm_load_si128(&b[i + 1]));
+        _mm_stream_si128(&a[i + 2], _mm_load_si128(&b[i + 2]));
+        _mm_stream_si128(&a[i + 3], _mm_load_si128(&b[i + 3]));
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+SSE_KERNEL static double sse_triad(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    __m128d s = _mm_set1_pd(TRIAD_SCALAR);
+    for (size_t i = 0; i < bytes / sizeof(double); i += 4) {
+        _mm_store_pd(&a[i], _mm_add_pd(_mm_load_pd(&b[i]), _mm_mul_pd(s, _mm_load_pd(&c[i]))));
+        _mm_store_pd(&a[i + 2], _mm_add_pd(_mm_load_pd(&b[i + 2]), _mm_mul_pd(s, _mm_load_pd(&c[i + 2]))));
+    }
+    return 0.0;
+}
+
+SSE_KERNEL static double sse_triad_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    __m128d s = _mm_set1_pd(TRIAD_SCALAR);
+    for (size_t i = 0; i < bytes / sizeof(double); i += 4) {
+        _mm_stream_pd(&a[i], _mm_add_pd(_mm_load_pd(&b[i]), _mm_mul_pd(s, _mm_load_pd(&c[i]))));
+        _mm_stream_pd(&a[i + 2], _mm_add_pd(_mm_load_pd(&b[i + 2]), _mm_mul_pd(s, _mm_load_pd(&c[i + 2]))));
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+// ---------------------------------------------------------------- AVX2
+
+AVX2_KERNEL static double avx2_read(void *dst, const void *src1, const void *src2, size_t bytes) {
+    const __m256i *a = (const __m256i *)src1;
+    __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+    (void)dst; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m256i); i += 4) {
+        s0 = _mm256_add_epi64(s0, _mm256_load_si256(&a[i]));
+        s1 = _mm256_add_epi64(s1, _mm256_load_si256(&a[i + 1]));
+        s2 = _mm256_add_epi64(s2, _mm256_load_si256(&a[i + 2]));
+        s3 = _mm256_add_epi64(s3, _mm256_load_si256(&a[i + 3]));
+    }
+    __m256i s = _mm256_add_epi64(_mm256_add_epi64(s0, s1), _mm256_add_epi64(s2, s3));
+    return (double)(_mm256_extract_epi64(s, 0) + _mm256_extract_epi64(s, 1) +
+                    _mm256_extract_epi64(s, 2) + _mm256_extract_epi64(s, 3));
+}
+
+AVX2_KERNEL static double avx2_write(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m256i *a = (__m256i *)dst;
+    __m256i v = _mm256_set1_epi64x(1);
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m256i); i += 4) {
+        _mm256_store_si256(&a[i], v);
+        _mm256_store_si256(&a[i + 1], v);
+        _mm256_store_si256(&a[i + 2], v);
+        _mm256_store_si256(&a[i + 3], v);
+    }
+    return 0.0;
+}
+
+AVX2_KERNEL static double avx2_write_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m256i *a = (__m256i *)dst;
+    __m256i v = _mm256_set1_epi64x(1);
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m256i); i += 4) {
+        _mm256_stream_si256(&a[i], v);
+        _mm256_stream_si256(&a[i + 1], v);
+        _mm256_stream_si256(&a[i + 2], v);
+        _mm256_stream_si256(&a[i + 3], v);
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+AVX2_KERNEL static double avx2_copy(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m256i *a = (__m256i *)dst;
+    const __m256i *b = (const __m256i *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m256i); i += 4) {
+        _mm256_store_si256(&a[i], _mm256_load_si256(&b[i]));
+        _mm256_store_si256(&a[i + 1], _mm256_load_si256(&b[i + 1]));
+        _mm256_store_si256(&a[i + 2], _mm256_load_si256(&b[i + 2]));
+        _mm256_store_si256(&a[i + 3], _mm256_load_si256(&b[i + 3]));
+    }
+    return 0.0;
+}
+
+AVX2_KERNEL static double avx2_copy_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m256i *a = (__m256i *)dst;
+    const __m256i *b = (const __m256i *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m256i); i += 4) {
+        _mm256_stream_si256(&a[i], _mm256_load_si256(&b[i]));
+        _mm256_stream_si256(&a[i + 1], _mm256_load_si256(&b[i + 1]));
+        _mm256_stream_si256(&a[i + 2], _mm256_load_si256(&b[i + 2]));
+        _mm256_stream_si256(&a[i + 3], _mm256_load_si256(&b[i + 3]));
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+AVX2_KERNEL static double avx2_triad(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    __m256d s = _mm256_set1_pd(TRIAD_SCALAR);
+    for (size_t i = 0; i < bytes / sizeof(double); i += 8) {
+        _mm256_store_pd(&a[i], _mm256_add_pd(_mm256_load_pd(&b[i]), _mm256_mul_pd(s, _mm256_load_pd(&c[i]))));
+        _mm256_store_pd(&a[i + 4], _mm256_add_pd(_mm256_load_pd(&b[i + 4]), _mm256_mul_pd(s, _mm256_load_pd(&c[i + 4]))));
+    }
+    return 0.0;
+}
+
+AVX2_KERNEL static double avx2_triad_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    __m256d s = _mm256_set1_pd(TRIAD_SCALAR);
+    for (size_t i = 0; i < bytes / sizeof(double); i += 8) {
+        _mm256_stream_pd(&a[i], _mm256_add_pd(_mm256_load_pd(&b[i]), _mm256_mul_pd(s, _mm256_load_pd(&c[i]))));
+        _mm256_stream_pd(&a[i + 4], _mm256_add_pd(_mm256_load_pd(&b[i + 4]), _mm256_mul_pd(s, _mm256_load_pd(&c[i + 4]))));
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+// ---------------------------------------------------------------- AVX-512
+
+AVX512_KERNEL static double avx512_read(void *dst, const void *src1, const void *src2, size_t bytes) {
+    const __m512i *a = (const __m512i *)src1;
+    __m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+    (void)dst; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m512i); i += 4) {
+        s0 = _mm512_add_epi64(s0, _mm512_load_si512(&a[i]));
+        s1 = _mm512_add_epi64(s1, _mm512_load_si512(&a[i + 1]));
+        s2 = _mm512_add_epi64(s2, _mm512_load_si512(&a[i + 2]));
+        s3 = _mm512_add_epi64(s3, _mm512_load_si512(&a[i + 3]));
+    }
+    __m512i s = _mm512_add_epi64(_mm512_add_epi64(s0, s1), _mm512_add_epi64(s2, s3));
+    return (double)_mm512_reduce_add_epi64(s);
+}
+
+AVX512_KERNEL static double avx512_write(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m512i *a = (__m512i *)dst;
+    __m512i v = _mm512_set1_epi64(1);
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m512i); i += 4) {
+        _mm512_store_si512(&a[i], v);
+        _mm512_store_si512(&a[i + 1], v);
+        _mm512_store_si512(&a[i + 2], v);
+        _mm512_store_si512(&a[i + 3], v);
+    }
+    return 0.0;
+}
+
+AVX512_KERNEL static double avx512_write_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m512i *a = (__m512i *)dst;
+    __m512i v = _mm512_set1_epi64(1);
+    (void)src1; (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m512i); i += 4) {
+        _mm512_stream_si512(&a[i], v);
+        _mm512_stream_si512(&a[i + 1], v);
+        _mm512_stream_si512(&a[i + 2], v);
+        _mm512_stream_si512(&a[i + 3], v);
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+AVX512_KERNEL static double avx512_copy(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m512i *a = (__m512i *)dst;
+    const __m512i *b = (const __m512i *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m512i); i += 4) {
+        _mm512_store_si512(&a[i], _mm512_load_si512(&b[i]));
+        _mm512_store_si512(&a[i + 1], _mm512_load_si512(&b[i + 1]));
+        _mm512_store_si512(&a[i + 2], _mm512_load_si512(&b[i + 2]));
+        _mm512_store_si512(&a[i + 3], _mm512_load_si512(&b[i + 3]));
+    }
+    return 0.0;
+}
+
+AVX512_KERNEL static double avx512_copy_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    __m512i *a = (__m512i *)dst;
+    const __m512i *b = (const __m512i *)src1;
+    (void)src2;
+    for (size_t i = 0; i < bytes / sizeof(__m512i); i += 4) {
+        _mm512_stream_si512(&a[i], _mm512_load_si512(&b[i]));
+        _mm512_stream_si512(&a[i + 1], _mm512_load_si512(&b[i + 1]));
+        _mm512_stream_si512(&a[i + 2], _mm512_load_si512(&b[i + 2]));
+        _mm512_stream_si512(&a[i + 3], _mm512_load_si512(&b[i + 3]));
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+AVX512_KERNEL static double avx512_triad(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    __m512d s = _mm512_set1_pd(TRIAD_SCALAR);
+    for (size_t i = 0; i < bytes / sizeof(double); i += 16) {
+        _mm512_store_pd(&a[i], _mm512_fmadd_pd(s, _mm512_load_pd(&c[i]), _mm512_load_pd(&b[i])));
+        _mm512_store_pd(&a[i + 8], _mm512_fmadd_pd(s, _mm512_load_pd(&c[i + 8]), _mm512_load_pd(&b[i + 8])));
+    }
+    return 0.0;
+}
+
+AVX512_KERNEL static double avx512_triad_nt(void *dst, const void *src1, const void *src2, size_t bytes) {
+    double *a = (double *)dst;
+    const double *b = (const double *)src1;
+    const double *c = (const double *)src2;
+    __m512d s = _mm512_set1_pd(TRIAD_SCALAR);
+    for (size_t i = 0; i < bytes / sizeof(double); i += 16) {
+        _mm512_stream_pd(&a[i], _mm512_fmadd_pd(s, _mm512_load_pd(&c[i]), _mm512_load_pd(&b[i])));
+        _mm512_stream_pd(&a[i + 8], _mm512_fmadd_pd(s, _mm512_load_pd(&c[i + 8]), _mm512_load_pd(&b[i + 8])));
+    }
+    _mm_sfence();
+    return 0.0;
+}
+
+// ---------------------------------------------------------------- granularity
+
+// Element operations for each access width. Scalar accesses are volatile so the compiler
+// neither vectorizes nor merges them into wider ones.
+#define G1_TYPE uint8_t
+#define G1_ATTR SCALAR_KERNEL
+#define G1_ZERO 0
+#define G1_ONE 1
+#define G1_LOAD(p) (*(volatile const uint8_t *)(p))
+#define G1_STORE(p, v) (*(volatile uint8_t *)(p) = (v))
+#define G1_ADD(a, b) ((uint8_t)((a) + (b)))
+#define G1_FOLD(v) ((uint64_t)(v))
+
+#define G4_TYPE uint32_t
+#define G4_ATTR SCALAR_KERNEL
+#define G4_ZERO 0
+#define G4_ONE 1
+#define G4_LOAD(p) (*(volatile const uint32_t *)(p))
+#define G4_STORE(p, v) (*(volatile uint32_t *)(p) = (v))
+#define G4_ADD(a, b) ((a) + (b))
+#define G4_FOLD(v) ((uint64_t)(v))
+
+#define G8_TYPE uint64_t
+#define G8_ATTR SCALAR_KERNEL
+#define G8_ZERO 0
+#define G8_ONE 1
+#define G8_LOAD(p) (*(volatile const uint64_t *)(p))
+#define G8_STORE(p, v) (*(volatile uint64_t *)(p) = (v))
+#define G8_ADD(a, b) ((a) + (b))
+#define G8_FOLD(v) (v)
+
+#define G16_TYPE __m128i
+#define G16_ATTR SSE_KERNEL
+#define G16_ZERO _mm_setzero_si128()
+#define G16_ONE _mm_set1_epi64x(1)
+#define G16_LOAD(p) _mm_load_si128((const __m128i *)(p))
+#define G16_STORE(p, v) _mm_store_si128((__m128i *)(p), v)
+#define G16_ADD(a, b) _mm_add_epi64(a, b)
+#define G16_FOLD(v) ((uint64_t)_mm_cvtsi128_si64(v))
+
+#define G32_TYPE __m256i
+#define G32_ATTR AVX2_KERNEL
+#define G32_ZERO _mm256_setzero_si256()
+#define G32_ONE _mm256_set1_epi64x(1)
+#define G32_LOAD(p) _mm256_load_si256((const __m256i *)(p))
+#define G32_STORE(p, v) _mm256_store_si256((__m256i *)(p), v)
+#define G32_ADD(a, b) _mm256_add_epi64(a, b)
+#define G32_FOLD(v) ((uint64_t)_mm_cvtsi128_si64(_mm256_castsi256_si128(v)))
+
+#define G64_TYPE __m512i
+#define G64_ATTR AVX512_KERNEL
+#define G64_ZERO _mm512_setzero_si512()
+#define G64_ONE _mm512_set1_epi64(1)
+#define G64_LOAD(p) _mm512_load_si512((const void *)(p))
+#define G64_STORE(p, v) _mm512_store_si512((void *)(p), v)
+#define G64_ADD(a, b) _mm512_add_epi64(a, b)
+#define G64_FOLD(v) ((uint64_t)_mm_cvtsi128_si64(_mm512_castsi512_si128(v)))
+
+// Fully unroll the following loop over the U accesses of one iteration
+#define UNROLL_STR(x) #x
+#define UNROLL(u) _Pragma(UNROLL_STR(GCC unroll u))
+
+// Read, write and read-modify-write kernels for width W and unroll U. The read kernel keeps
+// U independent accumulators so the loads are not serialized on one add chain.
+#define GRAN_KERNELS(W, U)                                                                          \
+    G##W##_ATTR static uint64_t gran_w##W##_x##U##_read(char *base, const uint32_t *chunks,        \
+                                                       size_t num_chunks, size_t chunk_size) {     \
+        G##W##_TYPE acc[U];                                                                         \
+        uint64_t sum = 0;                                                                           \
+        UNROLL(U)                                                                                   \
+        for (int k = 0; k < U; k++) {                                                               \
+            acc[k] = G##W##_ZERO;                                                                   \
+        }                                                                                           \
+        for (size_t c = 0; c < num_chunks; c++) {                                                   \
+            const char *p = base + (size_t)chunks[c] * chunk_size;                                  \
+            for (size_t i = 0; i < chunk_size; i += W * U) {                                        \
+                UNROLL(U)                                                                           \
+                for (int k = 0; k < U; k++) {                                                       \
+                    acc[k] = G##W##_ADD(acc[k], G##W##_LOAD(p + i + k * W));                        \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+        UNROLL(U)                                                                                   \
+        for (int k = 0; k < U; k++) {                                                               \
+            sum += G##W##_FOLD(acc[k]);                                                             \
+        }                                                                                           \
+        return sum;                                                                                 \
+    }                                                                                               \
+    G##W##_ATTR static uint64_t gran_w##W##_x##U##_write(char *base, const uint32_t *chunks,       \
+                                                        size_t num_chunks, size_t chunk_size) {    \
+        G##W##_TYPE one = G##W##_ONE;                                                               \
+        for (size_t c = 0; c < num_chunks; c++) {                                                   \
+            char *p = base + (size_t)chunks[c] * chunk_size;                                        \
+            for (size_t i = 0; i < chunk_size; i += W * U) {                                        \
+                UNROLL(U)                                                                           \
+                for (int k = 0; k < U; k++) {                                                       \
+                    G##W##_STORE(p + i + k * W, one);                                               \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+        return 0;                                                                                   \
+    }                                                                                               \
+    G##W##_ATTR static uint64_t gran_w##W##_x##U##_rmw(char *base, const uint32_t *chunks,         \
+                                                      size_t num_chunks, size_t chunk_size) {      \
+        G##W##_TYPE one = G##W##_ONE;                                                               \
+        for (size_t c = 0; c < num_chunks; c++) {                                                   \
+            char *p = base + (size_t)chunks[c] * chunk_size;                                        \
+            for (size_t i = 0; i < chunk_size; i += W * U) {                                        \
+                UNROLL(U)                                                                           \
+                for (int k = 0; k < U; k++) {                                                       \
+                    G##W##_STORE(p + i + k * W, G##W##_ADD(G##W##_LOAD(p + i + k * W), one));      \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+        return 0;                                                                                   \
+    }
+
+GRAN_KERNELS(1, 1)
+GRAN_KERNELS(1, 4)
+GRAN_KERNELS(4, 1)
+GRAN_KERNELS(4, 4)
+GRAN_KERNELS(8, 1)
+GRAN_KERNELS(8, 4)
+GRAN_KERNELS(16, 1)
+GRAN_KERNELS(16, 4)
+GRAN_KERNELS(32, 1)
+GRAN_KERNELS(32, 4)
+GRAN_KERNELS(64, 1)
+GRAN_KERNELS(64, 4)
+
+// ---------------------------------------------------------------- registry
+
+static const bw_kernel_t kernels[] = {
+    {"scalar_read",     BW_READ,  BW_SCALAR, 0, scalar_read},
+    {"scalar_write",    BW_WRITE, BW_SCALAR, 0, scalar_write},
+    {"scalar_write_nt", BW_WRITE, BW_SCALAR, 1, scalar_write_nt},
+    {"scalar_copy",     BW_COPY,  BW_SCALAR, 0, scalar_copy},
+    {"scalar_copy_nt",  BW_COPY,  BW_SCALAR, 1, scalar_copy_nt},
+    {"scalar_triad",    BW_TRIAD, BW_SCALAR, 0, scalar_triad},
+    {"scalar_triad_nt", BW_TRIAD, BW_SCALAR, 1, scalar_triad_nt},
+    {"sse_read",        BW_READ,  BW_SSE,    0, sse_read},
+    {"sse_write",       BW_WRITE, BW_SSE,    0, sse_write},
+    {"sse_write_nt",    BW_WRITE, BW_SSE,    1, sse_write_nt},
+    {"sse_copy",        BW_COPY,  BW_SSE,    0, sse_copy},
+    {"sse_copy_nt",     BW_COPY,  BW_SSE,    1, sse_copy_nt},
+    {"sse_triad",       BW_TRIAD, BW_SSE,    0, sse_triad},
+    {"sse_triad_nt",    BW_TRIAD, BW_SSE,    1, sse_triad_nt},
+    {"avx2_read",       BW_READ,  BW_AVX2,   0, avx2_read},
+    {"avx2_write",      BW_WRITE, BW_AVX2,   0, avx2_write},
+    {"avx2_write_nt",   BW_WRITE, BW_AVX2,   1, avx2_write_nt},
+    {"avx2_copy",       BW_COPY,  BW_AVX2,   0, avx2_copy},
+    {"avx2_copy_nt",    BW_COPY,  BW_AVX2,   1, avx2_copy_nt},
+    {"avx2_triad",      BW_TRIAD, BW_AVX2,   0, avx2_triad},
+    {"avx2_triad_nt",   BW_TRIAD, BW_AVX2,   1, avx2_triad_nt},
+    {"avx512_read",     BW_READ,  BW_AVX512, 0, avx512_read},
+    {"avx512_write",    BW_WRITE, BW_AVX512, 0, avx512_write},
+    {"avx512_write_nt", BW_WRITE, BW_AVX512, 1, avx512_write_nt},
+    {"avx512_copy",     BW_COPY,  BW_AVX512, 0, avx512_copy},
+    {"avx512_copy_nt",  BW_COPY,  BW_AVX512, 1, avx512_copy_nt},
+    {"avx512_triad",    BW_TRIAD, BW_AVX512, 0, avx512_triad},
+    {"avx512_triad_nt", BW_TRIAD, BW_AVX512, 1, avx512_triad_nt},
+};
+
+#define GRAN_ENTRIES(W, U, ISA)                                                          \
+    {"w" #W "_x" #U "_read",  CHUNK_READ,  W, U, ISA, gran_w##W##_x##U##_read},          \
+    {"w" #W "_x" #U "_write", CHUNK_WRITE, W, U, ISA, gran_w##W##_x##U##_write},         \
+    {"w" #W "_x" #U "_rmw",   CHUNK_RMW,   W, U, ISA, gran_w##W##_x##U##_rmw}
+
+static const chunk_kernel_t chunk_kernel_list[] = {
+    GRAN_ENTRIES(1, 1, BW_SCALAR),
+    GRAN_ENTRIES(1, 4, BW_SCALAR),
+    GRAN_ENTRIES(4, 1, BW_SCALAR),
+    GRAN_ENTRIES(4, 4, BW_SCALAR),
+    GRAN_ENTRIES(8, 1, BW_SCALAR),
+    GRAN_ENTRIES(8, 4, BW_SCALAR),
+    GRAN_ENTRIES(16, 1, BW_SSE),
+    GRAN_ENTRIES(16, 4, BW_SSE),
+    GRAN_ENTRIES(32, 1, BW_AVX2),
+    GRAN_ENTRIES(32, 4, BW_AVX2),
+    GRAN_ENTRIES(64, 1, BW_AVX512),
+    GRAN_ENTRIES(64, 4, BW_AVX512),
+};
+
+const bw_kernel_t *bw_kernels(int *count) {
+    *count = sizeof(kernels) / sizeof(kernels[0]);
+    return kernels;
+}
+
+int bw_isa_supported(bw_isa_t isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case BW_SCALAR: return 1;
+        case BW_SSE:    return __builtin_cpu_supports("sse2");
+        case BW_AVX2:   return __builtin_cpu_supports("avx2");
+        case BW_AVX512: return __builtin_cpu_supports("avx512f");
+        default:        return 0;
+    }
+}
+
+const bw_kernel_t *bw_best_kernel(bw_op_t op, int nontemporal) {
+    const bw_kernel_t *best = NULL;
+    int count;
+    const bw_kernel_t *k = bw_kernels(&count);
+    for (int i = 0; i < count; i++) {
+        if (k[i].op != op || (k[i].op != BW_READ && k[i].nontemporal != nontemporal)) {
+            continue;
+        }
+        if (bw_isa_supported(k[i].isa) && (!best || k[i].isa > best->isa)) {
+            best = &k[i];
+        }
+    }
+    return best;
+}
+
+size_t bw_bytes_moved(bw_op_t op, size_t bytes) {
+    switch (op) {
+        case BW_COPY:  return 2 * bytes;
+        case BW_TRIAD: return 3 * bytes;
+        default:       return bytes;
+    }
+}
+
+const char *bw_op_name(bw_op_t op) {
+    static const char *names[] = {"read", "write", "copy", "triad"};
+    return op < BW_NUM_OPS ? names[op] : "?";
+}
+
+const char *bw_isa_name(bw_isa_t isa) {
+    static const char *names[] = {"scalar", "sse", "avx2", "avx512"};
+    return isa < BW_NUM_ISAS ? names[isa] : "?";
+}
+
+const chunk_kernel_t *chunk_kernels(int *count) {
+    *count = sizeof(chunk_kernel_list) / sizeof(chunk_kernel_list[0]);
+    return chunk_kernel_list;
+}
+
+const char *chunk_mode_name(chunk_mode_t mode) {
+    static const char *names[] = {"read", "write", "rmw"};
+    return mode < CHUNK_NUM_MODES ? names[mode] : "?";
+}
@@ -0,0 +1,84 @@
+#ifndef BANDWIDTH_KERNELS_H
+#define BANDWIDTH_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BW_ALIGNMENT 64       // Buffers passed to the kernels must be 64B aligned
+#define BW_BLOCK_BYTES 256    // Kernel lengths must be a multiple of this (4 x 64B unroll)
+
+// Streaming operation performed by a kernel (STREAM naming)
+typedef enum {
+    BW_READ,    // sum += a[i]
+    BW_WRITE,   // a[i] = x
+    BW_COPY,    // a[i] = b[i]
+    BW_TRIAD,   // a[i] = b[i] + s * c[i]
+    BW_NUM_OPS
+} bw_op_t;
+
+// Instruction set a kernel is written for
+typedef enum {
+    BW_SCALAR,
+    BW_SSE,
+    BW_AVX2,
+    BW_AVX512,
+    BW_NUM_ISAS
+} bw_isa_t;
+
+// Every kernel runs over 'bytes' bytes of each array it touches. Read kernels only use
+// 'src1'; the return value is a checksum that callers should keep live.
+typedef double (*bw_kernel_fn)(void *dst, const void *src1, const void *src2, size_t bytes);
+
+typedef struct {
+    const char *name;     // e.g. "avx2_copy_nt"
+    bw_op_t op;
+    bw_isa_t isa;
+    int nontemporal;      // 1 if stores bypass the cache
+    bw_kernel_fn fn;
+} bw_kernel_t;
+
+// All compiled-in kernels, whether or not this CPU can run them
+const bw_kernel_t *bw_kernels(int *count);
+
+// 1 if the CPU and OS support the instruction set
+int bw_isa_supported(bw_isa_t isa);
+
+// Widest supported kernel for an operation, picked by runtime feature detection
+const bw_kernel_t *bw_best_kernel(bw_op_t op, int nontemporal);
+
+// Bytes moved by one call over 'bytes', counted as STREAM does (no write-allocate traffic)
+size_t bw_bytes_moved(bw_op_t op, size_t bytes);
+
+const char *bw_op_name(bw_op_t op);
+const char *bw_isa_name(bw_isa_t isa);
+
+// Access performed on every element of a chunk by a granularity kernel
+typedef enum {
+    CHUNK_READ,     // sum += x
+    CHUNK_WRITE,    // x = 1
+    CHUNK_RMW,      // x += 1
+    CHUNK_NUM_MODES
+} chunk_mode_t;
+
+// Granularity kernels touch every byte of 'num_chunks' chunks of 'chunk_size' bytes, chunk i
+// at base + chunks[i] * chunk_size, with one 'width'-byte access per element and the inner
+// loop unrolled 'unroll' times. Width, unroll and mode are fixed per kernel, so the timed loop
+// has no branches besides its own. 'chunk_size' must be a multiple of width * unroll and of
+// BW_ALIGNMENT. Returns a checksum that callers should keep live.
+typedef uint64_t (*chunk_kernel_fn)(char *base, const uint32_t *chunks, size_t num_chunks, size_t chunk_size);
+
+typedef struct {
+    const char *name;     // e.g. "w16_x4_rmw"
+    chunk_mode_t mode;
+    int width;            // Bytes per access: 1, 4, 8, 16, 32 or 64
+    int unroll;           // Accesses per inner-loop iteration
+    bw_isa_t isa;
+    chunk_kernel_fn fn;
+} chunk_kernel_t;
+
+// All compiled-in granularity kernels, whether or not this CPU can run them
+const chunk_kernel_t *chunk_kernels(int *count);
+
+const char *chunk_mode_name(chunk_mode_t mode);
+
+#endif
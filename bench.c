@@ -0,0 +1,510 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "tsc.h"
+#include "affinity.h"
+#include "corunner.h"
+
+#define PARAM_KEY_LEN 64
+#define PARAM_VALUE_LEN 256
+#define PATH_MAX_LEN 512
+
+typedef struct {
+    char key[PARAM_KEY_LEN];      // "key" or "command.key"
+    char value[PARAM_VALUE_LEN];
+} bench_param_t;
+
+// One open result file
+typedef struct {
+    FILE *file;
+    char path[PATH_MAX_LEN];
+} bench_output_t;
+
+static bench_param_t params[BENCH_MAX_PARAMS];
+static int num_params = 0;
+static char command_name[PARAM_KEY_LEN] = "";
+static char output_dir[PARAM_VALUE_LEN] = ".";
+static int output_format = BENCH_FORMAT_CSV;
+static bench_output_t outputs[BENCH_MAX_OUTPUTS];
+static uint64_t rng_seed = BENCH_SEED;
+static uint64_t rng_state = BENCH_SEED;
+
+// Strip leading and trailing whitespace in place
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+// Add or replace a parameter; later settings win
+static void set_param(const char *key, const char *value) {
+    for (int i = 0; i < num_params; i++) {
+        if (strcmp(params[i].key, key) == 0) {
+            snprintf(params[i].value, PARAM_VALUE_LEN, "%s", value);
+            return;
+        }
+    }
+    if (num_params == BENCH_MAX_PARAMS) {
+        fprintf(stderr, "Too many parameters, ignoring %s\n", key);
+        return;
+    }
+    snprintf(params[num_params].key, PARAM_KEY_LEN, "%s", key);
+    snprintf(params[num_params].value, PARAM_VALUE_LEN, "%s", value);
+    num_params++;
+}
+
+// Parse "key=value" into a parameter, prefixing the key with 'section.' if given
+static int parse_assignment(char *line, const char *section) {
+    char *eq = strchr(line, '=');
+    if (!eq) {
+        return -1;
+    }
+    *eq = '\0';
+    char *key = trim(line);
+    char *value = trim(eq + 1);
+    if (*key == '\0') {
+        return -1;
+    }
+
+    char scoped[PARAM_KEY_LEN];
+    if (section && *section) {
+        snprintf(scoped, sizeof(scoped), "%s.%s", section, key);
+        key = scoped;
+    }
+    set_param(key, value);
+    return 0;
+}
+
+// Function to start the antagonists of a "corunners" set (corunner.h) for the rest of the
+// process, on every allowed CPU but the first, which the main thread is pinned to
+static void start_corunners(const char *set) {
+    corun_spec_t specs[CORUN_MAX_SPECS];
+    int cpus[CORUN_MAX_THREADS];
+    int num_specs = corun_parse(set, 1, specs, CORUN_MAX_SPECS);
+
+    if (num_specs < 0) {
+        exit(EXIT_FAILURE);
+    }
+    int num_cpus = corun_default_cpus(cpus, CORUN_MAX_THREADS);
+    int first;
+    if (get_allowed_cpus(&first, 1) == 1 && cpus[0] != first) {
+        pin_thread(first);
+    } else {
+        fprintf(stderr, "Only one CPU is available: co-runners share it with the benchmark\n");
+    }
+    if (corun_start(specs, num_specs, cpus, num_cpus) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    atexit(corun_stop);
+}
+
+// Function to read a config file of "key = value" lines. "[command]" starts a section
+// whose keys only apply to that command; '#' and ';' start comments.
+static void load_config(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[PARAM_KEY_LEN + PARAM_VALUE_LEN];
+    char section[PARAM_KEY_LEN] = "";
+    int line_no = 0;
+
+    if (!f) {
+        perror("Error opening config file");
+        exit(EXIT_FAILURE);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        line[strcspn(line, "#;")] = '\0';
+        char *s = trim(line);
+        if (*s == '\0') {
+            continue;
+        }
+        if (*s == '[') {
+            char *close = strchr(s, ']');
+            if (!close) {
+                fprintf(stderr, "%s:%d: unterminated section\n", path, line_no);
+                exit(EXIT_FAILURE);
+            }
+            *close = '\0';
+            snprintf(section, sizeof(section), "%s", trim(s + 1));
+            continue;
+        }
+        if (parse_assignment(s, section) != 0) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, line_no);
+            exit(EXIT_FAILURE);
+        }
+    }
+    fclose(f);
+}
+
+void bench_init(int *argc, char *argv[], const char *command) {
+    const char *config = NULL;
+    int kept = 1;
+
+    if (command) {
+        bench_set_command(command);
+    }
+
+    // The config file is loaded first so command-line settings override it
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < *argc) {
+            config = argv[++i];
+        }
+    }
+    if (config) {
+        load_config(config);
+    }
+
+    for (int i = 1; i < *argc; i++) {
+        char *arg = argv[i];
+        if (strcmp(arg, "--config") == 0 && i + 1 < *argc) {
+            i++;
+        } else if (strcmp(arg, "--format") == 0 && i + 1 < *argc) {
+            const char *format = argv[++i];
+            if (strcmp(format, "csv") == 0) {
+                output_format = BENCH_FORMAT_CSV;
+            } else if (strcmp(format, "json") == 0) {
+                output_format = BENCH_FORMAT_JSON;
+            } else if (strcmp(format, "both") == 0) {
+                output_format = BENCH_FORMAT_BOTH;
+            } else {
+                fprintf(stderr, "Unknown output format '%s' (csv, json or both)\n", format);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(arg, "--output") == 0 && i + 1 < *argc) {
+            snprintf(output_dir, sizeof(output_dir), "%s", argv[++i]);
+            if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
+                perror("Error creating output directory");
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg[0] != '-' && strchr(arg, '=')) {
+            char buf[PARAM_KEY_LEN + PARAM_VALUE_LEN];
+            snprintf(buf, sizeof(buf), "%s", arg);
+            parse_assignment(buf, NULL);
+        } else {
+            argv[kept++] = arg;
+        }
+    }
+    argv[kept] = NULL;
+    *argc = kept;
+
+    // The seed may come from the config file or the command line, both read only now
+    bench_seed((uint64_t)bench_param_long("seed", BENCH_SEED));
+
+    // Calibrate the TSC now so it never happens inside a timed region
+    get_tsc_info();
+
+    const char *corunners = bench_param_str("corunners", NULL);
+    if (corunners && *corunners) {
+        start_corunners(corunners);
+    }
+}
+
+void bench_set_command(const char *command) {
+    snprintf(command_name, sizeof(command_name), "%s", command ? command : "");
+    // Each experiment gets the same stream whatever ran before it
+    bench_seed((uint64_t)bench_param_long("seed", BENCH_SEED));
+}
+
+void bench_seed(uint64_t seed) {
+    rng_seed = seed;
+    rng_state = seed;
+}
+
+uint64_t bench_seed_value(void) {
+    return rng_seed;
+}
+
+uint64_t bench_random(void) {
+    // The state is a counter stepped atomically, so threads can share the stream
+    uint64_t z = __atomic_add_fetch(&rng_state, 0x9e3779b97f4a7c15ULL, __ATOMIC_RELAXED);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+size_t bench_random_index(size_t n) {
+    return (size_t)(((unsigned __int128)bench_random() * n) >> 64);
+}
+
+double bench_random_unit(void) {
+    return ((double)(bench_random() >> 11) + 1.0) / 9007199254740992.0;  // 53 random bits over 2^53
+}
+
+const char *bench_command(void) {
+    return command_name;
+}
+
+const char *bench_param_str(const char *key, const char *def) {
+    char scoped[2 * PARAM_KEY_LEN];
+
+    snprintf(scoped, sizeof(scoped), "%s.%s", command_name, key);
+    for (int i = 0; i < num_params; i++) {
+        if (command_name[0] && strcmp(params[i].key, scoped) == 0) {
+            return params[i].value;
+        }
+    }
+    for (int i = 0; i < num_params; i++) {
+        if (strcmp(params[i].key, key) == 0) {
+            return params[i].value;
+        }
+    }
+    return def;
+}
+
+// Report a parameter that does not parse and stop, rather than run with a surprise value
+static void bad_param(const char *key, const char *value) {
+    fprintf(stderr, "Invalid value '%s' for parameter '%s'\n", value, key);
+    exit(EXIT_FAILURE);
+}
+
+long bench_param_long(const char *key, long def) {
+    const char *value = bench_param_str(key, NULL);
+    char *end;
+
+    if (!value) {
+        return def;
+    }
+    long result = strtol(value, &end, 0);
+    if (end == value || *end != '\0') {
+        bad_param(key, value);
+    }
+    return result;
+}
+
+double bench_param_double(const char *key, double def) {
+    const char *value = bench_param_str(key, NULL);
+    char *end;
+
+    if (!value) {
+        return def;
+    }
+    double result = strtod(value, &end);
+    if (end == value || *end != '\0') {
+        bad_param(key, value);
+    }
+    return result;
+}
+
+size_t bench_parse_size(const char *s) {
+    char *end;
+    size_t value = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': return value * 1024;
+        case 'M': case 'm': return value * 1024 * 1024;
+        case 'G': case 'g': return value * 1024 * 1024 * 1024;
+        default: return value;
+    }
+}
+
+size_t bench_param_size(const char *key, size_t def) {
+    const char *value = bench_param_str(key, NULL);
+
+    if (!value) {
+        return def;
+    }
+    if (!isdigit((unsigned char)value[0])) {
+        bad_param(key, value);
+    }
+    return bench_parse_size(value);
+}
+
+void *bench_alloc(size_t size, size_t alignment) {
+    size_t rounded = (size + alignment - 1) / alignment * alignment;
+    void *p = aligned_alloc(alignment, rounded ? rounded : alignment);
+    if (!p) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+FILE *bench_csv_open(const char *name) {
+    for (int i = 0; i < BENCH_MAX_OUTPUTS; i++) {
+        bench_output_t *out = &outputs[i];
+        if (out->file) {
+            continue;
+        }
+        snprintf(out->path, sizeof(out->path), "%s/%s", output_dir, name);
+        out->file = fopen(out->path, "w");
+        if (!out->file) {
+            perror("Error opening CSV file");
+            exit(EXIT_FAILURE);
+        }
+        topology_write_header(out->file, get_topology());
+        tsc_write_header(out->file);
+        fprintf(out->file, "# Seed: %llu\n", (unsigned long long)bench_seed_value());
+        if (corun_running()) {
+            fprintf(out->file, "# Co-runners: %s\n", corun_running());
+        }
+        return out->file;
+    }
+    fprintf(stderr, "Too many result files open\n");
+    exit(EXIT_FAILURE);
+}
+
+void bench_csv_close(FILE *csv_file) {
+    for (int i = 0; i < BENCH_MAX_OUTPUTS; i++) {
+        bench_output_t *out = &outputs[i];
+        if (out->file != csv_file) {
+            continue;
+        }
+        fclose(csv_file);
+        out->file = NULL;
+
+        if (output_format & BENCH_FORMAT_JSON) {
+            char json_path[PATH_MAX_LEN + 8];
+            size_t len = strlen(out->path);
+            if (len > 4 && strcmp(out->path + len - 4, ".csv") == 0) {
+                len -= 4;
+            }
+            snprintf(json_path, sizeof(json_path), "%.*s.json", (int)len, out->path);
+            if (bench_csv_to_json(out->path, json_path, command_name) != 0) {
+                perror("Error writing JSON results");
+            } else if (!(output_format & BENCH_FORMAT_CSV)) {
+                remove(out->path);
+            }
+        }
+        return;
+    }
+    fclose(csv_file);
+}
+
+// Write a JSON string literal
+static void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Write a CSV field as a JSON number when it is one, null when empty, else as a string
+static void json_value(FILE *out, const char *field) {
+    char *end;
+
+    if (*field == '\0') {
+        fprintf(out, "null");
+        return;
+    }
+    double value = strtod(field, &end);
+    // strtod also takes hex and "inf"/"nan", none of which are JSON numbers
+    if (*end == '\0' && isfinite(value) && strncmp(field, "0x", 2) != 0) {
+        fprintf(out, "%.15g", value);
+    } else {
+        json_string(out, field);
+    }
+}
+
+// Split a CSV line on commas in place, trimming each field; returns the number of fields
+static int split_fields(char *line, char **fields, int max_fields) {
+    int n = 0;
+    char *s = line;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    while (n < max_fields) {
+        char *comma = strchr(s, ',');
+        if (comma) {
+            *comma = '\0';
+        }
+        fields[n++] = trim(s);
+        if (!comma) {
+            break;
+        }
+        s = comma + 1;
+    }
+    return n;
+}
+
+int bench_csv_to_json(const char *csv_path, const char *json_path, const char *command) {
+    enum { MAX_FIELDS = 64 };
+    FILE *in = fopen(csv_path, "r");
+    if (!in) {
+        return -1;
+    }
+    FILE *out = fopen(json_path, "w");
+    if (!out) {
+        fclose(in);
+        return -1;
+    }
+
+    char *line = NULL, *header = NULL;
+    size_t cap = 0;
+    char *columns[MAX_FIELDS], *fields[MAX_FIELDS];
+    int num_columns = 0, num_rows = 0, num_comments = 0;
+    const char *file_name = strrchr(csv_path, '/') ? strrchr(csv_path, '/') + 1 : csv_path;
+
+    fprintf(out, "{\n  \"command\": ");
+    json_string(out, command ? command : "");
+    fprintf(out, ",\n  \"file\": ");
+    json_string(out, file_name);
+    fprintf(out, ",\n  \"comments\": [");
+
+    // Comments are collected wherever they appear, so one written after the header can never
+    // land among the rows
+    while (getline(&line, &cap, in) > 0) {
+        if (line[0] == '#') {
+            line[strcspn(line, "\r\n")] = '\0';
+            fprintf(out, "%s\n    ", num_comments++ ? "," : "");
+            json_string(out, trim(line + 1));
+        }
+    }
+    fprintf(out, "%s],\n  \"columns\": [", num_comments ? "\n  " : "");
+
+    rewind(in);
+    while (getline(&line, &cap, in) > 0) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (!header) {
+            // First non-comment line is the column header
+            header = strdup(line);
+            num_columns = split_fields(header, columns, MAX_FIELDS);
+            for (int c = 0; c < num_columns; c++) {
+                fprintf(out, "%s", c ? ", " : "");
+                json_string(out, columns[c]);
+            }
+            fprintf(out, "],\n  \"rows\": [");
+            continue;
+        }
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        int n = split_fields(line, fields, MAX_FIELDS);
+        fprintf(out, "%s\n    {", num_rows++ ? "," : "");
+        for (int c = 0; c < n && c < num_columns; c++) {
+            fprintf(out, "%s", c ? ", " : "");
+            json_string(out, columns[c]);
+            fprintf(out, ": ");
+            json_value(out, fields[c]);
+        }
+        fprintf(out, "}");
+    }
+    if (!header) {
+        fprintf(out, "],\n  \"rows\": [");
+    }
+    fprintf(out, "%s]\n}\n", num_rows ? "\n  " : "");
+
+    free(line);
+    free(header);
+    fclose(in);
+    return fclose(out) == 0 ? 0 : -1;
+}
@@ -0,0 +1,82 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define BENCH_MAX_PARAMS 128    // key=value settings from the command line and config file
+#define BENCH_MAX_OUTPUTS 16    // Result files open at the same time
+#define BENCH_SEED 1            // Default seed of the random number stream
+
+// Formats results are written in; CSV is always produced first, JSON is converted from it
+typedef enum {
+    BENCH_FORMAT_CSV = 1,
+    BENCH_FORMAT_JSON = 2,
+    BENCH_FORMAT_BOTH = 3
+} bench_format_t;
+
+// Nanoseconds between two timestamps taken with clock_gettime
+static inline double elapsed_ns(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+// Parse and remove the shared options from argv, leaving the benchmark's own arguments:
+//   key=value              set a parameter (may be scoped, e.g. latency.hops=100000)
+//   --config FILE          read key = value lines, with [command] sections
+//   --format csv|json|both output format (default csv)
+//   --output DIR           directory for result files (default .)
+//   corunners=SET          run antagonist threads (corunner.h) on the other CPUs for the
+//                          whole run, e.g. corunners=llc+stream, to measure under interference
+// 'command' names the benchmark whose config section applies; NULL leaves it unset.
+// Also calibrates the TSC clock (tsc.h).
+void bench_init(int *argc, char *argv[], const char *command);
+
+// Select the config-file section and parameter scope of the benchmark about to run, and
+// restart the random number stream from its 'seed' parameter
+void bench_set_command(const char *command);
+const char *bench_command(void);
+
+// Look up a parameter as "<command>.<key>", then "<key>", then fall back to 'def'.
+// Command-line settings take precedence over the config file.
+const char *bench_param_str(const char *key, const char *def);
+long bench_param_long(const char *key, long def);
+double bench_param_double(const char *key, double def);
+
+// Sizes accept K, M and G suffixes (powers of 1024)
+size_t bench_param_size(const char *key, size_t def);
+
+// Parse a size such as "64", "48K" or "2G" into bytes
+size_t bench_parse_size(const char *s);
+
+// Seeded pseudo-random numbers (splitmix64). Unlike rand() the sequence does not depend on
+// the C library, so buffers, chains and operation schedules built from the same 'seed'
+// parameter are identical on every host. Safe to call from several threads, but their draws
+// then interleave in scheduler order, so anything that must replay is built from one thread.
+void bench_seed(uint64_t seed);
+uint64_t bench_seed_value(void);
+uint64_t bench_random(void);
+
+// Random index in [0, n)
+size_t bench_random_index(size_t n);
+
+// Random number in (0, 1]
+double bench_random_unit(void);
+
+// Aligned allocation that exits on failure; 'size' is rounded up to the alignment
+void *bench_alloc(size_t size, size_t alignment);
+
+// Open a result file in the output directory and write the topology, clock and seed
+// header. Exits on failure.
+FILE *bench_csv_open(const char *name);
+
+// Close a result file opened with bench_csv_open, converting it to JSON if requested
+void bench_csv_close(FILE *csv_file);
+
+// Convert a CSV written by a benchmark into JSON: '#' lines become "comments" wherever they
+// appear, the first other line names the columns and each following line becomes an object.
+// Returns 0 on success.
+int bench_csv_to_json(const char *csv_path, const char *json_path, const char *command);
+
+#endif
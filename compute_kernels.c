@@ -0,0 +1,245 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "compute_kernels.h"
+
+#define ROOF_MUL 0.5        // v = v * ROOF_MUL + ROOF_ADD converges to 1, so no overflow or denormals
+#define ROOF_ADD 0.5
+#define ROOF_CHAINS 8       // Independent chains in the intensity kernels (8 x the vector width per iteration)
+#define PEAK_FP_CHAINS 12   // Independent multiply-add chains: enough for 2 FMA ports x 4-6 cycles latency
+#define PEAK_INT_CHAINS 8   // Independent add/xor chains: enough for 4 ALU ports x 1 cycle latency
+#define PEAK_INT_ADD 0x9e3779b97f4a7c15ULL
+#define PEAK_INT_XOR 0x5851f42d4c957f2dULL
+
+// Kernels are compiled per instruction set with target attributes so the binary runs on
+// any x86-64 host; the scalar ones are kept from being auto-vectorized. SSE2 has no FMA, so
+// its kernels and the scalar ones use a separate multiply and add for the same two flops.
+#define SCALAR_KERNEL __attribute__((optimize("no-tree-vectorize")))
+#define SSE_KERNEL __attribute__((target("sse2")))
+#define AVX2_KERNEL __attribute__((target("avx2,fma")))
+#define AVX512_KERNEL __attribute__((target("avx512f")))
+
+#define UNROLL_STR(x) #x
+#define UNROLL(u) _Pragma(UNROLL_STR(GCC unroll u))
+
+// Per-ISA operations: C_<ISA>_ATTR, the double vector type and its lane count, loads, lane
+// extraction and the multiply-add, then the 64-bit integer vector type and its add and xor
+#define C_SCALAR_ATTR SCALAR_KERNEL
+#define C_SCALAR_PD double
+#define C_SCALAR_LANES 1
+#define C_SCALAR_SET1(x) (x)
+#define C_SCALAR_LOAD(p) (*(p))
+#define C_SCALAR_STORE(p, v) (*(p) = (v))
+#define C_SCALAR_MULADD(v, m, c) ((v) * (m) + (c))
+#define C_SCALAR_EPI uint64_t
+#define C_SCALAR_SET1_EPI(x) ((uint64_t)(x))
+#define C_SCALAR_STORE_EPI(p, v) (*(p) = (v))
+#define C_SCALAR_ADD_EPI(a, b) ((a) + (b))
+#define C_SCALAR_XOR_EPI(a, b) ((a) ^ (b))
+
+#define C_SSE_ATTR SSE_KERNEL
+#define C_SSE_PD __m128d
+#define C_SSE_LANES 2
+#define C_SSE_SET1(x) _mm_set1_pd(x)
+#define C_SSE_LOAD(p) _mm_load_pd(p)
+#define C_SSE_STORE(p, v) _mm_storeu_pd(p, v)
+#define C_SSE_MULADD(v, m, c) _mm_add_pd(_mm_mul_pd(v, m), c)
+#define C_SSE_EPI __m128i
+#define C_SSE_SET1_EPI(x) _mm_set1_epi64x((long long)(x))
+#define C_SSE_STORE_EPI(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define C_SSE_ADD_EPI(a, b) _mm_add_epi64(a, b)
+#define C_SSE_XOR_EPI(a, b) _mm_xor_si128(a, b)
+
+#define C_AVX2_ATTR AVX2_KERNEL
+#define C_AVX2_PD __m256d
+#define C_AVX2_LANES 4
+#define C_AVX2_SET1(x) _mm256_set1_pd(x)
+#define C_AVX2_LOAD(p) _mm256_load_pd(p)
+#define C_AVX2_STORE(p, v) _mm256_storeu_pd(p, v)
+#define C_AVX2_MULADD(v, m, c) _mm256_fmadd_pd(v, m, c)
+#define C_AVX2_EPI __m256i
+#define C_AVX2_SET1_EPI(x) _mm256_set1_epi64x((long long)(x))
+#define C_AVX2_STORE_EPI(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define C_AVX2_ADD_EPI(a, b) _mm256_add_epi64(a, b)
+#define C_AVX2_XOR_EPI(a, b) _mm256_xor_si256(a, b)
+
+#define C_AVX512_ATTR AVX512_KERNEL
+#define C_AVX512_PD __m512d
+#define C_AVX512_LANES 8
+#define C_AVX512_SET1(x) _mm512_set1_pd(x)
+#define C_AVX512_LOAD(p) _mm512_load_pd(p)
+#define C_AVX512_STORE(p, v) _mm512_storeu_pd(p, v)
+#define C_AVX512_MULADD(v, m, c) _mm512_fmadd_pd(v, m, c)
+#define C_AVX512_EPI __m512i
+#define C_AVX512_SET1_EPI(x) _mm512_set1_epi64((long long)(x))
+#define C_AVX512_STORE_EPI(p, v) _mm512_storeu_si512((void *)(p), v)
+#define C_AVX512_ADD_EPI(a, b) _mm512_add_epi64(a, b)
+#define C_AVX512_XOR_EPI(a, b) _mm512_xor_si512(a, b)
+
+// ---------------------------------------------------------------- peak kernels
+
+#define PEAK_KERNELS(ISA, name)                                                                     \
+    C_##ISA##_ATTR static double name##_fp64(long iters) {                                          \
+        const C_##ISA##_PD m = C_##ISA##_SET1(ROOF_MUL), c = C_##ISA##_SET1(ROOF_ADD);              \
+        C_##ISA##_PD x[PEAK_FP_CHAINS];                                                             \
+        double lanes[C_##ISA##_LANES], sum = 0;                                                     \
+        UNROLL(12)                                                                                  \
+        for (int j = 0; j < PEAK_FP_CHAINS; j++) {                                                  \
+            x[j] = C_##ISA##_SET1((double)j);                                                       \
+        }                                                                                           \
+        for (long i = 0; i < iters; i++) {                                                          \
+            UNROLL(12)                                                                              \
+            for (int j = 0; j < PEAK_FP_CHAINS; j++) {                                              \
+                x[j] = C_##ISA##_MULADD(x[j], m, c);                                                \
+            }                                                                                       \
+        }                                                                                           \
+        for (int j = 0; j < PEAK_FP_CHAINS; j++) {                                                  \
+            C_##ISA##_STORE(lanes, x[j]);                                                           \
+            for (int l = 0; l < C_##ISA##_LANES; l++) {                                             \
+                sum += lanes[l];                                                                    \
+            }                                                                                       \
+        }                                                                                           \
+        return sum;                                                                                 \
+    }                                                                                               \
+    C_##ISA##_ATTR static double name##_int64(long iters) {                                         \
+        const C_##ISA##_EPI a = C_##ISA##_SET1_EPI(PEAK_INT_ADD), b = C_##ISA##_SET1_EPI(PEAK_INT_XOR); \
+        C_##ISA##_EPI x[PEAK_INT_CHAINS];                                                           \
+        uint64_t lanes[C_##ISA##_LANES], sum = 0;                                                   \
+        UNROLL(8)                                                                                   \
+        for (int j = 0; j < PEAK_INT_CHAINS; j++) {                                                 \
+            x[j] = C_##ISA##_SET1_EPI(j);                                                           \
+        }                                                                                           \
+        for (long i = 0; i < iters; i++) {                                                          \
+            UNROLL(8)                                                                               \
+            for (int j = 0; j < PEAK_INT_CHAINS; j++) {                                             \
+                x[j] = C_##ISA##_XOR_EPI(C_##ISA##_ADD_EPI(x[j], a), b);                            \
+            }                                                                                       \
+        }                                                                                           \
+        for (int j = 0; j < PEAK_INT_CHAINS; j++) {                                                 \
+            C_##ISA##_STORE_EPI(lanes, x[j]);                                                       \
+            for (int l = 0; l < C_##ISA##_LANES; l++) {                                             \
+                sum += lanes[l];                                                                    \
+            }                                                                                       \
+        }                                                                                           \
+        return (double)sum;                                                                         \
+    }
+
+PEAK_KERNELS(SCALAR, scalar)
+PEAK_KERNELS(SSE, sse)
+PEAK_KERNELS(AVX2, avx2)
+PEAK_KERNELS(AVX512, avx512)
+
+#define PEAK_ENTRIES(ISA, name, isa)                                                                \
+    {#name "_fp64", PEAK_FP64, isa, 2.0 * PEAK_FP_CHAINS * C_##ISA##_LANES, name##_fp64},          \
+    {#name "_int64", PEAK_INT64, isa, 2.0 * PEAK_INT_CHAINS * C_##ISA##_LANES, name##_int64},
+
+static const peak_kernel_t peak_kernel_list[] = {
+    PEAK_ENTRIES(SCALAR, scalar, BW_SCALAR)
+    PEAK_ENTRIES(SSE, sse, BW_SSE)
+    PEAK_ENTRIES(AVX2, avx2, BW_AVX2)
+    PEAK_ENTRIES(AVX512, avx512, BW_AVX512)
+};
+
+// ---------------------------------------------------------------- intensity kernels
+
+// One element per chain and iteration: the first fmas - 1 multiply-adds are applied in place
+// and the last one folds the element into its chain's accumulator, so every element costs
+// exactly 'fmas' multiply-adds whatever the instruction set
+#define ROOF_KERNEL(ISA, name, K)                                                                   \
+    C_##ISA##_ATTR static double name##_fma##K(const double *src, size_t bytes) {                   \
+        const C_##ISA##_PD m = C_##ISA##_SET1(ROOF_MUL), c = C_##ISA##_SET1(ROOF_ADD);              \
+        C_##ISA##_PD acc[ROOF_CHAINS], v[ROOF_CHAINS];                                              \
+        double lanes[C_##ISA##_LANES], sum = 0;                                                     \
+        UNROLL(8)                                                                                   \
+        for (int j = 0; j < ROOF_CHAINS; j++) {                                                     \
+            acc[j] = C_##ISA##_SET1(0.0);                                                           \
+        }                                                                                           \
+        for (size_t i = 0; i < bytes / sizeof(double); i += ROOF_CHAINS * C_##ISA##_LANES) {        \
+            UNROLL(8)                                                                               \
+            for (int j = 0; j < ROOF_CHAINS; j++) {                                                 \
+                v[j] = C_##ISA##_LOAD(src + i + j * C_##ISA##_LANES);                               \
+            }                                                                                       \
+            for (int k = 1; k < K; k++) {                                                           \
+                UNROLL(8)                                                                           \
+                for (int j = 0; j < ROOF_CHAINS; j++) {                                             \
+                    v[j] = C_##ISA##_MULADD(v[j], m, c);                                            \
+                }                                                                                   \
+            }                                                                                       \
+            UNROLL(8)                                                                               \
+            for (int j = 0; j < ROOF_CHAINS; j++) {                                                 \
+                acc[j] = C_##ISA##_MULADD(v[j], m, acc[j]);                                         \
+            }                                                                                       \
+        }                                                                                           \
+        for (int j = 0; j < ROOF_CHAINS; j++) {                                                     \
+            C_##ISA##_STORE(lanes, acc[j]);                                                         \
+            for (int l = 0; l < C_##ISA##_LANES; l++) {                                             \
+                sum += lanes[l];                                                                    \
+            }                                                                                       \
+        }                                                                                           \
+        return sum;                                                                                 \
+    }
+
+// Multiply-adds per element of the family: 1/4 to 64 flops per byte
+#define ROOF_FAMILY(R, ISA, name) \
+    R(ISA, name, 1) R(ISA, name, 2) R(ISA, name, 4) R(ISA, name, 8) R(ISA, name, 16) \
+    R(ISA, name, 32) R(ISA, name, 64) R(ISA, name, 128) R(ISA, name, 256)
+
+ROOF_FAMILY(ROOF_KERNEL, SCALAR, scalar)
+ROOF_FAMILY(ROOF_KERNEL, SSE, sse)
+ROOF_FAMILY(ROOF_KERNEL, AVX2, avx2)
+ROOF_FAMILY(ROOF_KERNEL, AVX512, avx512)
+
+#define ROOF_ENTRY(ISA, name, K) {#name "_fma" #K, BW_##ISA, K, name##_fma##K},
+
+static const roof_kernel_t roof_kernel_list[] = {
+    ROOF_FAMILY(ROOF_ENTRY, SCALAR, scalar)
+    ROOF_FAMILY(ROOF_ENTRY, SSE, sse)
+    ROOF_FAMILY(ROOF_ENTRY, AVX2, avx2)
+    ROOF_FAMILY(ROOF_ENTRY, AVX512, avx512)
+};
+
+int compute_isa_supported(bw_isa_t isa) {
+    __builtin_cpu_init();
+    if (isa == BW_AVX2 && !__builtin_cpu_supports("fma")) {
+        return 0;
+    }
+    return bw_isa_supported(isa);
+}
+
+const peak_kernel_t *peak_kernels(int *count) {
+    *count = sizeof(peak_kernel_list) / sizeof(peak_kernel_list[0]);
+    return peak_kernel_list;
+}
+
+const char *peak_kind_name(peak_kind_t kind) {
+    static const char *names[] = {"fp64", "int64"};
+    return kind < PEAK_NUM_KINDS ? names[kind] : "?";
+}
+
+const roof_kernel_t *roof_kernels(int *count) {
+    *count = sizeof(roof_kernel_list) / sizeof(roof_kernel_list[0]);
+    return roof_kernel_list;
+}
+
+const roof_kernel_t *roof_find_kernel(int fmas, bw_isa_t isa) {
+    const roof_kernel_t *best = NULL;
+    int count;
+    const roof_kernel_t *k = roof_kernels(&count);
+    for (int i = 0; i < count; i++) {
+        if (k[i].fmas != fmas || !compute_isa_supported(k[i].isa)) {
+            continue;
+        }
+        if (k[i].isa == isa) {
+            return &k[i];
+        }
+        if (isa == BW_NUM_ISAS && (!best || k[i].isa > best->isa)) {
+            best = &k[i];
+        }
+    }
+    return best;
+}
+
+double roof_intensity(const roof_kernel_t *kernel) {
+    return 2.0 * kernel->fmas / sizeof(double);
+}
@@ -0,0 +1,62 @@
+#ifndef COMPUTE_KERNELS_H
+#define COMPUTE_KERNELS_H
+
+#include <stddef.h>
+
+#include "bandwidth_kernels.h"
+
+#define ROOF_ALIGNMENT 64       // Buffers passed to the intensity kernels must be 64B aligned
+#define ROOF_BLOCK_BYTES 512    // Intensity kernel lengths must be a multiple of this (8 x 64B)
+#define ROOF_MAX_FMAS 256       // Most multiply-adds per element of any intensity kernel
+
+// What a peak kernel counts
+typedef enum {
+    PEAK_FP64,     // Double-precision flops, a multiply-add counted as two
+    PEAK_INT64,    // 64-bit integer adds and xors
+    PEAK_NUM_KINDS
+} peak_kind_t;
+
+// Peak kernels run 'iters' iterations over enough independent dependency chains to cover
+// the instruction latency, touching no memory. The return value is a checksum that callers
+// should keep live.
+typedef double (*peak_kernel_fn)(long iters);
+
+typedef struct {
+    const char *name;     // e.g. "avx2_fp64"
+    peak_kind_t kind;
+    bw_isa_t isa;
+    double ops_per_iter;  // Flops or integer ops per iteration
+    peak_kernel_fn fn;
+} peak_kernel_t;
+
+// Intensity kernels read 'bytes' of doubles once and apply 'fmas' dependent multiply-adds to
+// each element, 2 * fmas flops per 8 bytes, over independent chains so the multiply-adds
+// overlap. Returns a checksum that callers should keep live.
+typedef double (*roof_kernel_fn)(const double *src, size_t bytes);
+
+typedef struct {
+    const char *name;     // e.g. "avx512_fma16"
+    bw_isa_t isa;
+    int fmas;             // Multiply-adds per element: 1, 2, 4, ..., ROOF_MAX_FMAS
+    roof_kernel_fn fn;
+} roof_kernel_t;
+
+// 1 if the CPU can run the compute kernels of an instruction set (AVX2 ones also use FMA)
+int compute_isa_supported(bw_isa_t isa);
+
+// All compiled-in peak kernels, whether or not this CPU can run them
+const peak_kernel_t *peak_kernels(int *count);
+
+const char *peak_kind_name(peak_kind_t kind);
+
+// All compiled-in intensity kernels, whether or not this CPU can run them
+const roof_kernel_t *roof_kernels(int *count);
+
+// Intensity kernel doing 'fmas' multiply-adds per element for an instruction set, or the
+// widest supported one when isa is BW_NUM_ISAS. NULL if there is none.
+const roof_kernel_t *roof_find_kernel(int fmas, bw_isa_t isa);
+
+// Arithmetic intensity of an intensity kernel in flops per byte read
+double roof_intensity(const roof_kernel_t *kernel);
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "corunner.h"
+#include "bench.h"
+#include "topology.h"
+#include "affinity.h"
+#include "pointer_chase.h"
+#include "bandwidth_kernels.h"
+
+#define CORUN_CHAINS 8              // Chains an LLC thrasher keeps in flight
+#define CORUN_CHASE_HOPS 1024       // Loads per chain between checks of the stop flag
+#define CORUN_CHUNK_BYTES (1 << 20) // Bytes streamed between checks of the stop flag
+#define CORUN_MIN_FOOTPRINT (64 * 1024)
+#define CORUN_DESC_LEN 256
+#define CORUN_MAX_CPUS 1024        // Allowed CPUs considered when placing co-runners
+
+// One antagonist thread
+typedef struct {
+    pthread_t thread;
+    corun_kind_t kind;
+    size_t footprint;
+    int cpu;
+    void *buffer;
+} corun_thread_t;
+
+static corun_thread_t threads[CORUN_MAX_THREADS];
+static int num_threads = 0;
+static volatile int stop_flag = 0;
+static volatile int ready_count = 0;
+static char running_desc[CORUN_DESC_LEN];
+static volatile double sink;    // Keeps the kernels' checksums live
+
+static const char *kind_names[CORUN_NUM_KINDS] = {"llc", "stream", "writer"};
+
+const char *corun_kind_name(corun_kind_t kind) {
+    return kind < CORUN_NUM_KINDS ? kind_names[kind] : "unknown";
+}
+
+// Parse one "kind[:footprint[:threads]]" item
+static int parse_spec(char *item, int default_threads, corun_spec_t *spec) {
+    const topology_t *topo = get_topology();
+    char *fields[3] = {item, NULL, NULL};
+    int n = 1;
+
+    for (char *s = item; *s && n < 3; s++) {
+        if (*s == ':') {
+            *s = '\0';
+            fields[n++] = s + 1;
+        }
+    }
+
+    spec->kind = CORUN_NUM_KINDS;
+    for (int k = 0; k < CORUN_NUM_KINDS; k++) {
+        if (strcmp(fields[0], kind_names[k]) == 0) {
+            spec->kind = (corun_kind_t)k;
+        }
+    }
+    if (spec->kind == CORUN_NUM_KINDS) {
+        fprintf(stderr, "Unknown co-runner '%s' (llc, stream or writer)\n", fields[0]);
+        return -1;
+    }
+
+    spec->footprint = spec->kind == CORUN_LLC ? topo->l3_size : 4 * topo->l3_size;
+    if (fields[1] && *fields[1]) {
+        if (!isdigit((unsigned char)fields[1][0])) {
+            fprintf(stderr, "Invalid co-runner footprint '%s'\n", fields[1]);
+            return -1;
+        }
+        spec->footprint = bench_parse_size(fields[1]);
+    }
+    if (spec->footprint < CORUN_MIN_FOOTPRINT) {
+        fprintf(stderr, "Co-runner footprints must be at least %d KB\n", CORUN_MIN_FOOTPRINT / 1024);
+        return -1;
+    }
+
+    spec->threads = default_threads;
+    if (fields[2]) {
+        char *end;
+        spec->threads = (int)strtol(fields[2], &end, 10);
+        if (end == fields[2] || *end != '\0' || spec->threads <= 0) {
+            fprintf(stderr, "Invalid co-runner thread count '%s'\n", fields[2]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int corun_parse(const char *set, int default_threads, corun_spec_t *specs, int max_specs) {
+    char buf[CORUN_DESC_LEN];
+    char *save = NULL;
+    int n = 0;
+
+    snprintf(buf, sizeof(buf), "%s", set);
+    for (char *item = strtok_r(buf, "+", &save); item; item = strtok_r(NULL, "+", &save)) {
+        if (n == max_specs) {
+            fprintf(stderr, "At most %d co-runner kinds per set\n", max_specs);
+            return -1;
+        }
+        if (parse_spec(item, default_threads, &specs[n]) != 0) {
+            return -1;
+        }
+        n++;
+    }
+    if (n == 0) {
+        fprintf(stderr, "Empty co-runner set '%s'\n", set);
+        return -1;
+    }
+    return n;
+}
+
+void corun_describe(const corun_spec_t *specs, int num_specs, char *buf, size_t len) {
+    size_t used = 0;
+
+    buf[0] = '\0';
+    for (int i = 0; i < num_specs && used < len; i++) {
+        used += snprintf(buf + used, len - used, "%s%s %zu KB x%d", i ? " + " : "", corun_kind_name(specs[i].kind),
+                         specs[i].footprint / 1024, specs[i].threads);
+    }
+}
+
+// Function to thrash the LLC: random dependent loads over the footprint, several chains
+// interleaved so the thread keeps lines arriving (and evicting others) at a high rate
+static void run_llc(corun_thread_t *t) {
+    size_t line_size = get_topology()->line_size;
+    size_t num_nodes = t->footprint / line_size;
+    void ***nodes = chain_nodes(build_pointer_chain(t->buffer, t->footprint, line_size), num_nodes);
+    void **heads[CORUN_CHAINS];
+
+    for (int j = 0; j < CORUN_CHAINS; j++) {
+        heads[j] = nodes[j * num_nodes / CORUN_CHAINS];
+    }
+    free(nodes);
+
+    __atomic_add_fetch(&ready_count, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&stop_flag, __ATOMIC_RELAXED)) {
+        chase_pointers_multi(heads, CORUN_CHAINS, CORUN_CHASE_HOPS);
+    }
+    sink = (double)(uintptr_t)heads[0];
+}
+
+// Function to stream over the footprint in chunks with the widest read or cached write kernel
+static void run_stream(corun_thread_t *t, bw_op_t op) {
+    const bw_kernel_t *kernel = bw_best_kernel(op, 0);
+    char *buffer = (char *)t->buffer;
+    double checksum = 0;
+
+    memset(buffer, 1, t->footprint);
+    __atomic_add_fetch(&ready_count, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&stop_flag, __ATOMIC_RELAXED)) {
+        for (size_t offset = 0; offset < t->footprint; offset += CORUN_CHUNK_BYTES) {
+            size_t bytes = t->footprint - offset < CORUN_CHUNK_BYTES ? t->footprint - offset : CORUN_CHUNK_BYTES;
+            checksum += kernel->fn(buffer + offset, buffer + offset, NULL, bytes);
+            if (__atomic_load_n(&stop_flag, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+    }
+    sink = checksum;
+}
+
+static void *corun_worker(void *arg) {
+    corun_thread_t *t = (corun_thread_t *)arg;
+
+    pin_thread(t->cpu);
+    switch (t->kind) {
+        case CORUN_LLC: run_llc(t); break;
+        case CORUN_STREAM: run_stream(t, BW_READ); break;
+        case CORUN_WRITER: run_stream(t, BW_WRITE); break;
+        default: break;
+    }
+    return NULL;
+}
+
+int corun_start(const corun_spec_t *specs, int num_specs, const int *cpus, int num_cpus) {
+    int total = 0;
+
+    if (num_threads > 0) {
+        fprintf(stderr, "Co-runners are already running\n");
+        return -1;
+    }
+    for (int i = 0; i < num_specs; i++) {
+        total += specs[i].threads;
+    }
+    if (total > CORUN_MAX_THREADS || num_cpus <= 0) {
+        fprintf(stderr, "Cannot start %d co-runner threads on %d CPUs\n", total, num_cpus);
+        return -1;
+    }
+
+    // Chains are built from the shared random stream; the caller waits here until every
+    // thread has built its own, so no draws of the benchmark interleave with them
+    uint64_t seed = bench_seed_value();
+    stop_flag = 0;
+    ready_count = 0;
+    for (int i = 0; i < num_specs; i++) {
+        for (int j = 0; j < specs[i].threads; j++) {
+            corun_thread_t *t = &threads[num_threads];
+            t->kind = specs[i].kind;
+            t->footprint = specs[i].footprint - specs[i].footprint % BW_BLOCK_BYTES;
+            t->cpu = cpus[num_threads % num_cpus];
+            t->buffer = bench_alloc(t->footprint, BW_ALIGNMENT);
+            if (pthread_create(&t->thread, NULL, corun_worker, t) != 0) {
+                perror("Error creating co-runner thread");
+                free(t->buffer);
+                corun_stop();
+                return -1;
+            }
+            num_threads++;
+        }
+    }
+    while (__atomic_load_n(&ready_count, __ATOMIC_ACQUIRE) < num_threads) {
+        sched_yield();
+    }
+    // Restart the stream so the benchmark draws the same numbers as when running alone
+    bench_seed(seed);
+
+    corun_describe(specs, num_specs, running_desc, sizeof(running_desc));
+    return num_threads;
+}
+
+void corun_stop(void) {
+    __atomic_store_n(&stop_flag, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        free(threads[i].buffer);
+    }
+    num_threads = 0;
+    running_desc[0] = '\0';
+}
+
+int corun_active(void) {
+    return num_threads;
+}
+
+const char *corun_running(void) {
+    return num_threads > 0 ? running_desc : NULL;
+}
+
+int corun_default_cpus(int *cpus, int max_cpus) {
+    int allowed[CORUN_MAX_CPUS];
+    int n = get_allowed_cpus(allowed, CORUN_MAX_CPUS);
+
+    if (n <= 1) {
+        cpus[0] = allowed[0];
+        return 1;
+    }
+    // Highest CPUs first, keeping the first allowed one for the measurement
+    int count = 0;
+    for (int i = n - 1; i >= 1 && count < max_cpus; i--) {
+        cpus[count++] = allowed[i];
+    }
+    return count;
+}
@@ -0,0 +1,52 @@
+#ifndef CORUNNER_H
+#define CORUNNER_H
+
+#include <stddef.h>
+
+#define CORUN_MAX_SPECS 8       // Antagonist kinds in one set
+#define CORUN_MAX_THREADS 64    // Antagonist threads running at once
+
+// Kind of antagonist thread
+typedef enum {
+    CORUN_LLC,       // Random reads over its footprint, several chains in flight: evicts the LLC
+    CORUN_STREAM,    // Sequential reads with the widest read kernel: consumes memory bandwidth
+    CORUN_WRITER,    // Sequential cached stores: fills the LLC with dirty lines that must be written back
+    CORUN_NUM_KINDS
+} corun_kind_t;
+
+typedef struct {
+    corun_kind_t kind;
+    size_t footprint;           // Bytes each thread works over
+    int threads;                // Threads of this kind
+} corun_spec_t;
+
+// Parse a '+'-separated set such as "llc:24M+stream:1G:2", each item kind[:footprint[:threads]]
+// with kind llc, stream or writer. Omitted footprints default to the L3 size for llc and
+// 4 x L3 otherwise; omitted thread counts to 'default_threads'. Returns how many were parsed,
+// or -1 after reporting the error.
+int corun_parse(const char *set, int default_threads, corun_spec_t *specs, int max_specs);
+
+// Describe a set as "llc 24576 KB x1 + stream 131072 KB x1"
+void corun_describe(const corun_spec_t *specs, int num_specs, char *buf, size_t len);
+
+// Start the antagonists of a set, thread i pinned to cpus[i % num_cpus], and return once all of
+// them have touched their buffers and are running. Only one set runs at a time. Returns the
+// number of threads started, or -1 if a set is already running or allocation fails.
+int corun_start(const corun_spec_t *specs, int num_specs, const int *cpus, int num_cpus);
+
+// Stop and join the running antagonists and free their buffers; does nothing if none run
+void corun_stop(void);
+
+// Number of antagonist threads running (0 when none)
+int corun_active(void);
+
+// Description of the running set for result headers, or NULL when none runs
+const char *corun_running(void);
+
+// CPUs for co-runners: every allowed CPU but the first, highest first, so the measurement can
+// keep the first one. On a single-CPU host that one CPU is returned and has to be shared.
+int corun_default_cpus(int *cpus, int max_cpus);
+
+const char *corun_kind_name(corun_kind_t kind);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "histogram.h"
+
+const double hist_percentiles[HIST_NUM_PERCENTILES] = {50, 90, 99, 99.9, 99.99};
+
+void hist_reset(hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_merge(hist_t *dst, const hist_t *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+uint64_t hist_bucket_low(int index) {
+    if (index < HIST_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    int shift = index / HIST_SUB_BUCKETS - 1;
+    return (uint64_t)(HIST_SUB_BUCKETS + index % HIST_SUB_BUCKETS) << shift;
+}
+
+uint64_t hist_bucket_high(int index) {
+    if (index < HIST_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    int shift = index / HIST_SUB_BUCKETS - 1;
+    return hist_bucket_low(index) + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t hist_percentile(const hist_t *h, double p) {
+    if (h->total == 0) {
+        return 0;
+    }
+    // Rank of the sample at the percentile, counting from 1
+    uint64_t rank = (uint64_t)(p / 100.0 * h->total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t high = hist_bucket_high(i);
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const hist_t *h) {
+    return h->total ? h->sum / h->total : 0;
+}
+
+void hist_print(FILE *out, const hist_t *h) {
+    fprintf(out, "min %llu, mean %.1f", (unsigned long long)(h->total ? h->min : 0), hist_mean(h));
+    for (int i = 0; i < HIST_NUM_PERCENTILES; i++) {
+        fprintf(out, ", p%g %llu", hist_percentiles[i], (unsigned long long)hist_percentile(h, hist_percentiles[i]));
+    }
+    fprintf(out, ", max %llu", (unsigned long long)h->max);
+}
+
+void hist_write_percentiles_header(FILE *out, const char *sep) {
+    fprintf(out, "%sSamples%sMin%sMean", sep, sep, sep);
+    for (int i = 0; i < HIST_NUM_PERCENTILES; i++) {
+        fprintf(out, "%sP%g", sep, hist_percentiles[i]);
+    }
+    fprintf(out, "%sMax", sep);
+}
+
+void hist_write_percentiles(FILE *out, const char *sep, const hist_t *h) {
+    fprintf(out, "%s%llu%s%llu%s%.1f", sep, (unsigned long long)h->total, sep,
+            (unsigned long long)(h->total ? h->min : 0), sep, hist_mean(h));
+    for (int i = 0; i < HIST_NUM_PERCENTILES; i++) {
+        fprintf(out, "%s%llu", sep, (unsigned long long)hist_percentile(h, hist_percentiles[i]));
+    }
+    fprintf(out, "%s%llu", sep, (unsigned long long)h->max);
+}
+
+void hist_write_buckets(FILE *out, const char *sep, const char *prefix, const hist_t *h) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (h->counts[i]) {
+            fprintf(out, "%s%s%llu%s%llu%s%llu\n", prefix, sep, (unsigned long long)hist_bucket_low(i), sep,
+                    (unsigned long long)hist_bucket_high(i), sep, (unsigned long long)h->counts[i]);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Log-linear (HDR-style) buckets: values below HIST_SUB_BUCKETS get one bucket each, and
+// every power of two above that is split into HIST_SUB_BUCKETS equal buckets, so each
+// recorded value is kept to within 1/HIST_SUB_BUCKETS (about 3%) of its true value
+#define HIST_SUB_BITS 5
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+// Percentiles reported for every histogram
+#define HIST_NUM_PERCENTILES 5
+extern const double hist_percentiles[HIST_NUM_PERCENTILES];
+
+// Distribution of per-access latencies, in TSC cycles. One per thread; merged after the run.
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} hist_t;
+
+// Bucket holding 'value'
+static inline int hist_bucket(uint64_t value) {
+    if (value < HIST_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (int)((value >> shift) - HIST_SUB_BUCKETS);
+}
+
+// Record one value; cheap enough to call between timed accesses
+static inline void hist_record(hist_t *h, uint64_t value) {
+    h->counts[hist_bucket(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+void hist_reset(hist_t *h);
+
+// Add every sample of 'src' to 'dst'
+void hist_merge(hist_t *dst, const hist_t *src);
+
+// Smallest and largest value that land in bucket 'index'
+uint64_t hist_bucket_low(int index);
+uint64_t hist_bucket_high(int index);
+
+// Value at percentile 'p' (0-100): the highest value equivalent to the sample at that rank
+uint64_t hist_percentile(const hist_t *h, double p);
+double hist_mean(const hist_t *h);
+
+// Print "min .., mean .., p50 .., ..., max .." on one line
+void hist_print(FILE *out, const hist_t *h);
+
+// Percentile table columns: Samples, Min, Mean, P50 ... P99.99, Max
+void hist_write_percentiles_header(FILE *out, const char *sep);
+void hist_write_percentiles(FILE *out, const char *sep, const hist_t *h);
+
+// Full distribution: one "<prefix><sep>low<sep>high<sep>count" line per non-empty bucket
+void hist_write_buckets(FILE *out, const char *sep, const char *prefix, const hist_t *h);
+
+#endif
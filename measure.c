@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "measure.h"
+#include "bench.h"
+#include "tsc.h"
+
+#define CALIBRATION_PAIRS 1000          // Timer pairs timed to find the timer overhead
+#define CALIBRATION_LOOP 1000000        // Iterations of the empty loop per calibration run
+#define CALIBRATION_RUNS 5              // Calibration runs; the fastest one is kept
+
+// Two-sided 95% Student t quantiles for 1..30 degrees of freedom
+static const double t95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double t_quantile(int dof) {
+    if (dof < 1) {
+        return INFINITY;
+    }
+    return dof <= 30 ? t95[dof - 1] : 1.96;
+}
+
+void measure_config_default(measure_config_t *cfg, int max_trials) {
+    cfg->warmup = (int)bench_param_long("warmup", MEASURE_WARMUP);
+    cfg->min_trials = (int)bench_param_long("min_trials", MEASURE_MIN_TRIALS);
+    cfg->max_trials = (int)bench_param_long("max_trials", max_trials);
+    cfg->ci_target = bench_param_double("ci_target", MEASURE_CI_TARGET);
+    cfg->max_time = bench_param_double("max_time", MEASURE_MAX_TIME);
+    cfg->unstable_cv = bench_param_double("unstable_cv", MEASURE_UNSTABLE_CV);
+
+    if (cfg->max_trials > MEASURE_MAX_TRIALS) {
+        cfg->max_trials = MEASURE_MAX_TRIALS;
+    }
+    if (cfg->max_trials < 1) {
+        cfg->max_trials = 1;
+    }
+    if (cfg->min_trials < 1) {
+        cfg->min_trials = 1;
+    }
+    if (cfg->min_trials > cfg->max_trials) {
+        cfg->min_trials = cfg->max_trials;
+    }
+    if (cfg->warmup < 0) {
+        cfg->warmup = 0;
+    }
+}
+
+// Compare doubles for qsort
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile of sorted samples, interpolating between the two nearest ranks
+static double percentile(const double *sorted, int n, double p) {
+    double rank = p * (n - 1);
+    int lo = (int)rank;
+    int hi = lo + 1 < n ? lo + 1 : lo;
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+// Mean and 95% CI half-width of the first 'n' samples
+static void mean_ci(const double *samples, int n, double *mean, double *stddev, double *ci95) {
+    double sum = 0, sq = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    *mean = sum / n;
+    for (int i = 0; i < n; i++) {
+        sq += (samples[i] - *mean) * (samples[i] - *mean);
+    }
+    *stddev = n > 1 ? sqrt(sq / (n - 1)) : 0.0;
+    *ci95 = n > 1 ? t_quantile(n - 1) * *stddev / sqrt((double)n) : INFINITY;
+}
+
+void measure_summarize(double *samples, int n, double unstable_cv, double ci_target, measure_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->trials = n;
+    if (n == 0) {
+        stats->unstable = 1;
+        return;
+    }
+
+    mean_ci(samples, n, &stats->mean, &stats->stddev, &stats->ci95);
+    qsort(samples, n, sizeof(double), compare_double);
+    stats->min = samples[0];
+    stats->max = samples[n - 1];
+    stats->median = percentile(samples, n, 0.50);
+    stats->p90 = percentile(samples, n, 0.90);
+    stats->p99 = percentile(samples, n, 0.99);
+
+    double scale = fabs(stats->mean);
+    stats->converged = n > 1 && stats->ci95 <= ci_target * scale;
+    stats->unstable = !stats->converged || (scale > 0 && stats->stddev / scale > unstable_cv);
+}
+
+void measure_run(const measure_config_t *cfg, measure_trial_fn fn, void *arg, measure_stats_t *stats) {
+    double samples[MEASURE_MAX_TRIALS];
+    struct timespec start, now;
+    int n = 0;
+
+    for (int i = 0; i < cfg->warmup; i++) {
+        fn(arg);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (n < cfg->max_trials) {
+        samples[n++] = fn(arg);
+
+        if (n >= cfg->min_trials) {
+            double mean, stddev, ci95;
+            mean_ci(samples, n, &mean, &stddev, &ci95);
+            if (n > 1 && ci95 <= cfg->ci_target * fabs(mean)) {
+                break;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (n >= 2 && elapsed_ns(&start, &now) > cfg->max_time * 1e9) {
+            break;
+        }
+    }
+    measure_summarize(samples, n, cfg->unstable_cv, cfg->ci_target, stats);
+}
+
+double measure_timer_overhead_ns(void) {
+    static double overhead = -1;
+    struct timespec start, end;
+
+    if (overhead < 0) {
+        overhead = INFINITY;
+        for (int i = 0; i < CALIBRATION_PAIRS; i++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double ns = elapsed_ns(&start, &end);
+            if (ns < overhead) {
+                overhead = ns;
+            }
+        }
+    }
+    return overhead;
+}
+
+double measure_loop_overhead_ns(void) {
+    static double overhead = -1;
+    struct timespec start, end;
+
+    if (overhead < 0) {
+        double best = INFINITY;
+        for (int r = 0; r < CALIBRATION_RUNS; r++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (long i = 0; i < CALIBRATION_LOOP; i++) {
+                __asm__ __volatile__ ("");  // Keeps the otherwise empty loop
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double ns = measure_elapsed_ns(&start, &end);
+            if (ns < best) {
+                best = ns;
+            }
+        }
+        overhead = best / CALIBRATION_LOOP;
+    }
+    return overhead;
+}
+
+uint64_t measure_tsc_overhead_cycles(void) {
+    static uint64_t overhead = UINT64_MAX;
+
+    if (overhead == UINT64_MAX) {
+        for (int i = 0; i < CALIBRATION_PAIRS; i++) {
+            uint64_t start = rdtsc_start();
+            uint64_t end = rdtscp_stop();
+            if (end - start < overhead) {
+                overhead = end - start;
+            }
+        }
+    }
+    return overhead;
+}
+
+double measure_elapsed_ns(const struct timespec *start, const struct timespec *end) {
+    double ns = elapsed_ns(start, end) - measure_timer_overhead_ns();
+    return ns > 0 ? ns : 0;
+}
+
+void measure_print(FILE *out, const measure_stats_t *stats, const char *unit) {
+    fprintf(out, "median %.3f %s (min %.3f, p90 %.3f, p99 %.3f, stddev %.3f, +-%.3f, %d trials)%s",
+            stats->median, unit, stats->min, stats->p90, stats->p99, stats->stddev,
+            isfinite(stats->ci95) ? stats->ci95 : 0.0, stats->trials, stats->unstable ? " UNSTABLE" : "");
+}
+
+void measure_write_csv_header(FILE *out, const char *sep) {
+    fprintf(out, "%sMin%sMedian%sP90%sP99%sStddev%sCI95%sTrials%sUnstable", sep, sep, sep, sep, sep, sep, sep, sep);
+}
+
+void measure_write_csv_values(FILE *out, const char *sep, const measure_stats_t *stats) {
+    fprintf(out, "%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%d%s%s",
+            sep, stats->min, sep, stats->median, sep, stats->p90, sep, stats->p99, sep, stats->stddev,
+            sep, isfinite(stats->ci95) ? stats->ci95 : 0.0, sep, stats->trials, sep, stats->unstable ? "yes" : "no");
+}
@@ -0,0 +1,73 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MEASURE_MAX_TRIALS 1000     // Upper bound on trials kept per measurement
+#define MEASURE_WARMUP 2            // Default untimed passes before the first trial
+#define MEASURE_MIN_TRIALS 5        // Default trials before convergence is checked
+#define MEASURE_CI_TARGET 0.01      // Default: stop once the 95% CI is within 1% of the mean
+#define MEASURE_MAX_TIME 5.0        // Default time budget per measurement, in seconds
+#define MEASURE_UNSTABLE_CV 0.05    // Default coefficient of variation above which a run is flagged
+
+// How long to keep repeating a measurement. Filled from the bench parameters warmup,
+// min_trials, max_trials, ci_target, max_time and unstable_cv.
+typedef struct {
+    int warmup;                 // Untimed passes before the first trial
+    int min_trials;             // Trials before convergence is checked
+    int max_trials;             // Stop after this many trials even if not converged
+    double ci_target;           // Target 95% CI half-width, as a fraction of the mean
+    double max_time;            // Stop once the trials have taken this long, in seconds
+    double unstable_cv;         // Flag the run when stddev / mean exceeds this
+} measure_config_t;
+
+// Summary of the trials of one measurement
+typedef struct {
+    int trials;
+    double mean;
+    double min;
+    double median;
+    double p90;
+    double p99;
+    double max;
+    double stddev;
+    double ci95;                // Half-width of the 95% confidence interval of the mean
+    int converged;              // 1 if the CI target was met
+    int unstable;               // 1 if not converged or the spread exceeds unstable_cv
+} measure_stats_t;
+
+// One trial: run the timed work once and return its value (e.g. ns per access)
+typedef double (*measure_trial_fn)(void *arg);
+
+// Defaults from the bench parameters; 'max_trials' is the benchmark's own default cap
+void measure_config_default(measure_config_t *cfg, int max_trials);
+
+// Run cfg->warmup untimed trials, then repeat trials until the CI target, max_trials or
+// the time budget is reached, and summarize them
+void measure_run(const measure_config_t *cfg, measure_trial_fn fn, void *arg, measure_stats_t *stats);
+
+// Summarize 'n' samples already collected (sorted in place)
+void measure_summarize(double *samples, int n, double unstable_cv, double ci_target, measure_stats_t *stats);
+
+// Calibrated cost of one clock_gettime(CLOCK_MONOTONIC) start/end pair, in ns
+double measure_timer_overhead_ns(void);
+
+// Calibrated cost of one iteration of an empty counted loop, in ns
+double measure_loop_overhead_ns(void);
+
+// Calibrated cost of an empty rdtsc_start()/rdtscp_stop() pair, in TSC cycles
+uint64_t measure_tsc_overhead_cycles(void);
+
+// Elapsed ns between two timestamps with the timer overhead removed (never negative)
+double measure_elapsed_ns(const struct timespec *start, const struct timespec *end);
+
+// Print "median X (min .., p90 .., p99 .., stddev .., +-CI, N trials)" plus an UNSTABLE flag
+void measure_print(FILE *out, const measure_stats_t *stats, const char *unit);
+
+// Append the summary columns to a CSV header line / row
+void measure_write_csv_header(FILE *out, const char *sep);
+void measure_write_csv_values(FILE *out, const char *sep, const measure_stats_t *stats);
+
+#endif
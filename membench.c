@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "tsc.h"
+#include "affinity.h"
+
+// Entry points of the experiments, built from proj1-*.c with -DMEMBENCH
+int latency_main(int argc, char *argv[]);
+int bandwidth_main(int argc, char *argv[]);
+int throughput_main(int argc, char *argv[]);
+int compute_main(int argc, char *argv[]);
+int cache_miss_main(int argc, char *argv[]);
+int page_backing_main(int argc, char *argv[]);
+int tlb_main(int argc, char *argv[]);
+int coherence_main(int argc, char *argv[]);
+int associativity_main(int argc, char *argv[]);
+int interference_main(int argc, char *argv[]);
+int numa_main(int argc, char *argv[]);
+
+typedef struct {
+    const char *name;         // Subcommand and config-file section
+    const char *program;      // Standalone binary running the same experiment
+    int (*fn)(int argc, char *argv[]);
+    const char *usage;
+} command_t;
+
+static const command_t commands[] = {
+    {"latency", "proj1-1", latency_main, "[chase|independent|both|histogram|patterns [list]|mlp [max chains]|sweep [max MB] [points/octave]]"},
+    {"bandwidth", "proj1-2", bandwidth_main, "[stream|parallel [max threads]|ratio|patterns [list]|granularity]"},
+    {"throughput", "proj1-3", throughput_main, "[sweep|loaded [injectors]|histogram [max threads]|placement [max threads]]"},
+    {"compute", "proj1-4", compute_main, "[sweep|roofline]"},
+    {"cache-miss", "proj1-4b", cache_miss_main, ""},
+    {"page-backing", "proj1-5", page_backing_main, "[latency|faults [max threads]]"},
+    {"tlb", "proj1-5b", tlb_main, "[arena MB]"},
+    {"coherence", "proj1-6", coherence_main, "[matrix|false-sharing [max threads]]"},
+    {"associativity", "proj1-7", associativity_main, "[ways [max stride KB]|aliasing]"},
+    {"interference", "proj1-8", interference_main, "[set,set,... e.g. llc,stream,writer,llc:8M+stream:1G:2]"},
+    {"numa", "proj1-9", numa_main, "[matrix]"},
+};
+#define NUM_COMMANDS (int)(sizeof(commands) / sizeof(commands[0]))
+
+// Steps of "membench all": every experiment in its default configuration, plus the
+// alternative modes that produce their own result files
+static const struct {
+    const char *command;
+    const char *mode;
+} all_steps[] = {
+    {"latency", "sweep"},
+    {"latency", "histogram"},
+    {"latency", "patterns"},
+    {"latency", "mlp"},
+    {"bandwidth", "stream"},
+    {"bandwidth", "parallel"},
+    {"bandwidth", "patterns"},
+    {"bandwidth", "granularity"},
+    {"throughput", "sweep"},
+    {"throughput", "loaded"},
+    {"throughput", "histogram"},
+    {"throughput", "placement"},
+    {"compute", "sweep"},
+    {"compute", "roofline"},
+    {"cache-miss", NULL},
+    {"page-backing", "latency"},
+    {"page-backing", "faults"},
+    {"tlb", NULL},
+    {"coherence", "matrix"},
+    {"coherence", "false-sharing"},
+    {"associativity", "ways"},
+    {"associativity", "aliasing"},
+    {"interference", NULL},
+    {"numa", NULL},
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <command> [args] [key=value ...] [--config FILE] [--format csv|json|both] [--output DIR]\n\n",
+            prog);
+    fprintf(stderr, "Commands:\n");
+    for (int i = 0; i < NUM_COMMANDS; i++) {
+        fprintf(stderr, "  %-13s %-99s (%s)\n", commands[i].name, commands[i].usage, commands[i].program);
+    }
+    fprintf(stderr, "  %-13s %s\n", "all", "run every experiment in one pass");
+    fprintf(stderr, "  %-13s %s\n", "topology", "print the detected cache and TLB topology and the TSC clock");
+}
+
+static const command_t *find_command(const char *name) {
+    for (int i = 0; i < NUM_COMMANDS; i++) {
+        if (strcmp(commands[i].name, name) == 0 || strcmp(commands[i].program, name) == 0) {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to run one experiment with its own argv (argv[0] is the command name)
+static int run_command(const command_t *cmd, int argc, char *argv[]) {
+    bench_set_command(cmd->name);
+    return cmd->fn(argc, argv);
+}
+
+// Function to run every step of the full characterization, continuing past failures. Steps
+// that pin the main thread would narrow the CPUs every later step sees, so each step starts
+// from the mask the process started with.
+static int run_all(void) {
+    int failed = 0;
+    cpu_mask_t startup;
+
+    save_thread_affinity(&startup);
+
+    for (int i = 0; i < (int)(sizeof(all_steps) / sizeof(all_steps[0])); i++) {
+        const command_t *cmd = find_command(all_steps[i].command);
+        char *argv[3] = {(char *)cmd->name, (char *)all_steps[i].mode, NULL};
+        int argc = all_steps[i].mode ? 2 : 1;
+
+        printf("\n==== %s %s ====\n", cmd->name, all_steps[i].mode ? all_steps[i].mode : "");
+        fflush(stdout);
+        restore_thread_affinity(&startup);
+        if (run_command(cmd, argc, argv) != 0) {
+            fprintf(stderr, "%s %s failed\n", cmd->name, all_steps[i].mode ? all_steps[i].mode : "");
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, NULL);
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "all") == 0) {
+        return run_all();
+    }
+    if (strcmp(argv[1], "topology") == 0) {
+        topology_write_header(stdout, get_topology());
+        tsc_write_header(stdout);
+        return 0;
+    }
+    const command_t *cmd = find_command(argv[1]);
+    if (!cmd) {
+        fprintf(stderr, "Unknown command '%s'\n\n", argv[1]);
+        usage(argv[0]);
+        return 1;
+    }
+    return run_command(cmd, argc - 1, argv + 1);
+}
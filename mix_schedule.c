@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mix_schedule.h"
+#include "bench.h"
+
+void mix_spec_single(mix_spec_t *spec, mix_op_t op) {
+    memset(spec, 0, sizeof(*spec));
+    spec->ratio[op] = 1.0;
+    spec->burst = 1;
+    spec->order = MIX_RANDOM;
+}
+
+int mix_spec_params(mix_spec_t *spec) {
+    const char *order = bench_param_str("mix_order", "random");
+
+    spec->burst = (int)bench_param_long("mix_burst", 1);
+    if (strcmp(order, "random") == 0) {
+        spec->order = MIX_RANDOM;
+    } else if (strcmp(order, "interleaved") == 0) {
+        spec->order = MIX_INTERLEAVED;
+    } else {
+        return -1;
+    }
+    return spec->burst > 0 ? 0 : -1;
+}
+
+int mix_spec_parse(const char *ratios, mix_spec_t *spec) {
+    double sum = 0;
+    int n;
+
+    memset(spec, 0, sizeof(*spec));
+    n = sscanf(ratios, "%lf:%lf:%lf", &spec->ratio[MIX_READ], &spec->ratio[MIX_WRITE], &spec->ratio[MIX_RMW]);
+    if (mix_spec_params(spec) != 0) {
+        return -1;
+    }
+    for (int op = 0; op < MIX_NUM_OPS; op++) {
+        if (spec->ratio[op] < 0) {
+            return -1;
+        }
+        sum += spec->ratio[op];
+    }
+    return n >= 2 && sum > 0 ? 0 : -1;
+}
+
+void mix_spec_describe(const mix_spec_t *spec, char *buf, size_t len) {
+    double sum = spec->ratio[MIX_READ] + spec->ratio[MIX_WRITE] + spec->ratio[MIX_RMW];
+    snprintf(buf, len, "%.0f%% read, %.0f%% write, %.0f%% rmw, burst %d, %s", 100 * spec->ratio[MIX_READ] / sum,
+             100 * spec->ratio[MIX_WRITE] / sum, 100 * spec->ratio[MIX_RMW] / sum, spec->burst,
+             spec->order == MIX_INTERLEAVED ? "interleaved" : "random");
+}
+
+// Operation of the next burst. Random bursts sample the normalized ratios; interleaved ones
+// go to the operation furthest behind its share so far, which repeats with a short period.
+static mix_op_t next_op(const mix_spec_t *spec, const double *share, const size_t *bursts, size_t total) {
+    if (spec->order == MIX_RANDOM) {
+        double u = bench_random_unit();
+        for (int op = 0; op < MIX_NUM_OPS - 1; op++) {
+            if (u <= share[op]) {
+                return (mix_op_t)op;
+            }
+            u -= share[op];
+        }
+        return (mix_op_t)(MIX_NUM_OPS - 1);
+    }
+
+    int best = -1;
+    double best_deficit = 0;
+    for (int op = 0; op < MIX_NUM_OPS; op++) {
+        double deficit = share[op] * (total + 1) - bursts[op];
+        if (share[op] > 0 && (best < 0 || deficit > best_deficit)) {
+            best = op;
+            best_deficit = deficit;
+        }
+    }
+    return (mix_op_t)best;
+}
+
+void mix_build(const mix_spec_t *spec, size_t count, mix_schedule_t *sched) {
+    double sum = spec->ratio[MIX_READ] + spec->ratio[MIX_WRITE] + spec->ratio[MIX_RMW];
+    double share[MIX_NUM_OPS];
+    size_t bursts[MIX_NUM_OPS] = {0};
+    size_t burst = spec->burst > 0 ? (size_t)spec->burst : 1;
+    size_t max_runs = count / burst + 1;
+
+    for (int op = 0; op < MIX_NUM_OPS; op++) {
+        share[op] = spec->ratio[op] / sum;
+    }
+    memset(sched, 0, sizeof(*sched));
+    sched->runs = (mix_run_t *) malloc(max_runs * sizeof(mix_run_t));
+    if (!sched->runs) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Merge consecutive bursts of the same operation into one run
+    for (size_t done = 0, b = 0; done < count; b++) {
+        mix_op_t op = next_op(spec, share, bursts, b);
+        size_t length = count - done < burst ? count - done : burst;
+        mix_run_t *last = sched->num_runs ? &sched->runs[sched->num_runs - 1] : NULL;
+
+        bursts[op]++;
+        if (last && last->op == (uint32_t)op && last->length + length <= UINT32_MAX) {
+            last->length += (uint32_t)length;
+        } else {
+            sched->runs[sched->num_runs].op = (uint32_t)op;
+            sched->runs[sched->num_runs].length = (uint32_t)length;
+            sched->num_runs++;
+        }
+        sched->op_count[op] += length;
+        done += length;
+    }
+    sched->count = count;
+}
+
+void mix_free(mix_schedule_t *sched) {
+    free(sched->runs);
+    sched->runs = NULL;
+    sched->num_runs = 0;
+    sched->count = 0;
+}
+
+const char *mix_op_name(mix_op_t op) {
+    static const char *names[] = {"read", "write", "rmw"};
+    return op < MIX_NUM_OPS ? names[op] : "?";
+}
@@ -0,0 +1,64 @@
+#ifndef MIX_SCHEDULE_H
+#define MIX_SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Operation applied to one element of a read/write mix
+typedef enum {
+    MIX_READ,
+    MIX_WRITE,
+    MIX_RMW,
+    MIX_NUM_OPS
+} mix_op_t;
+
+// How a mix is laid out over the operation stream
+typedef enum {
+    MIX_RANDOM,                       // Each burst picks its operation from the seeded stream
+    MIX_INTERLEAVED                   // Bursts spread evenly in a fixed, repeating order
+} mix_order_t;
+
+// A read/write/RMW mix. The ratios need not sum to 1; they are normalized when built.
+typedef struct {
+    double ratio[MIX_NUM_OPS];
+    int burst;                        // Consecutive operations of the same kind
+    mix_order_t order;
+} mix_spec_t;
+
+// One run of identical operations
+typedef struct {
+    uint32_t op;
+    uint32_t length;
+} mix_run_t;
+
+// Precomputed operation stream, run-length encoded so a kernel branches once per run
+// rather than once per operation
+typedef struct {
+    mix_run_t *runs;
+    size_t num_runs;
+    size_t count;                     // Operations in all runs
+    size_t op_count[MIX_NUM_OPS];
+} mix_schedule_t;
+
+// A mix of a single operation
+void mix_spec_single(mix_spec_t *spec, mix_op_t op);
+
+// Set the burst length and order of a mix from the bench parameters mix_burst and mix_order
+// (random|interleaved). Returns 0 on success.
+int mix_spec_params(mix_spec_t *spec);
+
+// Parse "R:W:M" ratios (e.g. "70:20:10") and apply mix_spec_params(). Returns 0 on success.
+int mix_spec_parse(const char *ratios, mix_spec_t *spec);
+
+// Describe a mix as "70% read, 20% write, 10% rmw, burst 1, random"
+void mix_spec_describe(const mix_spec_t *spec, char *buf, size_t len);
+
+// Build 'count' operations of a mix, drawing random orders from the seeded bench stream
+// (bench_random), so the same seed replays the same schedule on any host
+void mix_build(const mix_spec_t *spec, size_t count, mix_schedule_t *sched);
+
+void mix_free(mix_schedule_t *sched);
+
+const char *mix_op_name(mix_op_t op);
+
+#endif
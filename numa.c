@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#include "numa.h"
+#include "affinity.h"
+
+// Memory policy modes and flags of <linux/mempolicy.h>, which is not always installed
+#define NUMA_MPOL_DEFAULT 0
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_INTERLEAVE 3
+#define NUMA_MPOL_MF_STRICT (1 << 0)
+#define NUMA_MPOL_MF_MOVE (1 << 1)
+
+#define SYSFS_NODE_DIR "/sys/devices/system/node"
+#define NODE_MASK_WORDS ((NUMA_MAX_NODES + 63) / 64)
+#define BASE_PAGE 4096
+
+// Parse a sysfs list such as "0-3,8" into ascending numbers below 'limit'; returns how many
+static int parse_list(const char *list, int *values, int max_values, int limit) {
+    const char *s = list;
+    int n = 0;
+
+    while (*s && *s != '\n') {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if (end == s) {
+            break;
+        }
+        if (*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long v = first; v <= last && n < max_values; v++) {
+            if (v < limit) {
+                values[n++] = (int)v;
+            }
+        }
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// Read a sysfs node list file; returns -1 if it does not exist
+static int read_node_list(const char *name, int *values, int max_values, int limit) {
+    char path[256], buf[4096];
+    FILE *f;
+
+    snprintf(path, sizeof(path), SYSFS_NODE_DIR "/%s", name);
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    if (!fgets(buf, sizeof(buf), f)) {
+        buf[0] = '\0';
+    }
+    fclose(f);
+    return parse_list(buf, values, max_values, limit);
+}
+
+int numa_memory_nodes(int *nodes, int max_nodes) {
+    int n = read_node_list("has_memory", nodes, max_nodes, NUMA_MAX_NODES);
+
+    if (n <= 0) {
+        n = read_node_list("online", nodes, max_nodes, NUMA_MAX_NODES);
+    }
+    if (n <= 0) {
+        nodes[0] = 0;
+        n = 1;
+    }
+    return n;
+}
+
+// The CPUs the calling thread may run on the first time this is called, before any binding
+// here narrows the thread's mask; later calls return the same snapshot
+static int allowed_cpus(const int **cpus) {
+    static int allowed[PLACE_MAX_CPUS];
+    static int num_allowed = -1;
+
+    if (num_allowed < 0) {
+        num_allowed = get_allowed_cpus(allowed, PLACE_MAX_CPUS);
+    }
+    *cpus = allowed;
+    return num_allowed;
+}
+
+int numa_node_cpus(int node, int *cpus, int max_cpus) {
+    static int node_cpus[PLACE_MAX_CPUS];
+    char name[64];
+    const int *allowed;
+    int num_allowed = allowed_cpus(&allowed);
+
+    snprintf(name, sizeof(name), "node%d/cpulist", node);
+    int num_node = read_node_list(name, node_cpus, PLACE_MAX_CPUS, PLACE_MAX_CPUS);
+    if (num_node < 0) {
+        // No NUMA sysfs: one node with every CPU
+        num_node = node == 0 ? num_allowed : 0;
+        memcpy(node_cpus, allowed, num_node * sizeof(int));
+    }
+
+    int n = 0;
+    for (int i = 0; i < num_node && n < max_cpus; i++) {
+        for (int j = 0; j < num_allowed; j++) {
+            if (allowed[j] == node_cpus[i]) {
+                cpus[n++] = node_cpus[i];
+                break;
+            }
+        }
+    }
+    return n;
+}
+
+// Build the node bitmask the mempolicy calls take
+static void node_mask(unsigned long *mask, const int *nodes, int num_nodes) {
+    memset(mask, 0, NODE_MASK_WORDS * sizeof(unsigned long));
+    for (int i = 0; i < num_nodes; i++) {
+        mask[nodes[i] / 64] |= 1UL << (nodes[i] % 64);
+    }
+}
+
+int numa_bind_range(void *addr, size_t len, int node) {
+    unsigned long mask[NODE_MASK_WORDS];
+
+    node_mask(mask, &node, 1);
+    return (int)syscall(SYS_mbind, addr, len, NUMA_MPOL_BIND, mask, NUMA_MAX_NODES + 1,
+                        NUMA_MPOL_MF_STRICT | NUMA_MPOL_MF_MOVE);
+}
+
+int numa_interleave_range(void *addr, size_t len, const int *nodes, int num_nodes) {
+    unsigned long mask[NODE_MASK_WORDS];
+
+    node_mask(mask, nodes, num_nodes);
+    return (int)syscall(SYS_mbind, addr, len, NUMA_MPOL_INTERLEAVE, mask, NUMA_MAX_NODES + 1,
+                        NUMA_MPOL_MF_STRICT | NUMA_MPOL_MF_MOVE);
+}
+
+int numa_bind_thread(int node) {
+    static int node_cpus[PLACE_MAX_CPUS];
+    const int *cpus = node_cpus;
+    unsigned long mask[NODE_MASK_WORDS];
+    cpu_set_t set;
+    int num_cpus = node < 0 ? allowed_cpus(&cpus) : numa_node_cpus(node, node_cpus, PLACE_MAX_CPUS);
+
+    if (num_cpus == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    CPU_ZERO(&set);
+    for (int i = 0; i < num_cpus; i++) {
+        CPU_SET(cpus[i], &set);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return -1;
+    }
+    if (node < 0) {
+        return (int)syscall(SYS_set_mempolicy, NUMA_MPOL_DEFAULT, NULL, 0);
+    }
+    node_mask(mask, &node, 1);
+    return (int)syscall(SYS_set_mempolicy, NUMA_MPOL_BIND, mask, NUMA_MAX_NODES + 1);
+}
+
+int numa_page_nodes(const void *addr, size_t len, int *counts, int max_nodes) {
+    size_t num_pages = len / BASE_PAGE;
+    int samples = num_pages < NUMA_SAMPLE_PAGES ? (int)num_pages : NUMA_SAMPLE_PAGES;
+    void *pages[NUMA_SAMPLE_PAGES];
+    int status[NUMA_SAMPLE_PAGES];
+
+    memset(counts, 0, max_nodes * sizeof(int));
+    if (samples == 0) {
+        return 0;
+    }
+    for (int i = 0; i < samples; i++) {
+        size_t page = (size_t)i * num_pages / samples;
+        pages[i] = (char *)addr + page * BASE_PAGE;
+    }
+    // With no target nodes, move_pages only reports where each page is
+    if (syscall(SYS_move_pages, 0, (unsigned long)samples, pages, NULL, status, 0) != 0) {
+        return -1;
+    }
+    int counted = 0;
+    for (int i = 0; i < samples; i++) {
+        if (status[i] >= 0 && status[i] < max_nodes) {
+            counts[status[i]]++;
+            counted++;
+        }
+    }
+    return counted;
+}
@@ -0,0 +1,35 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stddef.h>
+
+#define NUMA_MAX_NODES 64       // Nodes tracked; node numbers must be below this too
+#define NUMA_SAMPLE_PAGES 1024  // Pages queried when checking where a buffer landed
+
+// NUMA layer over the raw mbind / set_mempolicy / move_pages system calls, so nothing links
+// against libnuma. Node layout comes from /sys/devices/system/node; a kernel without it is
+// treated as one node holding every CPU.
+
+// Online nodes with memory, ascending; returns how many (at least one)
+int numa_memory_nodes(int *nodes, int max_nodes);
+
+// Allowed CPUs of a node, ascending; returns how many (0 for memory-only nodes). "Allowed" is
+// the calling thread's mask at the first call into this layer, so binding or pinning the
+// thread afterwards does not hide the other nodes' CPUs.
+int numa_node_cpus(int node, int *cpus, int max_cpus);
+
+// Bind a page-aligned, not yet touched range to one node (MPOL_BIND), or interleave it page
+// by page over several (MPOL_INTERLEAVE). Returns 0 on success, -1 with errno set.
+int numa_bind_range(void *addr, size_t len, int node);
+int numa_interleave_range(void *addr, size_t len, const int *nodes, int num_nodes);
+
+// Run the calling thread on a node's CPUs and allocate its memory there (set_mempolicy
+// MPOL_BIND); node -1 restores the allowed CPUs above and the default policy. Returns 0 on
+// success.
+int numa_bind_thread(int node);
+
+// Count the touched pages of a range per node, sampling up to NUMA_SAMPLE_PAGES evenly spaced
+// base pages with move_pages. Returns the pages sampled, or -1 if the kernel cannot tell.
+int numa_page_nodes(const void *addr, size_t len, int *counts, int max_nodes);
+
+#endif
@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "page_alloc.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define SIZE_2MB (2UL * 1024 * 1024)
+#define SIZE_1GB (1024UL * 1024 * 1024)
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+// Try a single backend without falling back, adding 'extra_flags' to the mmap flags
+static int try_backing(page_buffer_t *buf, size_t size, page_backing_t backing, int extra_flags) {
+    void *p;
+
+    switch (backing) {
+        case BACKING_HUGETLB_1G:
+        case BACKING_HUGETLB_2M: {
+            size_t page = backing == BACKING_HUGETLB_1G ? SIZE_1GB : SIZE_2MB;
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                        (backing == BACKING_HUGETLB_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+            size_t map_size = round_up(size, page);
+            p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, flags | extra_flags, -1, 0);
+            if (p == MAP_FAILED) {
+                return -1;
+            }
+            buf->addr = buf->map_addr = p;
+            buf->map_size = map_size;
+            break;
+        }
+        case BACKING_THP: {
+            // Over-allocate so the buffer can start on a 2MB boundary. MAP_POPULATE here faults the
+            // pages in before madvise(), so in "madvise" THP mode they come as base pages.
+            size_t map_size = round_up(size, SIZE_2MB) + SIZE_2MB;
+            p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+            if (p == MAP_FAILED) {
+                return -1;
+            }
+            void *aligned = (void *)round_up((uintptr_t)p, SIZE_2MB);
+            if (madvise(aligned, round_up(size, SIZE_2MB), MADV_HUGEPAGE) != 0) {
+                munmap(p, map_size);
+                return -1;
+            }
+            buf->addr = aligned;
+            buf->map_addr = p;
+            buf->map_size = map_size;
+            break;
+        }
+        default: {
+            size_t map_size = round_up(size, 4096);
+            p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+            if (p == MAP_FAILED) {
+                return -1;
+            }
+            // Keep khugepaged from collapsing the base-page baseline in THP "always" mode
+            madvise(p, map_size, MADV_NOHUGEPAGE);
+            buf->addr = buf->map_addr = p;
+            buf->map_size = map_size;
+            break;
+        }
+    }
+    buf->size = size;
+    buf->backing = backing;
+    return 0;
+}
+
+int page_alloc(page_buffer_t *buf, size_t size, page_backing_t requested) {
+    memset(buf, 0, sizeof(*buf));
+    buf->requested = requested;
+    for (int b = requested; b >= BACKING_4K; b--) {
+        // MAP_POPULATE makes a missing hugetlbfs reservation fail here rather than SIGBUS later
+        if (try_backing(buf, size, (page_backing_t)b, b >= BACKING_HUGETLB_2M ? MAP_POPULATE : 0) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int page_map(page_buffer_t *buf, size_t size, page_backing_t backing, int extra_flags) {
+    memset(buf, 0, sizeof(*buf));
+    buf->requested = backing;
+    return try_backing(buf, size, backing, extra_flags);
+}
+
+void page_free(page_buffer_t *buf) {
+    if (buf->map_addr) {
+        munmap(buf->map_addr, buf->map_size);
+    }
+    buf->addr = buf->map_addr = NULL;
+}
+
+int page_backing_verify(const page_buffer_t *buf, page_backing_info_t *info) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    char line[512];
+    uintptr_t target = (uintptr_t)buf->addr;
+    int in_vma = 0, found = 0;
+
+    memset(info, 0, sizeof(*info));
+    if (!f) {
+        return -1;
+    }
+
+    // Sum the fields over every VMA overlapping the buffer (THP can split the mapping)
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end, kb;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            in_vma = end > target && start < target + buf->size;
+            found |= in_vma;
+            continue;
+        }
+        if (!in_vma) {
+            continue;
+        }
+        if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1) {
+            info->kernel_page_size = kb * 1024;
+        } else if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            info->huge_bytes += kb * 1024;
+        } else if (sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+                   sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1) {
+            info->huge_bytes += kb * 1024;
+            info->rss_bytes += kb * 1024;  // hugetlb pages are not counted in Rss
+        } else if (sscanf(line, "Rss: %lu kB", &kb) == 1) {
+            info->rss_bytes += kb * 1024;
+        }
+    }
+    fclose(f);
+    return found ? 0 : -1;
+}
+
+const char *page_backing_name(page_backing_t backing) {
+    static const char *names[] = {"4KB pages", "THP (madvise)", "2MB hugetlb", "1GB hugetlb"};
+    return backing < BACKING_NUM ? names[backing] : "?";
+}
@@ -0,0 +1,49 @@
+#ifndef PAGE_ALLOC_H
+#define PAGE_ALLOC_H
+
+#include <stddef.h>
+
+// How a buffer's pages are backed, from smallest to largest page
+typedef enum {
+    BACKING_4K,          // Plain anonymous mmap with base pages
+    BACKING_THP,         // Anonymous mmap with madvise(MADV_HUGEPAGE)
+    BACKING_HUGETLB_2M,  // MAP_HUGETLB with 2MB pages
+    BACKING_HUGETLB_1G,  // MAP_HUGETLB | MAP_HUGE_1GB
+    BACKING_NUM
+} page_backing_t;
+
+typedef struct {
+    void *addr;                // Start of the usable buffer
+    size_t size;               // Usable length requested by the caller
+    void *map_addr;            // What to munmap
+    size_t map_size;
+    page_backing_t requested;  // Backing asked for
+    page_backing_t backing;    // Backend that actually produced the mapping
+} page_buffer_t;
+
+// What /proc/self/smaps says about a buffer
+typedef struct {
+    size_t kernel_page_size;   // KernelPageSize of the mapping in bytes
+    size_t huge_bytes;         // Bytes backed by huge pages (AnonHugePages or hugetlb)
+    size_t rss_bytes;          // Resident bytes
+} page_backing_info_t;
+
+// Map 'size' bytes with the requested backing. When a backend is unavailable (no
+// hugetlbfs pages reserved, THP disabled, ...) fall back to the next smaller one and
+// record it in buf->backing. Returns 0 on success, -1 if even base pages fail.
+int page_alloc(page_buffer_t *buf, size_t size, page_backing_t requested);
+
+// Map 'size' bytes with exactly one backing and no fallback, adding 'extra_flags' (e.g.
+// MAP_POPULATE) to the mmap flags. Unlike page_alloc() nothing is faulted in unless the flags
+// ask for it, so first touches pay the page faults. Returns 0 on success, -1 if unavailable.
+int page_map(page_buffer_t *buf, size_t size, page_backing_t backing, int extra_flags);
+
+void page_free(page_buffer_t *buf);
+
+// Read the backing the kernel actually gave the buffer. Touch the buffer first: THP and
+// hugetlb pages only show up once faulted in. Returns 0 on success.
+int page_backing_verify(const page_buffer_t *buf, page_backing_info_t *info);
+
+const char *page_backing_name(page_backing_t backing);
+
+#endif
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <cpuid.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf_counters.h"
+
+// Generic cache events are encoded as cache id | (op << 8) | (result << 16)
+#define HW_CACHE_EVENT(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+// Raw event encoding: event select in bits 0-7, unit mask in bits 8-15
+#define RAW_EVENT(event, umask) ((uint64_t)(event) | ((uint64_t)(umask) << 8))
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int group;
+} event_desc_t;
+
+static const char *counter_names[PC_NUM_COUNTERS] = {
+    "PMU Cycles", "Instructions", "L1D Misses", "L2 Misses", "LLC Misses",
+    "dTLB Load Misses", "dTLB Store Misses", "Page Walks",
+};
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// Fill in the event list for this CPU. L2 misses and page walks have no generic
+// encoding, so they use raw events for Intel (Skylake and later) and AMD Zen and stay
+// unavailable anywhere else.
+static void describe_events(event_desc_t *events) {
+    unsigned int eax, ebx, ecx, edx;
+    char vendor[13] = "";
+    int family = 0;
+
+    if (__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        memcpy(vendor, &ebx, 4);
+        memcpy(vendor + 4, &edx, 4);
+        memcpy(vendor + 8, &ecx, 4);
+        __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+        family = (eax >> 8) & 0xf;
+        if (family == 0xf) {
+            family += (eax >> 20) & 0xff;
+        }
+    }
+    int intel = strcmp(vendor, "GenuineIntel") == 0 && family == 6;
+    int zen = strcmp(vendor, "AuthenticAMD") == 0 && family >= 0x17;
+
+    events[PC_CYCLES] = (event_desc_t){"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0};
+    events[PC_INSTRUCTIONS] = (event_desc_t){"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0};
+    events[PC_L1D_MISSES] = (event_desc_t){"L1D read misses", PERF_TYPE_HW_CACHE,
+        HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), 0};
+    events[PC_LLC_MISSES] = (event_desc_t){"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 0};
+
+    // L2_RQSTS.DEMAND_DATA_RD_MISS on Intel, L2CacheReqStat.LsRdBlkC on Zen
+    events[PC_L2_MISSES] = (event_desc_t){"L2 misses", PERF_TYPE_RAW,
+        intel ? RAW_EVENT(0x24, 0x21) : RAW_EVENT(0x64, 0x08), 1};
+    events[PC_DTLB_LOAD_MISSES] = (event_desc_t){"dTLB load misses", PERF_TYPE_HW_CACHE,
+        HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), 1};
+    events[PC_DTLB_STORE_MISSES] = (event_desc_t){"dTLB store misses", PERF_TYPE_HW_CACHE,
+        HW_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS), 1};
+    // DTLB_LOAD_MISSES.WALK_COMPLETED on Intel, LsL1DTlbMiss (all L2 TLB misses) on Zen
+    events[PC_PAGE_WALKS] = (event_desc_t){"page walks", PERF_TYPE_RAW,
+        intel ? RAW_EVENT(0x08, 0x0e) : RAW_EVENT(0x45, 0xf0), 1};
+
+    if (!intel && !zen) {
+        events[PC_L2_MISSES].name = NULL;
+        events[PC_PAGE_WALKS].name = NULL;
+    }
+}
+
+int perf_counters_open(perf_counters_t *pc) {
+    event_desc_t events[PC_NUM_COUNTERS];
+
+    describe_events(events);
+    memset(pc, 0, sizeof(*pc));
+    for (int g = 0; g < PC_NUM_GROUPS; g++) {
+        pc->leader[g] = -1;
+    }
+
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        int g = events[i].group;
+        pc->fd[i] = -1;
+        pc->group[i] = g;
+        if (events[i].name == NULL || pc->group_size[g] == PC_GROUP_SIZE) {
+            continue;
+        }
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = pc->leader[g] < 0;  // Members follow their leader
+        attr.exclude_kernel = 1;            // Allowed at perf_event_paranoid <= 2
+        attr.exclude_hv = 1;
+
+        int fd = (int)perf_event_open(&attr, 0, -1, pc->leader[g], 0);
+        if (fd < 0) {
+            continue;
+        }
+        if (pc->leader[g] < 0) {
+            pc->leader[g] = fd;
+        }
+        pc->fd[i] = fd;
+        pc->slot[i] = pc->group_size[g]++;
+        pc->num_open++;
+    }
+    return pc->num_open;
+}
+
+void perf_counters_close(perf_counters_t *pc) {
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+        }
+    }
+    for (int g = 0; g < PC_NUM_GROUPS; g++) {
+        pc->leader[g] = -1;
+        pc->group_size[g] = 0;
+    }
+    pc->num_open = 0;
+}
+
+perf_counters_t *get_perf_counters(void) {
+    static perf_counters_t pc;
+    static int opened = 0;
+
+    if (!opened) {
+        opened = 1;
+        if (perf_counters_open(&pc) == 0) {
+            int paranoid = -1;
+            FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+            if (f) {
+                if (fscanf(f, "%d", &paranoid) != 1) {
+                    paranoid = -1;
+                }
+                fclose(f);
+            }
+            fprintf(stderr, "Hardware counters unavailable (perf_event_paranoid = %d); counter columns are left empty\n",
+                    paranoid);
+        }
+    }
+    return &pc;
+}
+
+void perf_counters_start(perf_counters_t *pc) {
+    for (int g = 0; g < PC_NUM_GROUPS; g++) {
+        if (pc->leader[g] >= 0) {
+            ioctl(pc->leader[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        }
+    }
+    for (int g = 0; g < PC_NUM_GROUPS; g++) {
+        if (pc->leader[g] >= 0) {
+            ioctl(pc->leader[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+void perf_counters_stop(perf_counters_t *pc, perf_sample_t *sample) {
+    // nr, time enabled, time running, then one value per event in the group
+    uint64_t buf[PC_NUM_GROUPS][3 + PC_GROUP_SIZE];
+    int ok[PC_NUM_GROUPS];
+
+    for (int g = 0; g < PC_NUM_GROUPS; g++) {
+        if (pc->leader[g] >= 0) {
+            ioctl(pc->leader[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+    for (int g = 0; g < PC_NUM_GROUPS; g++) {
+        ok[g] = pc->leader[g] >= 0 &&
+                read(pc->leader[g], buf[g], sizeof(buf[g])) >= (ssize_t)(3 * sizeof(uint64_t)) &&
+                buf[g][2] > 0;
+    }
+
+    memset(sample, 0, sizeof(*sample));
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        int g = pc->group[i];
+        if (pc->fd[i] < 0 || !ok[g] || (uint64_t)pc->slot[i] >= buf[g][0]) {
+            continue;
+        }
+        double scale = (double)buf[g][1] / (double)buf[g][2];
+        sample->value[i] = (uint64_t)((double)buf[g][3 + pc->slot[i]] * scale + 0.5);
+        sample->valid[i] = 1;
+    }
+}
+
+const char *perf_counter_name(perf_counter_id_t id) {
+    return id < PC_NUM_COUNTERS ? counter_names[id] : "?";
+}
+
+void perf_write_csv_header(FILE *out, const char *sep) {
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        fprintf(out, "%s%s", sep, counter_names[i]);
+    }
+}
+
+void perf_write_csv_values(FILE *out, const char *sep, const perf_sample_t *sample) {
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        if (sample->valid[i]) {
+            fprintf(out, "%s%llu", sep, (unsigned long long)sample->value[i]);
+        } else {
+            fprintf(out, "%s", sep);
+        }
+    }
+}
+
+void perf_print_per_op(FILE *out, const perf_sample_t *sample, double ops, const char *unit) {
+    int printed = 0;
+
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        if (!sample->valid[i]) {
+            continue;
+        }
+        if (!printed) {
+            fprintf(out, "    Counters per %s:", unit);
+        }
+        fprintf(out, "%s %s %.3f", printed ? "," : "", counter_names[i], (double)sample->value[i] / ops);
+        printed = 1;
+    }
+    if (printed) {
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define PC_GROUP_SIZE 4    // Events per group, small enough to schedule on any x86 PMU
+#define PC_NUM_GROUPS 2
+
+// Hardware events counted around each timed region
+typedef enum {
+    PC_CYCLES,              // Core cycles (group leader)
+    PC_INSTRUCTIONS,        // Retired instructions
+    PC_L1D_MISSES,          // L1D read misses
+    PC_L2_MISSES,           // Demand data misses in L2 (raw event, Intel Skylake+ / AMD Zen)
+    PC_LLC_MISSES,          // Last-level cache misses
+    PC_DTLB_LOAD_MISSES,    // First-level dTLB load misses
+    PC_DTLB_STORE_MISSES,   // First-level dTLB store misses
+    PC_PAGE_WALKS,          // Loads that missed the STLB and walked the page tables (raw event)
+    PC_NUM_COUNTERS
+} perf_counter_id_t;
+
+// Counts from one timed region. Events that could not be opened, or whose group was
+// never scheduled, are marked invalid. Multiplexed groups are scaled by enabled/running.
+typedef struct {
+    uint64_t value[PC_NUM_COUNTERS];
+    int valid[PC_NUM_COUNTERS];
+} perf_sample_t;
+
+// Events attached to the thread that opened them, split into PC_NUM_GROUPS groups that
+// are each enabled, disabled and read as one unit
+typedef struct {
+    int fd[PC_NUM_COUNTERS];       // -1 if the event could not be opened
+    int group[PC_NUM_COUNTERS];    // Group the event belongs to
+    int slot[PC_NUM_COUNTERS];     // Position of the event in its group's read buffer
+    int leader[PC_NUM_GROUPS];     // Leader fd of each group, -1 if the group is empty
+    int group_size[PC_NUM_GROUPS];
+    int num_open;
+} perf_counters_t;
+
+// Open every event for the calling thread, counting user space only. Returns the number
+// of events opened; 0 means counters are restricted or absent and start/stop are no-ops.
+int perf_counters_open(perf_counters_t *pc);
+
+void perf_counters_close(perf_counters_t *pc);
+
+// Counters for the thread that first calls this, opened on that call. Prints a one-line
+// note to stderr if none could be opened.
+perf_counters_t *get_perf_counters(void);
+
+// Reset and enable the counters immediately before a timed region
+void perf_counters_start(perf_counters_t *pc);
+
+// Disable the counters immediately after a timed region and read them
+void perf_counters_stop(perf_counters_t *pc, perf_sample_t *sample);
+
+const char *perf_counter_name(perf_counter_id_t id);
+
+// Append "<sep><name>" for every counter to a CSV header line
+void perf_write_csv_header(FILE *out, const char *sep);
+
+// Append "<sep><value>" for every counter to a CSV row, leaving unavailable counters empty
+void perf_write_csv_values(FILE *out, const char *sep, const perf_sample_t *sample);
+
+// Print the valid counters divided by 'ops' (e.g. misses per load) on one line
+void perf_print_per_op(FILE *out, const perf_sample_t *sample, double ops, const char *unit);
+
+#endif
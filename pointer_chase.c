@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pointer_chase.h"
+#include "bench.h"
+#include "tsc.h"
+#include "measure.h"
+
+#define UNROLL_STR(x) #x
+#define UNROLL(u) _Pragma(UNROLL_STR(GCC unroll u))
+
+// Link one node per stride in shuffled order. With 'line_size' non-zero each node sits at a
+// random line-aligned offset inside its stride instead of at the start.
+static void **build_chain(void *buffer, size_t num_nodes, size_t stride, size_t line_size) {
+    size_t *order = (size_t *) malloc(num_nodes * sizeof(size_t));
+    size_t *offset = line_size ? (size_t *) malloc(num_nodes * sizeof(size_t)) : NULL;
+    char *base = (char *) buffer;
+
+    if (!order || (line_size && !offset)) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Shuffle the visiting order of the nodes (Fisher-Yates)
+    for (size_t i = 0; i < num_nodes; i++) {
+        order[i] = i;
+    }
+    for (size_t i = num_nodes - 1; i > 0; i--) {
+        size_t j = bench_random_index(i + 1);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    for (size_t i = 0; i < num_nodes; i++) {
+        if (offset) {
+            offset[i] = bench_random_index(stride / line_size) * line_size;
+        }
+    }
+
+    // Link each node to the next one in the shuffled order, closing the cycle
+    for (size_t i = 0; i < num_nodes; i++) {
+        size_t cur = order[i], next = order[(i + 1) % num_nodes];
+        void **node = (void **) (base + cur * stride + (offset ? offset[cur] : 0));
+        *node = base + next * stride + (offset ? offset[next] : 0);
+    }
+
+    void **head = (void **) (base + order[0] * stride + (offset ? offset[order[0]] : 0));
+    free(order);
+    free(offset);
+    return head;
+}
+
+void **build_pointer_chain(void *buffer, size_t size, size_t stride) {
+    return build_chain(buffer, size / stride, stride, 0);
+}
+
+void **build_page_chain(void *buffer, size_t num_pages, size_t page_size, size_t line_size) {
+    return build_chain(buffer, num_pages, page_size, line_size);
+}
+
+void **chase_pointers(void **p, long hops) {
+    for (long i = 0; i < hops; i++) {
+        p = (void **) *p;  // Next address comes from the previous load
+    }
+    return p;
+}
+
+void ***chain_nodes(void **head, size_t num_nodes) {
+    void ***nodes = (void ***) malloc(num_nodes * sizeof(void **));
+    void **p = head;
+
+    if (!nodes) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < num_nodes; i++) {
+        nodes[i] = p;
+        p = (void **) *p;
+    }
+    return nodes;
+}
+
+// One chase per chain count, with the count fixed at compile time so the cursors are kept
+// in registers (past about a dozen chains some of them spill to the stack, which only adds
+// L1 hits that do not depend on the chased loads)
+#define MULTI_CHASE(N)                                                      \
+    static void chase_multi_##N(void ***heads, long hops) {                 \
+        void **p[N];                                                        \
+        UNROLL(N)                                                           \
+        for (int j = 0; j < N; j++) {                                       \
+            p[j] = heads[j];                                                \
+        }                                                                   \
+        for (long i = 0; i < hops; i++) {                                   \
+            UNROLL(N)                                                       \
+            for (int j = 0; j < N; j++) {                                   \
+                p[j] = (void **) *p[j];                                     \
+            }                                                               \
+        }                                                                   \
+        UNROLL(N)                                                           \
+        for (int j = 0; j < N; j++) {                                       \
+            heads[j] = p[j];                                                \
+        }                                                                   \
+    }
+
+#define MULTI_CHASES(F) F(1) F(2) F(3) F(4) F(5) F(6) F(7) F(8) F(9) F(10) F(11) F(12) F(13) F(14) F(15) \
+    F(16) F(17) F(18) F(19) F(20) F(21) F(22) F(23) F(24) F(25) F(26) F(27) F(28) F(29) F(30) F(31) F(32)
+#define MULTI_ENTRY(N) chase_multi_##N,
+
+MULTI_CHASES(MULTI_CHASE)
+
+static void (*const multi_chases[CHASE_MAX_CHAINS])(void ***, long) = {MULTI_CHASES(MULTI_ENTRY)};
+
+void chase_pointers_multi(void ***heads, int chains, long hops) {
+    multi_chases[chains - 1](heads, hops);
+}
+
+void **chase_pointers_sampled(void **p, long hops, int sample_every, hist_t *hist) {
+    uint64_t overhead = measure_tsc_overhead_cycles();
+    int countdown = 0;
+
+    for (long i = 0; i < hops; i++) {
+        if (countdown-- > 0) {
+            p = (void **) *p;
+            continue;
+        }
+        countdown = sample_every - 1;
+
+        uint64_t start = rdtsc_start();
+        p = (void **) *p;
+        uint64_t end = rdtscp_stop();
+        uint64_t cycles = end - start;
+        hist_record(hist, cycles > overhead ? cycles - overhead : 0);
+    }
+    return p;
+}
@@ -0,0 +1,35 @@
+#ifndef POINTER_CHASE_H
+#define POINTER_CHASE_H
+
+#include <stddef.h>
+
+#include "histogram.h"
+
+#define CHASE_MAX_CHAINS 32  // Most chains chase_pointers_multi() interleaves
+
+// Build a randomized cyclic pointer chain over the buffer with one node every 'stride'
+// bytes (normally one cache line). Each node's first word holds the address of the next
+// node, so every load depends on the previous one. Returns the head of the chain.
+void **build_pointer_chain(void *buffer, size_t size, size_t stride);
+
+// Build a chain that visits each of 'num_pages' pages exactly once, in shuffled order, at a
+// random line-aligned offset inside the page so the nodes do not all land in the same cache sets
+void **build_page_chain(void *buffer, size_t num_pages, size_t page_size, size_t line_size);
+
+// Follow the chain for 'hops' dependent loads and return where it ended up
+void **chase_pointers(void **p, long hops);
+
+// List the 'num_nodes' nodes of a chain in visiting order, starting at 'head' (caller frees).
+// Cursors taken at evenly spaced positions stay evenly spaced when chased at the same pace.
+void ***chain_nodes(void **head, size_t num_nodes);
+
+// Follow 'chains' independent chains for 'hops' loads each, one load of every chain per
+// iteration, so the loads of different chains can be in flight together. Continues from and
+// updates heads[].
+void chase_pointers_multi(void ***heads, int chains, long hops);
+
+// Follow the chain for 'hops' loads, timing every 'sample_every'-th load on its own with
+// serialized rdtsc/rdtscp and recording its cycles, less the timer overhead, into 'hist'
+void **chase_pointers_sampled(void **p, long hops, int sample_every, hist_t *hist);
+
+#endif
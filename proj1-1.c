@@ -1,75 +1,711 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 
-#define L1D_SIZE (48 * 1024)            // 48KB for L1d cache (per core)
-#define L2_SIZE  (1.25 * 1024 * 1024)   // 1.25MB for L2 cache (per core)
-#define L3_SIZE  (24 * 1024 * 1024)     // 24MB for L3 cache (shared)
-#define MEM_SIZE (64 * 1024 * 1024)     // 64MB for main memory (force access)
-#define CACHE_LINE_SIZE (64)            // 64B cache line size
+#include "bench.h"
+#include "topology.h"
+#include "pointer_chase.h"
+#include "perf_counters.h"
+#include "measure.h"
+#include "histogram.h"
+#include "tsc.h"
+#include "access_pattern.h"
+#include "mix_schedule.h"
+#include "page_alloc.h"
+
+#define MEM_SIZE (64 * 1024 * 1024)     // At least 64MB for main memory (force access)
 #define REPEAT 100000                   // Number of iterations for latency measurement
+#define ACCESS_TRIALS 50                // Default cap on repeated passes per independent-access measurement
+#define CHASE_HOPS 1000000              // Number of dependent loads per pointer-chase trial
+#define CHASE_TRIALS 50                 // Default cap on repeated trials per pointer-chase measurement
+#define HIST_HOPS 1000000               // Dependent loads per level in the histogram mode
+#define HIST_SAMPLE_EVERY 1             // Default: time every load in the histogram mode
+#define SWEEP_MIN_SIZE (1024)           // Smallest working set in the sweep (1KB)
+#define SWEEP_MAX_MB 2048               // Default largest working set in the sweep (2GB)
+#define SWEEP_POINTS_PER_OCTAVE 8       // Default number of working sets per doubling
+#define SWEEP_HOPS 500000               // Dependent loads timed per trial at each sweep point
+#define SWEEP_TRIALS 20                 // Default cap on repeated trials per sweep point
+#define PLATEAU_TOLERANCE 0.10          // Max latency growth across a point for it to sit on a plateau
+#define MAX_LEVELS 8                    // Maximum number of detected latency plateaus
+#define PATTERN_ACCESSES 1000000        // Dependent loads timed per trial in the patterns mode
+#define PATTERN_TRIALS 20               // Default cap on repeated trials per pattern and level
+#define NUM_PATTERN_LEVELS 4            // L1d, L2, L3 and main memory
+#define MLP_LOADS 200000                // Loads per trial in the MLP mode, split across the chains
+#define MLP_TRIALS 10                   // Default cap on repeated trials per chain count
+#define MLP_SATURATION 0.90             // Share of the peak load rate at which the chains saturate
+
+// One latency plateau found by the sweep
+typedef struct
+{
+    char name[16];          // "L1", "L2", ... or "Memory"
+    size_t first_size;      // Smallest working set on the plateau
+    size_t capacity;        // Effective capacity: where latency is halfway (in log) to the next plateau
+    double latency_ns;      // Median latency on the plateau
+    double cycles;          // Median core cycles (TSC cycles if unavailable) on the plateau
+} level_t;
 
-// Generate random access indices
+// Generate random access indices from the seeded bench stream
 void generate_random_indices(int *indices, int num_indices, size_t size)
 {
     for (int i = 0; i < num_indices; i++)
     {
         // Generate random index within array bounds
-        indices[i] = rand() % (size / sizeof(int));
+        indices[i] = (int)bench_random_index(size / sizeof(int));
     }
 }
 
-// // Function to measure the overhead of time measurement
-// long long measure_overhead()
-// {
-//     // Measure overhead
-//     struct timespec start, end;
-//     clock_gettime(CLOCK_MONOTONIC, &start);
-//     for (int i = 0; i < REPEAT; i++) {
-//         // Empty loop
-//     }
-//     clock_gettime(CLOCK_MONOTONIC, &end);
-//     return (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
-// }
-
-// Function to measure the average latency of reads or writes
-void measure_latency(int *array, size_t size, const char *label, int is_write)
-{    
-    // long long overhead_ns = measure_overhead();
+// State of one repeated independent-access measurement
+typedef struct
+{
+    int *array;
+    const int *indices;         // REPEAT random indices into the array
+    const mix_schedule_t *mix;  // Operation on each index, precomputed as runs
+    perf_sample_t counters;     // Counters over the last trial
+    volatile unsigned int sink; // Keeps the reads live
+} access_trial_t;
 
+// Function to time one pass over the random indices, returning ns per access with the
+// timer and loop overhead removed. The operations come from the precomputed schedule, one
+// branch per run of identical operations, so no random numbers are drawn while timing.
+static double access_trial(void *arg)
+{
+    access_trial_t *t = arg;
+    perf_counters_t *pc = get_perf_counters();
     struct timespec start, end;
-    long long total_ns = 0;
-    volatile int value;
-    int random_indices[REPEAT];
+    unsigned int sum = 0;
+    int j = 0;
+
+    perf_counters_start(pc);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t r = 0; r < t->mix->num_runs; r++)
+    {
+        int run_end = j + (int)t->mix->runs[r].length;
+        switch (t->mix->runs[r].op)
+        {
+        case MIX_READ:
+            for (; j < run_end; j++)
+                sum += t->array[t->indices[j]]; // Random read memory access
+            break;
+        case MIX_WRITE:
+            for (; j < run_end; j++)
+                t->array[t->indices[j]] = j; // Random write memory access
+            break;
+        default:
+            for (; j < run_end; j++)
+                t->array[t->indices[j]] += 1; // Random read-modify-write memory access
+            break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, &t->counters);
+    t->sink = sum;
+
+    double ns = measure_elapsed_ns(&start, &end) - REPEAT * measure_loop_overhead_ns();
+    return (ns > 0 ? ns : 0) / (double)REPEAT;
+}
+
+// Function to measure the average latency of an operation mix ("Read", "Write" or "Mixed")
+void measure_latency(int *array, size_t size, const char *label, const char *what, const mix_spec_t *spec)
+{
+    static int random_indices[REPEAT];
+    mix_schedule_t mix;
+    access_trial_t trial = {array, random_indices, &mix};
+    measure_config_t cfg;
+    measure_stats_t stats;
 
-    // Generate random indices for access
+    // Generate random indices and the operation on each before timing
     generate_random_indices(random_indices, REPEAT, size);
+    mix_build(spec, REPEAT, &mix);
+
+    measure_config_default(&cfg, ACCESS_TRIALS);
+    measure_run(&cfg, access_trial, &trial, &stats);
+    mix_free(&mix);
+
+    printf("Avg %s Latency for %s: ", what, label);
+    measure_print(stdout, &stats, "ns");
+    printf("\n");
+    perf_print_per_op(stdout, &trial.counters, REPEAT, "access");
+}
+
+// State of one repeated pointer-chase measurement
+typedef struct
+{
+    void **p;                   // Current position in the chain
+    long hops;                  // Dependent loads per trial
+    double ns;                  // Elapsed ns summed over the trials
+    tsc_sample_t tsc;           // TSC ticks and core cycles summed over the trials
+    perf_sample_t counters;     // Counters over the last trial
+} chase_trial_t;
 
-    // Measure read/write latency
+// Function to time one pass of 'hops' dependent loads, returning ns per hop
+static double chase_trial(void *arg)
+{
+    chase_trial_t *t = arg;
+    perf_counters_t *pc = get_perf_counters();
+    struct timespec start, end;
+    tsc_region_t region;
+    tsc_sample_t tsc;
+    void **p = t->p;
+
+    perf_counters_start(pc);
     clock_gettime(CLOCK_MONOTONIC, &start);
-    for (int j = 0; j < REPEAT; j++)
+    tsc_region_start(&region);
+    for (long j = 0; j < t->hops; j++)
+        p = (void **) *p; // Next address comes from the previous load
+    tsc_region_stop(&region, &tsc);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, &t->counters);
+
+    // Continue from here next trial; storing p also keeps the chase from being optimized away
+    t->p = p;
+    double ns = measure_elapsed_ns(&start, &end);
+    t->ns += ns;
+    tsc_accumulate(&t->tsc, &tsc);
+    return ns / (double)t->hops;
+}
+
+// Function to time a dependent pointer chase over the buffer until its latency converges,
+// returning the median ns per hop. TSC and core cycles per hop are scaled to the median from
+// their ratio to ns over all trials; the counters are those of the last trial.
+double chase_ns_per_hop(void *buffer, size_t size, long hops, int max_trials, measure_stats_t *stats,
+                        tsc_cycles_t *cycles_per_hop, perf_sample_t *counters)
+{
+    chase_trial_t trial = {build_pointer_chain(buffer, size, get_topology()->line_size), hops};
+    double tsc_ns;
+    measure_config_t cfg;
+
+    // The warmup trials also leave the working set resident at the level under test
+    measure_config_default(&cfg, max_trials);
+    measure_run(&cfg, chase_trial, &trial, stats);
+
+    // Scale by the TSC's own view of the elapsed time so both clocks agree on the median
+    tsc_ns = trial.ns > 0 ? stats->median * trial.tsc.ns / trial.ns : 0;
+    tsc_cycles_at_ns(&trial.tsc, tsc_ns, cycles_per_hop);
+    *counters = trial.counters;
+    return stats->median;
+}
+
+// Function to measure the true load-to-use latency by chasing a dependent pointer chain
+void measure_chase_latency(void *buffer, size_t size, long hops, const char *label)
+{
+    tsc_cycles_t cycles_per_hop;
+    perf_sample_t counters;
+    measure_stats_t stats;
+
+    chase_ns_per_hop(buffer, size, hops, CHASE_TRIALS, &stats, &cycles_per_hop, &counters);
+
+    printf("Dependent Load Latency for %s: ", label);
+    measure_print(stdout, &stats, "ns");
+    printf(", ");
+    tsc_print_cycles(stdout, &cycles_per_hop);
+    printf(" per hop\n");
+    perf_print_per_op(stdout, &counters, hops, "hop");
+}
+
+// Function to time individual dependent loads over the buffer and save their distribution
+void measure_latency_histogram(void *buffer, size_t size, long hops, int sample_every, const char *label,
+                               FILE *percentile_csv, FILE *histogram_csv)
+{
+    static hist_t hist;
+    size_t line_size = get_topology()->line_size;
+    void **p = build_pointer_chain(buffer, size, line_size);
+    char prefix[64];
+
+    // Walk the chain once so the working set is resident at the level under test
+    p = chase_pointers(p, size / line_size < (size_t)hops ? (long)(size / line_size) : hops);
+
+    hist_reset(&hist);
+    p = chase_pointers_sampled(p, hops, sample_every, &hist);
+
+    // Keep the chain result live so the loop is not optimized away
+    void * volatile sink = p;
+    (void) sink;
+
+    printf("Load Latency Distribution for %s (cycles): ", label);
+    hist_print(stdout, &hist);
+    printf("\n");
+
+    snprintf(prefix, sizeof(prefix), "%s, 1", label);
+    fprintf(percentile_csv, "%s", prefix);
+    hist_write_percentiles(percentile_csv, ", ", &hist);
+    fprintf(percentile_csv, "\n");
+    hist_write_buckets(histogram_csv, ", ", prefix, &hist);
+}
+
+// Compare doubles for qsort
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Median of a small range of values
+static double median(const double *values, int n)
+{
+    double sorted[n];
+    memcpy(sorted, values, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_double);
+    return n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+// Find latency plateaus in a log-spaced sweep and the knee between each pair of them.
+// The curve is first smoothed with a 3-point median to drop single noisy points; a
+// plateau is then a run of at least one octave whose latency stays within
+// PLATEAU_TOLERANCE of the run's first point. The effective capacity of a level is
+// where the curve crosses the geometric mean of its plateau latency and the next one.
+int detect_levels(const size_t *sizes, const double *latency, const double *cycles, int n,
+                  int points_per_octave, level_t *levels)
+{
+    int num_levels = 0;
+    int min_points = points_per_octave > 2 ? points_per_octave : 2;
+    double smoothed[n];
+
+    for (int i = 0; i < n; i++)
+    {
+        int lo = i > 0 ? i - 1 : i;
+        int hi = i < n - 1 ? i + 1 : i;
+        smoothed[i] = median(&latency[lo], hi - lo + 1);
+    }
+
+    int start = 0;
+    while (start < n)
+    {
+        int end = start + 1;
+        while (end < n && smoothed[end] <= smoothed[start] * (1.0 + PLATEAU_TOLERANCE))
+            end++;
+
+        int count = end - start;
+        if (count < min_points)
+        {
+            // Still on a transition; try the next point as a plateau start
+            start++;
+            continue;
+        }
+
+        double lat = median(&latency[start], count);
+        double cyc = median(&cycles[start], count);
+        level_t *prev = num_levels > 0 ? &levels[num_levels - 1] : NULL;
+
+        // Plateaus at the same latency are one level interrupted by noise
+        if ((!prev || lat > prev->latency_ns * (1.0 + PLATEAU_TOLERANCE)) && num_levels < MAX_LEVELS)
+        {
+            level_t *l = &levels[num_levels++];
+            l->first_size = sizes[start];
+            l->capacity = sizes[n - 1];
+            l->latency_ns = lat;
+            l->cycles = cyc;
+        }
+        start = end;
+    }
+
+    // Place each knee where latency crosses halfway (in log) to the next plateau
+    for (int k = 0; k + 1 < num_levels; k++)
+    {
+        double threshold = sqrt(levels[k].latency_ns * levels[k + 1].latency_ns);
+        for (int i = 0; i < n; i++)
+        {
+            if (sizes[i] < levels[k].first_size)
+                continue;
+            if (latency[i] > threshold)
+                break;
+            levels[k].capacity = sizes[i];
+        }
+    }
+
+    // Name the levels, calling the last one memory if it lies beyond every cache
+    const topology_t *topo = get_topology();
+    size_t largest_cache = 0;
+    for (int c = 0; c < topo->num_caches; c++)
+        if (topo->caches[c].size > largest_cache)
+            largest_cache = topo->caches[c].size;
+    for (int k = 0; k < num_levels; k++)
+    {
+        if (k == num_levels - 1 && k > 0 && levels[k].first_size > largest_cache)
+            snprintf(levels[k].name, sizeof(levels[k].name), "Memory");
+        else
+            snprintf(levels[k].name, sizeof(levels[k].name), "L%d", k + 1);
+    }
+    return num_levels;
+}
+
+// Function to sweep dependent-load latency over log-spaced working sets and report each level
+void run_sweep(size_t max_size, int points_per_octave, long hops)
+{
+    const topology_t *topo = get_topology();
+    int max_points = (int)(log2((double)max_size / SWEEP_MIN_SIZE) * points_per_octave) + 2;
+    size_t sizes[max_points];
+    double latency[max_points], cycles[max_points];
+    tsc_cycles_t hop_cycles[max_points];
+    perf_sample_t counters[max_points];
+    measure_stats_t stats[max_points];
+    level_t levels[MAX_LEVELS];
+    int n = 0;
+
+    // Log-spaced sizes, rounded down to whole cache lines
+    for (int k = 0; k < max_points; k++)
+    {
+        size_t size = (size_t)(SWEEP_MIN_SIZE * pow(2.0, (double)k / points_per_octave));
+        size -= size % topo->line_size;
+        if (size > max_size)
+            break;
+        if (n > 0 && size == sizes[n - 1])
+            continue;
+        sizes[n++] = size;
+    }
+
+    void *buffer = malloc(max_size);
+    if (!buffer)
     {
-        if (is_write)
-            array[random_indices[j]] ^= j << 13; // Pseudo-random write memory access
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Working Set (bytes)  |  Latency (ns)  |  TSC Cycles  |  Core Cycles\n");
+    printf("--------------------------------------------------------------------\n");
+    for (int i = 0; i < n; i++)
+    {
+        latency[i] = chase_ns_per_hop(buffer, sizes[i], hops, SWEEP_TRIALS, &stats[i], &hop_cycles[i], &counters[i]);
+        // Levels are reported in core cycles when available, which do not change with the clock speed
+        cycles[i] = hop_cycles[i].core_valid ? hop_cycles[i].core : hop_cycles[i].tsc;
+        printf("%19zu  |  %12.3f  |  %10.1f  |  ", sizes[i], latency[i], hop_cycles[i].tsc);
+        if (hop_cycles[i].core_valid)
+            printf("%11.1f", hop_cycles[i].core);
         else
-            value = array[random_indices[j]]; // Random read memory access
+            printf("%11s", "-");
+        printf("%s\n", stats[i].unstable ? "  (unstable)" : "");
+    }
+    free(buffer);
+
+    int num_levels = detect_levels(sizes, latency, cycles, n, points_per_octave, levels);
+
+    printf("\nDetected levels:\n");
+    for (int k = 0; k < num_levels; k++)
+    {
+        printf("%-6s  capacity ~ %zu KB, latency %.3f ns (%.1f %s cycles)",
+               levels[k].name, levels[k].capacity / 1024, levels[k].latency_ns, levels[k].cycles,
+               n > 0 && hop_cycles[0].core_valid ? "core" : "TSC");
+        // Compare against what the hardware advertises for the same level
+        for (int c = 0; c < topo->num_caches; c++)
+            if (levels[k].name[0] == 'L' && topo->caches[c].level == k + 1 &&
+                strcmp(topo->caches[c].type, "Instruction") != 0)
+                printf(", advertised %zu KB", topo->caches[c].size / 1024);
+        printf("\n");
+    }
+
+    // Same layout as cache_miss_vs_latency.csv, with each point assigned to a detected level
+    FILE *csv_file = bench_csv_open("cache_latency_sweep.csv");
+    for (int k = 0; k < num_levels; k++)
+        fprintf(csv_file, "# Detected %s: capacity %zu bytes, latency %.3f ns, %.1f %s cycles\n",
+                levels[k].name, levels[k].capacity, levels[k].latency_ns, levels[k].cycles,
+                n > 0 && hop_cycles[0].core_valid ? "core" : "TSC");
+    fprintf(csv_file, "# Latency is the median over trials of %ld hops; counters are totals over the last trial\n", hops);
+    fprintf(csv_file, "Cache Level, Total Size (bytes), Latency (ns)");
+    tsc_write_csv_header(csv_file, ", ");
+    measure_write_csv_header(csv_file, ", ");
+    perf_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
+    for (int i = 0; i < n; i++)
+    {
+        int k = 0;
+        while (k < num_levels - 1 && sizes[i] > levels[k].capacity)
+            k++;
+        fprintf(csv_file, "%s, %zu, %.3f", num_levels > 0 ? levels[k].name : "?", sizes[i], latency[i]);
+        tsc_write_csv_values(csv_file, ", ", &hop_cycles[i]);
+        measure_write_csv_values(csv_file, ", ", &stats[i]);
+        perf_write_csv_values(csv_file, ", ", &counters[i]);
+        fprintf(csv_file, "\n");
+    }
+    bench_csv_close(csv_file);
+
+    printf("\nSweep data has been saved to 'cache_latency_sweep.csv'\n");
+}
+
+// Function to measure the dependent-load latency of each access pattern at every cache level.
+// Sequential and strided patterns let the prefetchers run ahead of the chain; the random
+// patterns show what is left without them, so the ratio to "random" is the prefetch benefit.
+void run_pattern_latency(const access_pattern_t *patterns, int num_patterns, const size_t *sizes,
+                         const char *const *levels, long accesses)
+{
+    static measure_stats_t stats[PATTERN_MAX][NUM_PATTERN_LEVELS];
+    static perf_sample_t counters[PATTERN_MAX][NUM_PATTERN_LEVELS];
+    size_t max_size = sizes[NUM_PATTERN_LEVELS - 1];
+    int random = -1;
+
+    // Zeroed, so each load's value can be folded into the next address
+    char *buffer = (char *) bench_alloc(max_size, 4096);
+    memset(buffer, 0, max_size);
+
+    for (int i = 0; i < num_patterns; i++)
+    {
+        if (patterns[i].kind == PATTERN_RANDOM && random < 0)
+            random = i;
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++)
+            pattern_measure(&patterns[i], buffer, sizes[l], accesses, 1, PATTERN_TRIALS, &stats[i][l],
+                            &counters[i][l]);
+    }
+    free(buffer);
+
+    printf("Dependent load latency (ns) by access pattern%s:\n", random >= 0 ? ", speedup over random in ()" : "");
+    printf("%-16s", "Pattern");
+    for (int l = 0; l < NUM_PATTERN_LEVELS; l++)
+        printf("  |  %-16s", levels[l]);
+    printf("\n");
+    for (int i = 0; i < num_patterns; i++)
+    {
+        printf("%-16s", patterns[i].name);
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++)
+        {
+            if (random >= 0)
+                printf("  |  %7.2f (%5.2fx)", stats[i][l].median, stats[random][l].median / stats[i][l].median);
+            else
+                printf("  |  %16.2f", stats[i][l].median);
+        }
+        printf("\n");
     }
+
+    FILE *csv_file = bench_csv_open("access_pattern_latency.csv");
+    fprintf(csv_file, "# Dependent loads, one per cache line, %ld per trial; counters are totals over the last trial\n",
+            accesses);
+    fprintf(csv_file, "Pattern, Cache Level, Working Set (bytes), Latency (ns), Speedup vs Random");
+    measure_write_csv_header(csv_file, ", ");
+    perf_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
+    for (int i = 0; i < num_patterns; i++)
+    {
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++)
+        {
+            fprintf(csv_file, "%s, %s, %zu, %.3f, ", patterns[i].name, levels[l], sizes[l], stats[i][l].median);
+            if (random >= 0)
+                fprintf(csv_file, "%.3f", stats[random][l].median / stats[i][l].median);
+            measure_write_csv_values(csv_file, ", ", &stats[i][l]);
+            perf_write_csv_values(csv_file, ", ", &counters[i][l]);
+            fprintf(csv_file, "\n");
+        }
+    }
+    bench_csv_close(csv_file);
+
+    printf("\nAccess pattern data has been saved to 'access_pattern_latency.csv'\n");
+}
+
+// State of one repeated interleaved chase of several chains
+typedef struct
+{
+    void ***heads;              // Current position of every chain
+    int chains;
+    long hops;                  // Loads per chain per trial
+} mlp_trial_t;
+
+// Function to time one pass of 'hops' loads on every chain, returning ns per load
+static double mlp_trial(void *arg)
+{
+    mlp_trial_t *t = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    chase_pointers_multi(t->heads, t->chains, t->hops);
     clock_gettime(CLOCK_MONOTONIC, &end);
+    return measure_elapsed_ns(&start, &end) / ((double)t->hops * t->chains);
+}
+
+// Function to chase 1..max_chains independent chains interleaved in one loop at each level
+// and page backing. One chain gives the load-to-use latency; more chains overlap their misses
+// until the load rate stops growing, where the core runs out of fill buffers / MSHRs.
+// Little's law turns the peak rate into the number of misses in flight.
+void run_mlp(int max_chains, size_t mem_size, long loads)
+{
+    const topology_t *topo = get_topology();
+    const char *levels[NUM_PATTERN_LEVELS] = {"L1d Cache", "L2 Cache", "L3 Cache", "Main Memory"};
+    size_t sizes[NUM_PATTERN_LEVELS] = {topo->l1d_size / 2, topo->l2_size / 2, topo->l3_size / 2, mem_size};
+    page_backing_t backings[] = {BACKING_4K, BACKING_HUGETLB_2M, BACKING_HUGETLB_1G};
+    int measured[BACKING_NUM] = {0};
+    size_t line_size = topo->line_size;
+    double rate[CHASE_MAX_CHAINS];
+    void **heads[CHASE_MAX_CHAINS];
+    measure_stats_t stats;
+    measure_config_t cfg;
+
+    measure_config_default(&cfg, MLP_TRIALS);
+    FILE *csv_file = bench_csv_open("mlp.csv");
+    fprintf(csv_file, "# Outstanding loads = loads per ns x one-chain latency (Little's law)\n");
+    fprintf(csv_file, "Page Backing, Cache Level, Working Set (bytes), Chains, Latency per Chain (ns), Loads per ns, "
+            "Bandwidth (GB/s), Outstanding Loads");
+    measure_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
+
+    printf("%-16s %-12s %16s %15s %17s %10s\n", "Page Backing", "Cache Level", "1-Chain Latency", "Peak Loads/ns",
+           "Saturates at", "In Flight");
+    printf("------------------------------------------------------------------------------------------------\n");
+    for (int b = 0; b < (int)(sizeof(backings) / sizeof(backings[0])); b++)
+    {
+        page_buffer_t buf;
+        if (page_alloc(&buf, mem_size, backings[b]) != 0)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        if (measured[buf.backing])
+        {
+            printf("%-16s unavailable, fell back to %s (already measured)\n", page_backing_name(buf.requested),
+                   page_backing_name(buf.backing));
+            page_free(&buf);
+            continue;
+        }
+        measured[buf.backing] = 1;
+        memset(buf.addr, 0, mem_size);
+
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++)
+        {
+            size_t num_nodes = sizes[l] / line_size;
+            void ***nodes = chain_nodes(build_pointer_chain(buf.addr, sizes[l], line_size), num_nodes);
+            double latency = 0, peak = 0;
+            int saturated = 0;
 
-    total_ns = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
-    // double avg_latency = (double)(total_ns - overhead_ns) / (double)REPEAT;
-    double avg_latency = (double)total_ns / (double)REPEAT;
+            for (int n = 1; n <= max_chains; n++)
+            {
+                // Evenly spaced cursors on one cycle: independent, and together they cover it
+                for (int j = 0; j < n; j++)
+                    heads[j] = nodes[j * num_nodes / n];
+                mlp_trial_t trial = {heads, n, loads / n > 0 ? loads / n : 1};
+                measure_run(&cfg, mlp_trial, &trial, &stats);
 
-    printf("Avg %s Latency for %s: %.3f ns\n", is_write ? "Write" : "Read", label, avg_latency);
+                rate[n - 1] = 1.0 / stats.median;
+                if (n == 1)
+                    latency = stats.median;
+                if (rate[n - 1] > peak)
+                    peak = rate[n - 1];
+                fprintf(csv_file, "%s, %s, %zu, %d, %.3f, %.4f, %.3f, %.2f", page_backing_name(buf.backing), levels[l],
+                        sizes[l], n, stats.median * n, rate[n - 1], rate[n - 1] * line_size, rate[n - 1] * latency);
+                measure_write_csv_values(csv_file, ", ", &stats);
+                fprintf(csv_file, "\n");
+            }
+            for (int n = max_chains; n >= 1; n--)
+            {
+                if (rate[n - 1] >= MLP_SATURATION * peak)
+                    saturated = n;
+            }
+
+            printf("%-16s %-12s %13.2f ns %15.3f %10d chains %10.1f\n", page_backing_name(buf.backing), levels[l],
+                   latency, peak, saturated, peak * latency);
+            free(nodes);
+        }
+        page_free(&buf);
+    }
+
+    bench_csv_close(csv_file);
+    printf("\nSaturation is the fewest chains reaching %.0f%% of the peak load rate; in flight = peak rate x 1-chain latency\n",
+           100 * MLP_SATURATION);
+    printf("MLP data has been saved to 'mlp.csv'\n");
 }
 
-int main()
+// Entry point of the latency benchmark (membench latency)
+int latency_main(int argc, char *argv[])
 {
+    // "chase" measures dependent-load latency, "independent" keeps the original
+    // random-index access loop, and "both" runs them back to back for comparison.
+    // "histogram" times individual dependent loads and saves their full distribution.
+    // "sweep [max MB] [points per octave]" runs the dependent chase over log-spaced sizes.
+    // "patterns [list]" walks each access pattern (access_pattern.h) with dependent loads.
+    // "mlp [max chains]" interleaves 1..max chains to find how many misses can be in flight.
+    // Parameters: mode, hops, hist_hops, sample_every, sweep_hops, max_size, points_per_octave, mem_size,
+    // patterns, pattern_accesses, mix, mix_burst, mix_order, chains, mlp_loads, seed, plus the repetition
+    // parameters of measure_config_default().
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "chase");
+    int run_chase = strcmp(mode, "chase") == 0 || strcmp(mode, "both") == 0;
+    int run_independent = strcmp(mode, "independent") == 0 || strcmp(mode, "both") == 0;
+    int run_histogram = strcmp(mode, "histogram") == 0;
+
+    if (strcmp(mode, "sweep") == 0)
+    {
+        size_t max_size = argc > 2 ? strtoull(argv[2], NULL, 10) * 1024 * 1024
+                                   : bench_param_size("max_size", (size_t)SWEEP_MAX_MB * 1024 * 1024);
+        int points_per_octave = argc > 3 ? atoi(argv[3]) : (int)bench_param_long("points_per_octave", SWEEP_POINTS_PER_OCTAVE);
+        long hops = bench_param_long("sweep_hops", SWEEP_HOPS);
+        if (max_size < SWEEP_MIN_SIZE || points_per_octave <= 0 || hops <= 0)
+        {
+            fprintf(stderr, "Usage: %s sweep [max MB] [points per octave]\n", argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, get_topology());
+        run_sweep(max_size, points_per_octave, hops);
+        return 0;
+    }
+
+    if (strcmp(mode, "patterns") == 0)
+    {
+        const topology_t *topo = get_topology();
+        access_pattern_t patterns[PATTERN_MAX];
+        const char *levels[NUM_PATTERN_LEVELS] = {"L1d Cache", "L2 Cache", "L3 Cache", "Main Memory"};
+        size_t sizes[NUM_PATTERN_LEVELS] = {topo->l1d_size, topo->l2_size, topo->l3_size,
+            bench_param_size("mem_size", topo->l3_size * 4 > MEM_SIZE ? topo->l3_size * 4 : MEM_SIZE)};
+        const char *list = argc > 2 ? argv[2] : bench_param_str("patterns", PATTERN_DEFAULT_LIST);
+        int num_patterns = pattern_parse_list(list, patterns, PATTERN_MAX);
+        long accesses = bench_param_long("pattern_accesses", PATTERN_ACCESSES);
+        if (num_patterns <= 0 || accesses <= 0 || sizes[NUM_PATTERN_LEVELS - 1] < sizes[NUM_PATTERN_LEVELS - 2])
+        {
+            fprintf(stderr, "Usage: %s patterns [seq,seq-back,stride:N,page-random,2m-random,block-random:N,random,zipf:S]\n",
+                    argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_pattern_latency(patterns, num_patterns, sizes, levels, accesses);
+        return 0;
+    }
+
+    if (strcmp(mode, "mlp") == 0)
+    {
+        const topology_t *topo = get_topology();
+        int max_chains = argc > 2 ? atoi(argv[2]) : (int)bench_param_long("chains", CHASE_MAX_CHAINS);
+        size_t mem_size = bench_param_size("mem_size", topo->l3_size * 4 > MEM_SIZE ? topo->l3_size * 4 : MEM_SIZE);
+        long loads = bench_param_long("mlp_loads", MLP_LOADS);
+        if (max_chains < 1 || max_chains > CHASE_MAX_CHAINS || loads <= 0 || mem_size <= topo->l3_size)
+        {
+            fprintf(stderr, "Usage: %s mlp [max chains, 1..%d]\n", argv[0], CHASE_MAX_CHAINS);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_mlp(max_chains, mem_size, loads);
+        return 0;
+    }
+
+    if (!run_chase && !run_independent && !run_histogram)
+    {
+        fprintf(stderr, "Usage: %s [chase|independent|both|histogram|sweep|patterns|mlp]\n", argv[0]);
+        return 1;
+    }
+
+    // Size each working set from the detected cache topology
+    const topology_t *topo = get_topology();
+    size_t l1d_size = topo->l1d_size;
+    size_t l2_size = topo->l2_size;
+    size_t l3_size = topo->l3_size;
+    size_t mem_size = bench_param_size("mem_size", l3_size * 4 > MEM_SIZE ? l3_size * 4 : MEM_SIZE);
+    long hops = bench_param_long("hops", CHASE_HOPS);
+    long hist_hops = bench_param_long("hist_hops", HIST_HOPS);
+    int sample_every = (int)bench_param_long("sample_every", HIST_SAMPLE_EVERY);
+    if (hops <= 0 || hist_hops <= 0 || sample_every <= 0)
+    {
+        fprintf(stderr, "hops, hist_hops and sample_every must be positive\n");
+        return 1;
+    }
+    mix_spec_t mixed;
+    const char *mix = bench_param_str("mix", NULL);
+    int run_mixed = mix != NULL;
+    if (run_mixed && mix_spec_parse(mix, &mixed) != 0)
+    {
+        fprintf(stderr, "mix must be read:write:rmw ratios (e.g. 70:20:10), with mix_burst > 0 and mix_order random|interleaved\n");
+        return 1;
+    }
+
+    topology_write_header(stdout, topo);
+
     // Allocate memory for L1d, L2, L3 cache, and main memory
-    int *array_l1d = (int *) malloc(L1D_SIZE);    // L1d cache
-    int *array_l2 = (int *) malloc(L2_SIZE);      // L2 cache
-    int *array_l3 = (int *) malloc(L3_SIZE);      // L3 cache
-    int *array_mem = (int *) malloc(MEM_SIZE);    // Main memory
+    int *array_l1d = (int *) malloc(l1d_size);    // L1d cache
+    int *array_l2 = (int *) malloc(l2_size);      // L2 cache
+    int *array_l3 = (int *) malloc(l3_size);      // L3 cache
+    int *array_mem = (int *) malloc(mem_size);    // Main memory
 
     if (!array_l1d || !array_l2 || !array_l3 || !array_mem)
     {
@@ -78,31 +714,80 @@ int main()
     }
 
     // Initialize the arrays to avoid cold cache effects
-    for (size_t i = 0; i < L1D_SIZE / sizeof(int); i++)
-        array_l1d[i] = rand() % ((size_t)L1D_SIZE / sizeof(int));
-    for (size_t i = 0; i < L2_SIZE / sizeof(int); i++)
-        array_l2[i] = rand() % ((size_t)L2_SIZE / sizeof(int));
-    for (size_t i = 0; i < L3_SIZE / sizeof(int); i++)
-        array_l3[i] = rand() % ((size_t)L3_SIZE / sizeof(int));
-    for (size_t i = 0; i < MEM_SIZE / sizeof(int); i++)
-        array_mem[i] = rand() % ((size_t)MEM_SIZE / sizeof(int));
-
-    // Measure latencies for L1d cache
-    measure_latency(array_l1d, L1D_SIZE, "L1d Cache", 0); // Read latency for L1d
-    measure_latency(array_l1d, L1D_SIZE, "L1d Cache", 1); // Write latency for L1d
-    
-
-    // Measure latencies for L2 cache
-    measure_latency(array_l2, L2_SIZE, "L2 Cache", 0); // Read latency for L2
-    measure_latency(array_l2, L2_SIZE, "L2 Cache", 1); // Write latency for L2
-
-    // Measure latencies for L3 cache
-    measure_latency(array_l3, L3_SIZE, "L3 Cache", 0); // Read latency for L3
-    measure_latency(array_l3, L3_SIZE, "L3 Cache", 1); // Write latency for L3
-
-    // Measure latencies for Main Memory
-    measure_latency(array_mem, MEM_SIZE, "Main Memory", 0); // Read latency for Main Memory
-    measure_latency(array_mem, MEM_SIZE, "Main Memory", 1); // Write latency for Main Memory
+    for (size_t i = 0; i < l1d_size / sizeof(int); i++)
+        array_l1d[i] = (int)bench_random_index(l1d_size / sizeof(int));
+    for (size_t i = 0; i < l2_size / sizeof(int); i++)
+        array_l2[i] = (int)bench_random_index(l2_size / sizeof(int));
+    for (size_t i = 0; i < l3_size / sizeof(int); i++)
+        array_l3[i] = (int)bench_random_index(l3_size / sizeof(int));
+    for (size_t i = 0; i < mem_size / sizeof(int); i++)
+        array_mem[i] = (int)bench_random_index(mem_size / sizeof(int));
+
+    if (run_chase)
+    {
+        // Measure dependent-load latency for each level
+        measure_chase_latency(array_l1d, l1d_size, hops, "L1d Cache");
+        measure_chase_latency(array_l2, l2_size, hops, "L2 Cache");
+        measure_chase_latency(array_l3, l3_size, hops, "L3 Cache");
+        measure_chase_latency(array_mem, mem_size, hops, "Main Memory");
+    }
+
+    if (run_histogram)
+    {
+        // Percentile table and full distribution per level, in TSC cycles
+        FILE *percentile_csv = bench_csv_open("latency_percentiles.csv");
+        FILE *histogram_csv = bench_csv_open("latency_histogram.csv");
+        fprintf(percentile_csv, "# TSC cycles per sampled dependent load (1 in %d), timer overhead of %llu cycles removed\n",
+                sample_every, (unsigned long long)measure_tsc_overhead_cycles());
+        fprintf(percentile_csv, "Cache Level, Threads");
+        hist_write_percentiles_header(percentile_csv, ", ");
+        fprintf(percentile_csv, "\n");
+        fprintf(histogram_csv, "Cache Level, Threads, Bucket Low (cycles), Bucket High (cycles), Count\n");
+
+        measure_latency_histogram(array_l1d, l1d_size, hist_hops, sample_every, "L1d Cache", percentile_csv, histogram_csv);
+        measure_latency_histogram(array_l2, l2_size, hist_hops, sample_every, "L2 Cache", percentile_csv, histogram_csv);
+        measure_latency_histogram(array_l3, l3_size, hist_hops, sample_every, "L3 Cache", percentile_csv, histogram_csv);
+        measure_latency_histogram(array_mem, mem_size, hist_hops, sample_every, "Main Memory", percentile_csv, histogram_csv);
+
+        bench_csv_close(percentile_csv);
+        bench_csv_close(histogram_csv);
+        printf("\nLatency distributions have been saved to 'latency_percentiles.csv' and 'latency_histogram.csv'\n");
+    }
+
+    if (run_independent)
+    {
+        mix_spec_t read_only, write_only;
+        mix_spec_single(&read_only, MIX_READ);
+        mix_spec_single(&write_only, MIX_WRITE);
+
+        // Measure latencies for L1d cache
+        measure_latency(array_l1d, l1d_size, "L1d Cache", "Read", &read_only);   // Read latency for L1d
+        measure_latency(array_l1d, l1d_size, "L1d Cache", "Write", &write_only); // Write latency for L1d
+
+        // Measure latencies for L2 cache
+        measure_latency(array_l2, l2_size, "L2 Cache", "Read", &read_only);   // Read latency for L2
+        measure_latency(array_l2, l2_size, "L2 Cache", "Write", &write_only); // Write latency for L2
+
+        // Measure latencies for L3 cache
+        measure_latency(array_l3, l3_size, "L3 Cache", "Read", &read_only);   // Read latency for L3
+        measure_latency(array_l3, l3_size, "L3 Cache", "Write", &write_only); // Write latency for L3
+
+        // Measure latencies for Main Memory
+        measure_latency(array_mem, mem_size, "Main Memory", "Read", &read_only);   // Read latency for Main Memory
+        measure_latency(array_mem, mem_size, "Main Memory", "Write", &write_only); // Write latency for Main Memory
+
+        // An optional read/write/RMW mix on top, e.g. mix=70:20:10
+        if (run_mixed)
+        {
+            char description[128];
+            mix_spec_describe(&mixed, description, sizeof(description));
+            printf("Mixed: %s\n", description);
+            measure_latency(array_l1d, l1d_size, "L1d Cache", "Mixed", &mixed);
+            measure_latency(array_l2, l2_size, "L2 Cache", "Mixed", &mixed);
+            measure_latency(array_l3, l3_size, "L3 Cache", "Mixed", &mixed);
+            measure_latency(array_mem, mem_size, "Main Memory", "Mixed", &mixed);
+        }
+    }
 
     // Free memory
     free(array_l1d);
@@ -111,4 +796,12 @@ int main()
     free(array_mem);
 
     return 0;
-}
\ No newline at end of file
+}
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[])
+{
+    bench_init(&argc, argv, "latency");
+    return latency_main(argc, argv);
+}
+#endif
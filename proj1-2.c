@@ -1,22 +1,71 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 #include <time.h>
 
+#include "bench.h"
+#include "topology.h"
+#include "bandwidth_kernels.h"
+#include "affinity.h"
+#include "perf_counters.h"
+#include "measure.h"
+#include "access_pattern.h"
+#include "mix_schedule.h"
+
 #define MEM_SIZE (256 * 1024 * 1024)  // 256MB memory block, larger than typical cache
 #define REPEAT 1000000                // Number of iterations
+#define STREAM_TIMES 5                // Timed passes per workload in the parallel mode
+#define STREAM_TRIALS 20              // Default cap on timed passes per streaming kernel
+#define MAX_THREADS 256               // Upper bound on threads in the parallel mode
+#define MAX_WORKLOADS 16              // Upper bound on workloads in the parallel mode
+#define SATURATION_FRACTION 0.95      // Bandwidth within 5% of the peak counts as saturated
+#define PATTERN_ACCESSES 4000000      // Independent loads timed per trial in the patterns mode
+#define PATTERN_TRIALS 20             // Default cap on repeated trials per pattern and level
+#define NUM_PATTERN_LEVELS 4          // L1d, L2, L3 and main memory
+#define GRAN_CHUNKS "64,256,512,1K,2K,4K"  // Default chunk sizes of the granularity mode
+#define GRAN_MIN_SIZE (64 * 1024 * 1024)  // Smallest default buffer of the granularity mode
+#define GRAN_TRIALS 10                // Default cap on timed passes per granularity kernel
+#define MAX_CHUNK_SIZES 16            // Upper bound on chunk sizes in the granularity mode
+
+// One parallel workload: 'first' runs over the leading 'split' fraction of each slice and
+// 'second' (if any) over the rest, so a read kernel plus a write kernel gives a read/write ratio
+typedef struct {
+    char name[32];
+    const bw_kernel_t *first;
+    const bw_kernel_t *second;
+    double split;
+} bw_workload_t;
+
+// Per-thread state of the parallel mode
+typedef struct {
+    int cpu;                          // CPU this thread is pinned to
+    char *a, *b, *c;                  // This thread's slices of the three arrays
+    size_t bytes;                     // Slice length
+    const bw_workload_t *workloads;
+    int num_workloads;
+    pthread_barrier_t *barrier;       // Shared by all workers and the coordinating thread
+    int passes;                       // Timed passes per workload, after one untimed pass
+    struct timespec start, end;       // When this thread began and finished the last pass
+} bw_thread_t;
 
 // Function to flush the cache line
 void clflush(void *p) {
     asm volatile("clflush (%0)" :: "r"(p));
 }
 
-// Function to measure memory bandwidth for a given chunk size and read/write ratio
-double measure_bandwidth(size_t chunk_size, double read_ratio) {
+// Function to measure memory bandwidth for a given chunk size and read/write mix
+double measure_bandwidth(size_t chunk_size, const mix_spec_t *spec) {
     struct timespec start, end;
     char *mem_block;
+    mix_schedule_t mix;
     size_t i;
+    uint64_t sum = 0;
+    volatile uint64_t sink;
     long total_data = MEM_SIZE;        // Total memory to access
     long iterations = total_data / chunk_size;
+    size_t line_size = get_topology()->line_size;
 
     // Allocate a large block of memory
     mem_block = (char *) malloc(total_data);
@@ -30,27 +79,48 @@ double measure_bandwidth(size_t chunk_size, double read_ratio) {
         mem_block[i] = (char) i;
     }
 
+    // Decide the operation on every chunk before timing
+    mix_build(spec, iterations, &mix);
+
     // Start timing memory access
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    // Perform read/write operations according to the read_ratio
-    for (i = 0; i < iterations; i++) {
-        volatile char temp;
-        // Flush the cache line for every memory access to avoid cache hits
-        clflush(&mem_block[i * chunk_size]);
+    // Perform read/write operations on whole chunks, one run of identical operations at a time
+    i = 0;
+    for (size_t r = 0; r < mix.num_runs; r++) {
+        mix_op_t op = (mix_op_t) mix.runs[r].op;
+        size_t run_end = i + mix.runs[r].length;
+        for (; i < run_end; i++) {
+            uint64_t *chunk = (uint64_t *) &mem_block[i * chunk_size];
+            // Flush the chunk's cache lines for every memory access to avoid cache hits
+            for (size_t off = 0; off < chunk_size; off += line_size) {
+                clflush((char *)chunk + off);
+            }
 
-        if ((double)rand() / RAND_MAX < read_ratio) {
-            temp = mem_block[i * chunk_size];  // Perform read
-        } else {
-            mem_block[i * chunk_size] = (char)i;  // Perform write
+            if (op == MIX_READ) {
+                for (size_t j = 0; j < chunk_size / sizeof(uint64_t); j++) {
+                    sum += chunk[j];  // Perform read
+                }
+            } else if (op == MIX_WRITE) {
+                for (size_t j = 0; j < chunk_size / sizeof(uint64_t); j++) {
+                    chunk[j] = i;  // Perform write
+                }
+            } else {
+                for (size_t j = 0; j < chunk_size / sizeof(uint64_t); j++) {
+                    chunk[j] += 1;  // Perform read-modify-write
+                }
+            }
         }
     }
 
     // Stop timing
     clock_gettime(CLOCK_MONOTONIC, &end);
+    sink = sum;  // Keeps the reads live
+    (void) sink;
 
     // Free memory block
     free(mem_block);
+    mix_free(&mix);
 
     // Calculate elapsed time in seconds
     double time_taken = (end.tv_sec - start.tv_sec) + 
@@ -62,23 +132,326 @@ double measure_bandwidth(size_t chunk_size, double read_ratio) {
     return bandwidth;
 }
 
-int main() {
+// State of one repeated streaming-kernel measurement
+typedef struct {
+    const bw_kernel_t *kernel;
+    char *a;
+    const char *b, *c;
+    size_t bytes;
+    perf_sample_t counters;           // Summed over the timed passes
+    volatile double sink;
+} stream_trial_t;
+
+// Function to time one pass of a streaming kernel, returning its bandwidth in GB/s
+static double stream_trial(void *arg) {
+    stream_trial_t *t = arg;
+    perf_counters_t *pc = get_perf_counters();
+    perf_sample_t pass;
+    struct timespec start, end;
+
+    perf_counters_start(pc);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t->sink = t->kernel->fn(t->a, t->b, t->c, t->bytes);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, &pass);
+
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        t->counters.value[i] += pass.value[i];
+        t->counters.valid[i] &= pass.valid[i];
+    }
+    return (double)bw_bytes_moved(t->kernel->op, t->bytes) / measure_elapsed_ns(&start, &end);
+}
+
+// Function to time one streaming kernel over the arrays until its bandwidth converges. The
+// warmup passes keep page faults and cold TLBs out of the result; the counters are summed
+// over the timed passes.
+void measure_stream_bandwidth(const bw_kernel_t *kernel, char *a, const char *b, const char *c,
+                              size_t bytes, int max_trials, measure_stats_t *stats, perf_sample_t *counters) {
+    stream_trial_t trial = {kernel, a, b, c, bytes};
+    measure_config_t cfg;
+    int warmup;
+
+    for (int i = 0; i < PC_NUM_COUNTERS; i++) {
+        trial.counters.valid[i] = 1;
+    }
+
+    // Run the warmup passes here so their counters are not included
+    measure_config_default(&cfg, max_trials);
+    warmup = cfg.warmup;
+    for (int i = 0; i < warmup; i++) {
+        trial.sink = kernel->fn(a, b, c, bytes);
+    }
+    cfg.warmup = 0;
+    measure_run(&cfg, stream_trial, &trial, stats);
+    *counters = trial.counters;
+}
+
+// Function to run every read/write/copy/triad kernel the CPU supports over arrays sized
+// well past the last-level cache, STREAM style
+void run_stream_kernels(size_t bytes) {
+    bytes -= bytes % BW_BLOCK_BYTES;
+
+    // Three arrays (triad reads two and writes one), page aligned and touched before timing
+    char *a = (char *) bench_alloc(bytes, 4096);
+    char *b = (char *) bench_alloc(bytes, 4096);
+    char *c = (char *) bench_alloc(bytes, 4096);
+    for (size_t i = 0; i < bytes / sizeof(double); i++) {
+        ((double *)a)[i] = 1.0;
+        ((double *)b)[i] = 2.0;
+        ((double *)c)[i] = 0.5;
+    }
+
+    FILE *csv_file = bench_csv_open("stream_bandwidth_results.csv");
+    fprintf(csv_file, "# Summary columns are per-pass bandwidth in GB/s; counters are totals over the timed passes\n");
+    fprintf(csv_file, "Kernel,Operation,ISA,Non-Temporal,Array Size (bytes),Best Bandwidth (GB/s),Avg Bandwidth (GB/s)");
+    measure_write_csv_header(csv_file, ",");
+    perf_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    printf("Streaming bandwidth kernels, %zu MB per array:\n", bytes / (1024 * 1024));
+    printf("Kernel            |  Best (GB/s)  |  Avg (GB/s)  |  95%% CI  |  Passes\n");
+    printf("-------------------------------------------------------------------------\n");
+
+    int count;
+    const bw_kernel_t *kernels = bw_kernels(&count);
+    for (int i = 0; i < count; i++) {
+        const bw_kernel_t *k = &kernels[i];
+        if (!bw_isa_supported(k->isa)) {
+            printf("%-16s  |  not supported on this CPU\n", k->name);
+            continue;
+        }
+        measure_stats_t stats;
+        perf_sample_t counters;
+        measure_stream_bandwidth(k, a, b, c, bytes, STREAM_TRIALS, &stats, &counters);
+
+        printf("%-16s  |  %11.2f  |  %10.2f  |  %6.2f  |  %6d%s\n", k->name, stats.max, stats.mean,
+               stats.ci95, stats.trials, stats.unstable ? "  (unstable)" : "");
+        fprintf(csv_file, "%s,%s,%s,%s,%zu,%.2f,%.2f", k->name, bw_op_name(k->op), bw_isa_name(k->isa),
+                k->nontemporal ? "yes" : "no", bytes, stats.max, stats.mean);
+        measure_write_csv_values(csv_file, ",", &stats);
+        perf_write_csv_values(csv_file, ",", &counters);
+        fprintf(csv_file, "\n");
+    }
+
+    // Report which kernel runtime feature detection picks for each operation
+    printf("\nSelected kernels:");
+    for (int op = 0; op < BW_NUM_OPS; op++) {
+        printf(" %s", bw_best_kernel((bw_op_t)op, 0)->name);
+        if (op != BW_READ) {
+            printf(" %s", bw_best_kernel((bw_op_t)op, 1)->name);
+        }
+    }
+    printf("\n");
+
+    bench_csv_close(csv_file);
+    free(a);
+    free(b);
+    free(c);
+
+    printf("\nStreaming bandwidth data has been saved to 'stream_bandwidth_results.csv'\n");
+}
+
+// Thread function for the parallel mode: pin, first-touch the slice, then run every
+// workload pass between a start and an end barrier
+void *bandwidth_thread(void *arg) {
+    bw_thread_t *t = (bw_thread_t *)arg;
+    volatile double sink;
+
+    pin_thread(t->cpu);
+
+    // First touch from the pinned thread so the pages land on its local node
+    memset(t->a, 1, t->bytes);
+    memset(t->b, 2, t->bytes);
+    memset(t->c, 3, t->bytes);
+
+    for (int w = 0; w < t->num_workloads; w++) {
+        const bw_workload_t *wl = &t->workloads[w];
+        size_t first_bytes = (size_t)(t->bytes * wl->split);
+        first_bytes -= first_bytes % BW_BLOCK_BYTES;
+
+        // One untimed pass, then the timed ones
+        for (int pass = 0; pass <= t->passes; pass++) {
+            pthread_barrier_wait(t->barrier);
+            clock_gettime(CLOCK_MONOTONIC, &t->start);
+            if (first_bytes > 0) {
+                sink = wl->first->fn(t->a, t->b, t->c, first_bytes);
+            }
+            if (wl->second && first_bytes < t->bytes) {
+                sink = wl->second->fn(t->a + first_bytes, t->b + first_bytes, t->c + first_bytes,
+                                      t->bytes - first_bytes);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t->end);
+            pthread_barrier_wait(t->barrier);
+        }
+    }
+    (void)sink;
+    return NULL;
+}
+
+// Bytes one thread moves for a workload over its slice, counted as STREAM does
+static double workload_bytes(const bw_workload_t *wl, size_t bytes) {
+    size_t first_bytes = (size_t)(bytes * wl->split);
+    first_bytes -= first_bytes % BW_BLOCK_BYTES;
+    double moved = (double)bw_bytes_moved(wl->first->op, first_bytes);
+    if (wl->second) {
+        moved += (double)bw_bytes_moved(wl->second->op, bytes - first_bytes);
+    }
+    return moved;
+}
+
+// Function to measure aggregate bandwidth of every workload with 1..max_threads pinned threads
+// sharing 'total' bytes per array
+void run_parallel_scaling(int max_threads, size_t total, int passes) {
+    const char *placement = bench_param_str("placement", "allowed");
+    int cpus[MAX_THREADS];
+    int num_cpus = get_placement_cpus(placement, cpus, MAX_THREADS);
+    bw_workload_t workloads[MAX_WORKLOADS];
+    int num_workloads = 0;
+
+    if (num_cpus <= 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (max_threads <= 0 || max_threads > num_cpus) {
+        max_threads = num_cpus;
+    }
+
+    // Read/write mixes built from the best read and write kernels, then every kernel on its own
+    double ratios[] = {1.0, 0.75, 0.5, 0.25, 0.0};
+    for (int r = 0; r < (int)(sizeof(ratios) / sizeof(ratios[0])); r++) {
+        bw_workload_t *wl = &workloads[num_workloads++];
+        snprintf(wl->name, sizeof(wl->name), "%.0f%% read", ratios[r] * 100);
+        wl->first = bw_best_kernel(BW_READ, 0);
+        wl->second = bw_best_kernel(BW_WRITE, 0);
+        wl->split = ratios[r];
+    }
+    for (int op = BW_WRITE; op < BW_NUM_OPS; op++) {
+        for (int nt = 0; nt <= 1; nt++) {
+            bw_workload_t *wl = &workloads[num_workloads++];
+            wl->first = bw_best_kernel((bw_op_t)op, nt);
+            wl->second = NULL;
+            wl->split = 1.0;
+            snprintf(wl->name, sizeof(wl->name), "%s", wl->first->name);
+        }
+    }
+
+    double bandwidth[MAX_WORKLOADS][MAX_THREADS];
+
+    for (int n = 1; n <= max_threads; n++) {
+        pthread_t threads[MAX_THREADS];
+        bw_thread_t data[MAX_THREADS];
+        pthread_barrier_t barrier;
+
+        // Page-aligned disjoint slices; each thread first-touches its own
+        size_t slice = total / n;
+        slice -= slice % 4096;
+        char *a = (char *) bench_alloc(slice * n, 4096);
+        char *b = (char *) bench_alloc(slice * n, 4096);
+        char *c = (char *) bench_alloc(slice * n, 4096);
+
+        pthread_barrier_init(&barrier, NULL, n + 1);
+        for (int i = 0; i < n; i++) {
+            data[i].cpu = cpus[i];
+            data[i].a = a + i * slice;
+            data[i].b = b + i * slice;
+            data[i].c = c + i * slice;
+            data[i].bytes = slice;
+            data[i].workloads = workloads;
+            data[i].num_workloads = num_workloads;
+            data[i].barrier = &barrier;
+            data[i].passes = passes;
+            pthread_create(&threads[i], NULL, bandwidth_thread, &data[i]);
+        }
+
+        // Each pass spans the wall clock from the first thread starting to the last one
+        // finishing; the threads stamp their own times so this thread's scheduling is not included
+        for (int w = 0; w < num_workloads; w++) {
+            double best_time = 0;
+            for (int pass = 0; pass <= passes; pass++) {
+                pthread_barrier_wait(&barrier);
+                pthread_barrier_wait(&barrier);
+
+                double first_start = 0, last_end = 0;
+                for (int i = 0; i < n; i++) {
+                    double ts = data[i].start.tv_sec + data[i].start.tv_nsec / 1e9;
+                    double te = data[i].end.tv_sec + data[i].end.tv_nsec / 1e9;
+                    if (i == 0 || ts < first_start) first_start = ts;
+                    if (i == 0 || te > last_end) last_end = te;
+                }
+                double time_taken = last_end - first_start;
+                if (pass > 0 && (pass == 1 || time_taken < best_time)) {
+                    best_time = time_taken;
+                }
+            }
+            bandwidth[w][n - 1] = workload_bytes(&workloads[w], slice) * n / (best_time * 1e9);
+        }
+
+        for (int i = 0; i < n; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        pthread_barrier_destroy(&barrier);
+        free(a);
+        free(b);
+        free(c);
+    }
+
+    FILE *csv_file = bench_csv_open("parallel_bandwidth_results.csv");
+    placement_write_header(csv_file, placement, cpus, max_threads);
+
+    // Saturation point: fewest threads reaching SATURATION_FRACTION of the peak
+    printf("Workload              |  Peak (GB/s)  |  Saturates at\n");
+    printf("-----------------------------------------------------\n");
+    for (int w = 0; w < num_workloads; w++) {
+        double peak = 0;
+        int saturation = 1;
+        for (int n = 1; n <= max_threads; n++) {
+            if (bandwidth[w][n - 1] > peak) {
+                peak = bandwidth[w][n - 1];
+            }
+        }
+        for (int n = max_threads; n >= 1; n--) {
+            if (bandwidth[w][n - 1] >= SATURATION_FRACTION * peak) {
+                saturation = n;
+            }
+        }
+        printf("%-20s  |  %11.2f  |  %d threads\n", workloads[w].name, peak, saturation);
+        fprintf(csv_file, "# Saturation: %s reaches %.2f GB/s at %d threads\n", workloads[w].name, peak, saturation);
+    }
+
+    fprintf(csv_file, "Workload,Threads,Bandwidth (GB/s),Per-Thread Bandwidth (GB/s)\n");
+    for (int w = 0; w < num_workloads; w++) {
+        for (int n = 1; n <= max_threads; n++) {
+            fprintf(csv_file, "%s,%d,%.2f,%.2f\n", workloads[w].name, n, bandwidth[w][n - 1], bandwidth[w][n - 1] / n);
+        }
+    }
+    bench_csv_close(csv_file);
+
+    printf("\nParallel bandwidth data has been saved to 'parallel_bandwidth_results.csv'\n");
+}
+
+// Function to run the original chunk-size by read/write-ratio table
+int run_ratio_table(void) {
     // Array of data chunk sizes to test
-    size_t chunk_sizes[] = {64, 256, 512, 1024, 2048, 5096};
+    size_t chunk_sizes[] = {64, 256, 512, 1024, 2048, 4096};
     int num_chunks = sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
 
     // Array of read-to-write ratios (from 100% read to 100% write)
     double read_ratios[] = {1.0, 0.9, 0.8, 0.7, 0.6, 0.5, 0.4, 0.3, 0.2, 0.1, 0.0};
     int num_ratios = sizeof(read_ratios) / sizeof(read_ratios[0]);
 
-    // Open CSV file for writing
-    FILE *csv_file = fopen("memory_bandwidth_results.csv", "w");
-    if (!csv_file) {
-        perror("Error opening CSV file");
+    // The chunks that are not read are written, or read-modified-written with write_op=rmw
+    const char *write_op = bench_param_str("write_op", "write");
+    mix_op_t write_kind = strcmp(write_op, "rmw") == 0 ? MIX_RMW : MIX_WRITE;
+    mix_spec_t spec;
+    mix_spec_single(&spec, MIX_READ);
+    if (mix_spec_params(&spec) != 0 || (write_kind == MIX_WRITE && strcmp(write_op, "write") != 0)) {
+        fprintf(stderr, "write_op must be write or rmw, mix_burst positive and mix_order random or interleaved\n");
         return 1;
     }
 
-    // Write CSV headers
+    // Open CSV file for writing, starting with the host topology
+    FILE *csv_file = bench_csv_open("memory_bandwidth_results.csv");
+    fprintf(csv_file, "# Operations per chunk precomputed in bursts of %d, %s order; writes are %s\n", spec.burst,
+            spec.order == MIX_INTERLEAVED ? "interleaved" : "random", mix_op_name(write_kind));
     fprintf(csv_file, "Chunk Size (bytes),Read Ratio,Write Ratio,Bandwidth (GB/s)\n");
 
     printf("Evaluating memory bandwidth for different data access granularities and read/write ratios:\n");
@@ -93,7 +466,9 @@ int main() {
 
         for (int j = 0; j < num_ratios; j++) {
             double read_ratio = read_ratios[j];
-            double bandwidth = measure_bandwidth(chunk_size, read_ratio);
+            spec.ratio[MIX_READ] = read_ratio;
+            spec.ratio[write_kind] = 1.0 - read_ratio;
+            double bandwidth = measure_bandwidth(chunk_size, &spec);
 
             printf("%5.0f%% read, %5.0f%% write  |  %.2f GB/s\n", 
                    read_ratio * 100, (1.0 - read_ratio) * 100, bandwidth);
@@ -105,9 +480,264 @@ int main() {
     }
 
     // Close the CSV file
-    fclose(csv_file);
+    bench_csv_close(csv_file);
 
     printf("\nBandwidth data has been saved to 'memory_bandwidth_results.csv'\n");
 
     return 0;
 }
+
+// State of one repeated granularity-kernel measurement
+typedef struct {
+    const chunk_kernel_t *kernel;
+    char *buffer;
+    const pattern_schedule_t *sched;  // Chunk indices in visiting order
+    size_t chunk_size;
+    volatile uint64_t sink;
+} gran_trial_t;
+
+// Function to time one pass of a granularity kernel over every chunk, returning GB/s
+static double gran_trial(void *arg) {
+    gran_trial_t *t = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t->sink = t->kernel->fn(t->buffer, t->sched->lines, t->sched->count, t->chunk_size);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(t->sched->count * t->chunk_size) / measure_elapsed_ns(&start, &end);
+}
+
+// Look up the granularity kernel for a mode, access width and unroll factor
+static const chunk_kernel_t *find_chunk_kernel(chunk_mode_t mode, int width, int unroll) {
+    int count;
+    const chunk_kernel_t *k = chunk_kernels(&count);
+    for (int i = 0; i < count; i++) {
+        if (k[i].mode == mode && k[i].width == width && k[i].unroll == unroll) {
+            return &k[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to read, write and read-modify-write whole chunks of each size with every access
+// width and unroll factor, visiting the chunks of a 'size'-byte buffer in 'order'
+void run_granularity(size_t size, const size_t *chunk_sizes, int num_chunk_sizes, const access_pattern_t *order) {
+    static const int widths[] = {1, 4, 8, 16, 32, 64};
+    static const int unrolls[] = {1, 4};
+    int num_widths = sizeof(widths) / sizeof(widths[0]);
+    measure_config_t cfg;
+
+    char *buffer = (char *) bench_alloc(size, 4096);
+    memset(buffer, 0, size);
+    measure_config_default(&cfg, GRAN_TRIALS);
+
+    FILE *csv_file = bench_csv_open("granularity_bandwidth.csv");
+    fprintf(csv_file, "# Every byte of each chunk is accessed once; read-modify-write counts each byte once\n");
+    fprintf(csv_file, "Chunk Size (bytes),Order,Mode,Width (bytes),Unroll,Kernel,Bandwidth (GB/s)");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    for (int c = 0; c < num_chunk_sizes; c++) {
+        size_t chunk_size = chunk_sizes[c];
+        pattern_schedule_t sched;
+        pattern_build(order, size - size % chunk_size, chunk_size, &sched);
+
+        printf("\nChunk size: %zu bytes, %s order, %zu MB buffer (median GB/s)\n", chunk_size, order->name,
+               size / (1024 * 1024));
+        printf("Width  ");
+        for (int m = 0; m < CHUNK_NUM_MODES; m++) {
+            for (int u = 0; u < 2; u++) {
+                printf("|  %5s x%d  ", chunk_mode_name((chunk_mode_t)m), unrolls[u]);
+            }
+        }
+        printf("\n");
+
+        for (int w = 0; w < num_widths; w++) {
+            printf("%5d  ", widths[w]);
+            for (int m = 0; m < CHUNK_NUM_MODES; m++) {
+                for (int u = 0; u < 2; u++) {
+                    const chunk_kernel_t *k = find_chunk_kernel((chunk_mode_t)m, widths[w], unrolls[u]);
+                    if (!k || !bw_isa_supported(k->isa) || chunk_size % (size_t)(k->width * k->unroll) != 0) {
+                        printf("|  %8s  ", "-");
+                        continue;
+                    }
+                    gran_trial_t trial = {k, buffer, &sched, chunk_size};
+                    measure_stats_t stats;
+                    measure_run(&cfg, gran_trial, &trial, &stats);
+
+                    printf("|  %8.2f%s ", stats.median, stats.unstable ? "?" : " ");
+                    fprintf(csv_file, "%zu,%s,%s,%d,%d,%s,%.2f", chunk_size, order->name, chunk_mode_name(k->mode),
+                            k->width, k->unroll, k->name, stats.median);
+                    measure_write_csv_values(csv_file, ",", &stats);
+                    fprintf(csv_file, "\n");
+                }
+            }
+            printf("\n");
+        }
+        pattern_free(&sched);
+    }
+    printf("\n? marks unstable measurements\n");
+
+    bench_csv_close(csv_file);
+    free(buffer);
+
+    printf("\nGranularity data has been saved to 'granularity_bandwidth.csv'\n");
+}
+
+// Function to measure the load bandwidth of each access pattern at every cache level, with one
+// independent 8-byte load per cache line so the core and prefetchers can overlap as many as
+// they can; bandwidth counts whole lines brought in
+void run_pattern_bandwidth(const access_pattern_t *patterns, int num_patterns, const size_t *sizes,
+                           const char *const *levels, long accesses) {
+    static measure_stats_t stats[PATTERN_MAX][NUM_PATTERN_LEVELS];
+    static perf_sample_t counters[PATTERN_MAX][NUM_PATTERN_LEVELS];
+    size_t max_size = sizes[NUM_PATTERN_LEVELS - 1];
+    size_t line_size = get_topology()->line_size;
+    int random = -1;
+
+    char *buffer = (char *) bench_alloc(max_size, 4096);
+    memset(buffer, 0, max_size);
+
+    for (int i = 0; i < num_patterns; i++) {
+        if (patterns[i].kind == PATTERN_RANDOM && random < 0) {
+            random = i;
+        }
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++) {
+            pattern_measure(&patterns[i], buffer, sizes[l], accesses, 0, PATTERN_TRIALS, &stats[i][l],
+                            &counters[i][l]);
+        }
+    }
+    free(buffer);
+
+    printf("Line bandwidth (GB/s) by access pattern%s:\n", random >= 0 ? ", speedup over random in ()" : "");
+    printf("%-16s", "Pattern");
+    for (int l = 0; l < NUM_PATTERN_LEVELS; l++) {
+        printf("  |  %-16s", levels[l]);
+    }
+    printf("\n");
+    for (int i = 0; i < num_patterns; i++) {
+        printf("%-16s", patterns[i].name);
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++) {
+            double gbps = line_size / stats[i][l].median;
+            if (random >= 0) {
+                printf("  |  %7.2f (%5.2fx)", gbps, stats[random][l].median / stats[i][l].median);
+            } else {
+                printf("  |  %16.2f", gbps);
+            }
+        }
+        printf("\n");
+    }
+
+    FILE *csv_file = bench_csv_open("access_pattern_bandwidth.csv");
+    fprintf(csv_file, "# Independent loads, one per %zu-byte line, %ld per trial; summary columns are ns per load\n",
+            line_size, accesses);
+    fprintf(csv_file, "Pattern,Cache Level,Working Set (bytes),Bandwidth (GB/s),ns per Load,Speedup vs Random");
+    measure_write_csv_header(csv_file, ",");
+    perf_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+    for (int i = 0; i < num_patterns; i++) {
+        for (int l = 0; l < NUM_PATTERN_LEVELS; l++) {
+            fprintf(csv_file, "%s,%s,%zu,%.2f,%.3f,", patterns[i].name, levels[l], sizes[l],
+                    line_size / stats[i][l].median, stats[i][l].median);
+            if (random >= 0) {
+                fprintf(csv_file, "%.3f", stats[random][l].median / stats[i][l].median);
+            }
+            measure_write_csv_values(csv_file, ",", &stats[i][l]);
+            perf_write_csv_values(csv_file, ",", &counters[i][l]);
+            fprintf(csv_file, "\n");
+        }
+    }
+    bench_csv_close(csv_file);
+
+    printf("\nAccess pattern data has been saved to 'access_pattern_bandwidth.csv'\n");
+}
+
+// Entry point of the bandwidth benchmark (membench bandwidth)
+int bandwidth_main(int argc, char *argv[]) {
+    // "stream" runs the vector streaming kernels, "parallel [max threads]" scales them
+    // across pinned threads, "ratio" runs the original chunk-size/read-ratio table, and
+    // "patterns [list]" walks each access pattern (access_pattern.h) with independent loads, and
+    // "granularity" reads and writes whole chunks with kernels of every access width.
+    // Parameters: mode, size (bytes per array), passes, threads and placement (parallel mode), patterns and
+    // pattern_accesses (patterns mode), chunks, order and gran_size (granularity mode), write_op,
+    // mix_burst and mix_order (ratio mode), seed, plus the repetition parameters of
+    // measure_config_default().
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "stream");
+    const topology_t *topo = get_topology();
+    size_t size = bench_param_size("size", topo->l3_size * 4 > MEM_SIZE ? topo->l3_size * 4 : MEM_SIZE);
+    int passes = (int)bench_param_long("passes", STREAM_TIMES);
+
+    if (size < BW_BLOCK_BYTES || passes <= 0) {
+        fprintf(stderr, "size must be at least %d bytes and passes positive\n", BW_BLOCK_BYTES);
+        return 1;
+    }
+    if (strcmp(mode, "stream") == 0) {
+        topology_write_header(stdout, topo);
+        run_stream_kernels(size);
+        return 0;
+    }
+    if (strcmp(mode, "parallel") == 0) {
+        topology_write_header(stdout, topo);
+        run_parallel_scaling(argc > 2 ? atoi(argv[2]) : (int)bench_param_long("threads", 0), size, passes);
+        return 0;
+    }
+    if (strcmp(mode, "ratio") == 0) {
+        return run_ratio_table();
+    }
+    if (strcmp(mode, "patterns") == 0) {
+        access_pattern_t patterns[PATTERN_MAX];
+        const char *levels[NUM_PATTERN_LEVELS] = {"L1d Cache", "L2 Cache", "L3 Cache", "Main Memory"};
+        size_t sizes[NUM_PATTERN_LEVELS] = {topo->l1d_size, topo->l2_size, topo->l3_size, size};
+        const char *list = argc > 2 ? argv[2] : bench_param_str("patterns", PATTERN_DEFAULT_LIST);
+        int num_patterns = pattern_parse_list(list, patterns, PATTERN_MAX);
+        long accesses = bench_param_long("pattern_accesses", PATTERN_ACCESSES);
+        if (num_patterns <= 0 || accesses <= 0 || sizes[NUM_PATTERN_LEVELS - 1] < sizes[NUM_PATTERN_LEVELS - 2]) {
+            fprintf(stderr, "Usage: %s patterns [seq,seq-back,stride:N,page-random,2m-random,block-random:N,random,zipf:S]\n",
+                    argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_pattern_bandwidth(patterns, num_patterns, sizes, levels, accesses);
+        return 0;
+    }
+
+    if (strcmp(mode, "granularity") == 0) {
+        size_t chunk_sizes[MAX_CHUNK_SIZES];
+        int num_chunk_sizes = 0;
+        char list[256];
+        access_pattern_t order;
+        size_t gran_size = bench_param_size("gran_size", topo->l3_size * 2 > GRAN_MIN_SIZE ? topo->l3_size * 2
+                                                                                          : GRAN_MIN_SIZE);
+
+        snprintf(list, sizeof(list), "%s", bench_param_str("chunks", GRAN_CHUNKS));
+        for (char *save, *tok = strtok_r(list, ",", &save); tok && num_chunk_sizes < MAX_CHUNK_SIZES;
+             tok = strtok_r(NULL, ",", &save)) {
+            chunk_sizes[num_chunk_sizes] = bench_parse_size(tok);
+            if (chunk_sizes[num_chunk_sizes] == 0 || chunk_sizes[num_chunk_sizes] % BW_ALIGNMENT != 0 ||
+                chunk_sizes[num_chunk_sizes] > gran_size) {
+                fprintf(stderr, "Chunk sizes must be multiples of %d bytes no larger than gran_size\n", BW_ALIGNMENT);
+                return 1;
+            }
+            num_chunk_sizes++;
+        }
+        if (num_chunk_sizes == 0 || pattern_parse(bench_param_str("order", "random"), &order) != 0) {
+            fprintf(stderr, "Usage: %s granularity [chunks=64,256,...] [order=<access pattern>] [gran_size=N]\n",
+                    argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_granularity(gran_size, chunk_sizes, num_chunk_sizes, &order);
+        return 0;
+    }
+
+    fprintf(stderr, "Usage: %s [stream|parallel [max threads]|ratio|patterns [list]|granularity]\n", argv[0]);
+    return 1;
+}
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "bandwidth");
+    return bandwidth_main(argc, argv);
+}
+#endif
@@ -1,172 +1,679 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <pthread.h>
 #include <time.h>
 
+#include "bench.h"
+#include "topology.h"
+#include "pointer_chase.h"
+#include "bandwidth_kernels.h"
+#include "affinity.h"
+#include "thread_pool.h"
+#include "perf_counters.h"
+#include "measure.h"
+#include "histogram.h"
+
 #define MEM_SIZE (256 * 1024 * 1024)  // 256MB memory block, larger than typical cache
 #define REPEAT 500  // Number of operations per thread (reduced to capture precise latencies)
+#define ROUNDS 100  // Default cap on timed pool rounds per configuration
+#define MAX_THREADS 16  // Thread counts swept from 1 to this
+#define MAX_THREADS_STUDY 256         // Upper bound on threads per placement in the placement study
+#define MAX_INJECTORS 255             // Upper bound on traffic injector threads
+#define INJECTOR_MIN_SIZE (16 * 1024 * 1024)  // Smallest per-injector traffic buffer (16MB)
+#define BURST_BYTES (16 * 1024)       // Bytes an injector streams between delays
+#define LOADED_HOPS 200000            // Dependent loads timed at each load point
+#define HIST_HOPS 200000              // Dependent loads per worker at each histogram point
+#define HIST_SAMPLE_EVERY 1           // Default: time every load in the histogram mode
+#define HIST_MAX_TOTAL (4UL << 30)    // Cap on the default histogram buffers summed over all workers (4GB)
+#define SETTLE_NS 20000000LL          // Time given to injectors to reach steady state (20ms)
 
 typedef struct {
     char *mem_block;          // Memory block to access
-    long operations;          // Number of operations to perform
-    double *latency;          // Pointer to store latency result
-    int is_read;              // 1 for read, 0 for write
-} thread_data_t;
-
-// Thread function to perform memory access operations (read or write)
-void *memory_access_thread(void *arg) {
-    thread_data_t *data = (thread_data_t *)arg;
-    char *mem_block = data->mem_block;
-    long operations = data->operations;
-    int is_read = data->is_read;
-
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t size;              // Bytes of the block the workers cycle through
+    long operations;          // Number of operations each worker performs
+    int num_readers;          // Workers with a lower id read, the others write
+} access_task_t;
 
-    // Perform memory access (read or write)
-    for (long i = 0; i < operations; i++) {
-        volatile char temp;
-        if (is_read) {
-            temp = mem_block[i % MEM_SIZE];  // Simulate read operation
-        } else {
-            mem_block[i % MEM_SIZE] = temp;  // Simulate write operation
+// Settings of the thread sweep, from the defaults, command line or config file
+typedef struct {
+    char *mem_block;          // Pre-faulted block shared by every measurement
+    size_t size;
+    long repeat;              // Operations per configuration, split across the workers
+    int rounds;               // Cap on timed pool rounds per configuration
+} sweep_config_t;
+
+// Shared control block for the loaded-latency injectors
+typedef struct {
+    volatile int stop;                // Set once to end the injector threads
+    volatile int active;              // 0 parks the injectors (idle-latency baseline)
+    volatile long delay;              // Pause iterations between bursts
+    volatile double read_ratio;       // Fraction of each burst that is read rather than written
+} injector_control_t;
+
+// Per-injector state; the byte counter sits on its own cache line
+typedef struct {
+    volatile uint64_t bytes;          // Bytes moved so far
+    int cpu;                          // CPU the injector is pinned to
+    char *buffer;                     // Private traffic buffer
+    size_t size;
+    injector_control_t *control;
+} __attribute__((aligned(64))) injector_t;
+
+// Thread function for a traffic injector: stream bursts of reads and writes over a private
+// buffer, then spin for the configured delay, until told to stop
+void *injector_thread(void *arg) {
+    injector_t *inj = (injector_t *)arg;
+    injector_control_t *ctl = inj->control;
+    const bw_kernel_t *read_kernel = bw_best_kernel(BW_READ, 0);
+    const bw_kernel_t *write_kernel = bw_best_kernel(BW_WRITE, 0);
+    size_t offset = 0;
+    volatile double sink;
+
+    pin_thread(inj->cpu);
+    memset(inj->buffer, 1, inj->size);  // First touch from the pinned thread
+
+    while (!ctl->stop) {
+        if (!ctl->active) {
+            __builtin_ia32_pause();
+            continue;
+        }
+
+        size_t read_bytes = (size_t)(BURST_BYTES * ctl->read_ratio);
+        read_bytes -= read_bytes % BW_BLOCK_BYTES;
+        if (read_bytes > 0) {
+            sink = read_kernel->fn(NULL, inj->buffer + offset, NULL, read_bytes);
+        }
+        if (read_bytes < BURST_BYTES) {
+            sink = write_kernel->fn(inj->buffer + offset + read_bytes, NULL, NULL, BURST_BYTES - read_bytes);
+        }
+        inj->bytes += BURST_BYTES;
+        offset = (offset + BURST_BYTES) % inj->size;
+
+        for (long d = ctl->delay; d > 0; d--) {
+            __builtin_ia32_pause();
         }
     }
+    (void)sink;
+    return NULL;
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &end);
+// Total bytes moved by all injectors so far
+static uint64_t injector_bytes(injector_t *injectors, int num_injectors) {
+    uint64_t total = 0;
+    for (int i = 0; i < num_injectors; i++) {
+        total += injectors[i].bytes;
+    }
+    return total;
+}
 
-    // Calculate latency (time per operation)
-    double time_taken = (end.tv_sec - start.tv_sec) + 
-                        (end.tv_nsec - start.tv_nsec) / 1e9;
-    *data->latency = (time_taken / operations) * 1e6;  // Latency in microseconds
+// Function to measure dependent-load latency on the calling thread while the injectors run,
+// returning ns per hop, the injectors' delivered bandwidth over the same window and the
+// calling thread's hardware counters over the timed hops
+double measure_loaded_point(void ***chain, long hops, injector_t *injectors, int num_injectors, double *bandwidth,
+                            perf_sample_t *counters) {
+    perf_counters_t *pc = get_perf_counters();
+    struct timespec start, end, settle;
+
+    // Let the injectors reach steady state at the new setting
+    clock_gettime(CLOCK_MONOTONIC, &settle);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    } while ((start.tv_sec - settle.tv_sec) * 1000000000LL + (start.tv_nsec - settle.tv_nsec) < SETTLE_NS);
+
+    uint64_t bytes_start = injector_bytes(injectors, num_injectors);
+    perf_counters_start(pc);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    *chain = chase_pointers(*chain, hops);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, counters);
+    uint64_t bytes_end = injector_bytes(injectors, num_injectors);
 
-    pthread_exit(NULL);
+    double ns = elapsed_ns(&start, &end);
+    *bandwidth = (double)(bytes_end - bytes_start) / ns;  // bytes/ns == GB/s
+    return ns / hops;
 }
 
-// Function to measure latency and throughput for a given number of threads (reads or writes)
-void measure_latency_throughput(int num_threads, int is_read, FILE *csv_file) {
-    pthread_t threads[num_threads];
-    thread_data_t thread_data[num_threads];
-    double latencies[num_threads];
-    double total_latency = 0;
-    long operations_per_thread = REPEAT / num_threads;
-    char *mem_block = (char *)malloc(MEM_SIZE);
+// Function to produce latency vs. delivered-bandwidth curves: one pinned thread chases
+// pointers through a DRAM-sized chain while injector threads on the other CPUs stream
+// read/write bursts separated by a shrinking delay. The latency thread takes the first CPU
+// of the placement until it returns, and the injectors the next ones.
+void run_loaded_latency(int num_injectors, long hops, const char *placement, const int *cpus, int num_cpus) {
+    const topology_t *topo = get_topology();
+    double read_ratios[] = {1.0, 0.75, 0.5, 0.0};
+    long delays[] = {20000, 10000, 5000, 2000, 1000, 500, 200, 100, 0};
+    int num_ratios = sizeof(read_ratios) / sizeof(read_ratios[0]);
+    int num_delays = sizeof(delays) / sizeof(delays[0]);
+
+    if (num_injectors <= 0 || num_injectors > MAX_INJECTORS) {
+        num_injectors = num_cpus > 1 ? num_cpus - 1 : 1;
+    }
+    if (num_cpus < num_injectors + 1) {
+        printf("Warning: only %d CPU(s) available; injectors will share CPUs with the latency thread\n", num_cpus);
+    }
 
-    // Initialize memory block
-    for (long i = 0; i < MEM_SIZE; i++) {
-        mem_block[i] = (char)(i % 256);
+    // Latency chain well past the LLC, built before any injector starts
+    size_t chain_size = topo->l3_size * 4 > MEM_SIZE ? topo->l3_size * 4 : MEM_SIZE;
+    void *chain_buffer = bench_alloc(chain_size, 4096);
+    cpu_mask_t saved;
+    save_thread_affinity(&saved);
+    pin_thread(cpus[0]);
+    void **chain = build_pointer_chain(chain_buffer, chain_size, topo->line_size);
+
+    // Each injector streams over its own buffer; together they cover several LLCs
+    size_t injector_size = topo->l3_size * 4 / num_injectors;
+    if (injector_size < INJECTOR_MIN_SIZE) {
+        injector_size = INJECTOR_MIN_SIZE;
+    }
+    injector_size -= injector_size % BURST_BYTES;
+
+    injector_control_t control = {0, 0, 0, 1.0};
+    injector_t *injectors = (injector_t *) aligned_alloc(64, num_injectors * sizeof(injector_t));
+    pthread_t threads[MAX_INJECTORS];
+    if (!injectors) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < num_injectors; i++) {
+        injectors[i].bytes = 0;
+        injectors[i].cpu = cpus[(i + 1) % num_cpus];
+        injectors[i].size = injector_size;
+        injectors[i].buffer = (char *) aligned_alloc(4096, injector_size);
+        injectors[i].control = &control;
+        if (!injectors[i].buffer) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        pthread_create(&threads[i], NULL, injector_thread, &injectors[i]);
     }
 
-    // Start threads to simulate memory access (reads or writes)
-    for (int i = 0; i < num_threads; i++) {
-        thread_data[i].mem_block = mem_block;
-        thread_data[i].operations = operations_per_thread;
-        thread_data[i].latency = &latencies[i];
-        thread_data[i].is_read = is_read;
-        pthread_create(&threads[i], NULL, memory_access_thread, (void *)&thread_data[i]);
+    FILE *csv_file = bench_csv_open("loaded_latency.csv");
+    placement_write_header(csv_file, placement, cpus, num_cpus < num_injectors + 1 ? num_cpus : num_injectors + 1);
+    fprintf(csv_file, "# Counters are the latency thread's totals over %ld timed hops per point\n", hops);
+    fprintf(csv_file, "Read Ratio,Delay (pause iterations),Injectors,Latency (ns),Bandwidth (GB/s)");
+    perf_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    printf("Loaded latency with %d injector(s), chain of %zu MB\n", num_injectors, chain_size / (1024 * 1024));
+
+    // Idle baseline with the injectors parked
+    double bandwidth;
+    perf_sample_t counters;
+    double latency = measure_loaded_point(&chain, hops, injectors, num_injectors, &bandwidth, &counters);
+    printf("Idle: Latency = %.2f ns\n", latency);
+    fprintf(csv_file, "idle,-,0,%.2f,%.2f", latency, bandwidth);
+    perf_write_csv_values(csv_file, ",", &counters);
+    fprintf(csv_file, "\n");
+
+    for (int r = 0; r < num_ratios; r++) {
+        printf("\n%.0f%% read / %.0f%% write\n", read_ratios[r] * 100, (1.0 - read_ratios[r]) * 100);
+        printf("Delay    |  Latency (ns)  |  Bandwidth (GB/s)\n");
+        printf("---------------------------------------------\n");
+        control.read_ratio = read_ratios[r];
+        for (int d = 0; d < num_delays; d++) {
+            control.delay = delays[d];
+            control.active = 1;
+            latency = measure_loaded_point(&chain, hops, injectors, num_injectors, &bandwidth, &counters);
+            printf("%7ld  |  %12.2f  |  %16.2f\n", delays[d], latency, bandwidth);
+            fprintf(csv_file, "%.2f,%ld,%d,%.2f,%.2f", read_ratios[r], delays[d], num_injectors, latency, bandwidth);
+            perf_write_csv_values(csv_file, ",", &counters);
+            fprintf(csv_file, "\n");
+        }
     }
 
-    // Wait for threads to finish
-    for (int i = 0; i < num_threads; i++) {
+    control.stop = 1;
+    for (int i = 0; i < num_injectors; i++) {
         pthread_join(threads[i], NULL);
-        total_latency += latencies[i];
+        free(injectors[i].buffer);
     }
+    free(injectors);
+    free(chain_buffer);
+    bench_csv_close(csv_file);
+    restore_thread_affinity(&saved);
 
-    // Calculate average latency and throughput
-    double avg_latency = total_latency / num_threads;
-    double throughput = (double)(REPEAT) / (avg_latency / 1e6);  // Throughput in operations per second
+    printf("\nLoaded latency data has been saved to 'loaded_latency.csv'\n");
+}
 
-    // Output results
-    if (is_read) {
-        printf("%d threads (Read): Average Latency = %.4f us, Throughput = %.4f ops/sec\n", 
-               num_threads, avg_latency, throughput);
-        fprintf(csv_file, "%d,read,%.4f,%.4f\n", num_threads, avg_latency, throughput);
-    } else {
-        printf("%d threads (Write): Average Latency = %.4f us, Throughput = %.4f ops/sec\n", 
-               num_threads, avg_latency, throughput);
-        fprintf(csv_file, "%d,write,%.4f,%.4f\n", num_threads, avg_latency, throughput);
+// Shared state of the threaded latency histograms: each worker chases its own chain
+typedef struct {
+    char **buffers;           // One private buffer per worker
+    size_t size;              // Working set each worker chases over
+    long hops;                // Dependent loads per worker
+    int sample_every;         // Time one load in this many
+    void ***chains;           // Where each worker's chase stopped
+    hist_t *hists;            // One histogram per worker, merged after the round
+} hist_task_t;
+
+// Pool task faulting in a worker's buffer, so its pages come from the pinned thread's first touch
+static void hist_touch_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    hist_task_t *task = (hist_task_t *)arg;
+    (void)num_threads;
+
+    memset(task->buffers[thread_id], 0, task->size);
+    slot->ops = 0;
+}
+
+// Pool task walking a worker's chain once so its working set is resident in the worker's caches
+static void hist_warm_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    hist_task_t *task = (hist_task_t *)arg;
+    size_t num_lines = task->size / get_topology()->line_size;
+    (void)num_threads;
+
+    task->chains[thread_id] = chase_pointers(task->chains[thread_id],
+                                             num_lines < (size_t)task->hops ? (long)num_lines : task->hops);
+    slot->ops = 0;
+}
+
+// Pool task timing individual dependent loads into the worker's own histogram
+static void hist_chase_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    hist_task_t *task = (hist_task_t *)arg;
+    (void)num_threads;
+
+    hist_reset(&task->hists[thread_id]);
+    task->chains[thread_id] = chase_pointers_sampled(task->chains[thread_id], task->hops, task->sample_every,
+                                                     &task->hists[thread_id]);
+    slot->ops = task->hops;
+}
+
+// Function to record per-load latency distributions for every cache level and thread count,
+// each worker chasing a private chain sized to the level
+void run_latency_histograms(int max_threads, size_t mem_size, long hops, int sample_every, const char *placement,
+                            const int *cpus, int num_cpus) {
+    const topology_t *topo = get_topology();
+    const char *labels[] = {"L1d Cache", "L2 Cache", "L3 Cache", "Main Memory"};
+    size_t sizes[] = {topo->l1d_size, topo->l2_size, topo->l3_size, mem_size};
+    int num_levels = sizeof(sizes) / sizeof(sizes[0]);
+    thread_pool_t *pool = pool_create(max_threads, cpus, num_cpus);
+    hist_task_t task;
+    hist_t merged;
+    char prefix[64];
+
+    task.buffers = (char **) bench_alloc(max_threads * sizeof(char *), 64);
+    task.chains = (void ***) bench_alloc(max_threads * sizeof(void **), 64);
+    task.hists = (hist_t *) bench_alloc(max_threads * sizeof(hist_t), 64);
+    for (int i = 0; i < max_threads; i++) {
+        task.buffers[i] = (char *) bench_alloc(mem_size, 4096);
+    }
+    task.size = mem_size;
+    task.hops = hops;
+    task.sample_every = sample_every;
+    pool_run(pool, max_threads, hist_touch_task, &task);
+
+    FILE *percentile_csv = bench_csv_open("thread_latency_percentiles.csv");
+    FILE *histogram_csv = bench_csv_open("thread_latency_histogram.csv");
+    placement_write_header(percentile_csv, placement, cpus, num_cpus);
+    placement_write_header(histogram_csv, placement, cpus, num_cpus);
+    fprintf(percentile_csv, "# TSC cycles per sampled dependent load (1 in %d), timer overhead of %llu cycles removed,"
+            " merged over all workers\n", sample_every, (unsigned long long)measure_tsc_overhead_cycles());
+    fprintf(percentile_csv, "Cache Level,Threads");
+    hist_write_percentiles_header(percentile_csv, ",");
+    fprintf(percentile_csv, "\n");
+    fprintf(histogram_csv, "Cache Level,Threads,Bucket Low (cycles),Bucket High (cycles),Count\n");
+
+    for (int l = 0; l < num_levels; l++) {
+        printf("\n%s, %zu KB per thread (load latency in cycles):\n", labels[l], sizes[l] / 1024);
+        task.size = sizes[l];
+        // Chains are built here, in worker order, so the seeded stream gives every worker the
+        // same chain on every run; the workers only walk them. They do not depend on the
+        // thread count, so each level builds them once.
+        for (int i = 0; i < max_threads; i++) {
+            task.chains[i] = build_pointer_chain(task.buffers[i], task.size, topo->line_size);
+        }
+        for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+            pool_run(pool, num_threads, hist_warm_task, &task);
+            pool_run(pool, num_threads, hist_chase_task, &task);
+
+            hist_reset(&merged);
+            for (int i = 0; i < num_threads; i++) {
+                hist_merge(&merged, &task.hists[i]);
+            }
+
+            printf("%2d threads: ", num_threads);
+            hist_print(stdout, &merged);
+            printf("\n");
+            snprintf(prefix, sizeof(prefix), "%s,%d", labels[l], num_threads);
+            fprintf(percentile_csv, "%s", prefix);
+            hist_write_percentiles(percentile_csv, ",", &merged);
+            fprintf(percentile_csv, "\n");
+            hist_write_buckets(histogram_csv, ",", prefix, &merged);
+        }
+    }
+
+    pool_destroy(pool);
+    for (int i = 0; i < max_threads; i++) {
+        free(task.buffers[i]);
     }
+    free(task.buffers);
+    free(task.chains);
+    free(task.hists);
+    bench_csv_close(percentile_csv);
+    bench_csv_close(histogram_csv);
 
-    // Free memory block
-    free(mem_block);
+    printf("\nLatency distributions have been saved to 'thread_latency_percentiles.csv' and 'thread_latency_histogram.csv'\n");
 }
 
-// Function to measure combined read and write operations
-void measure_combined_latency_throughput(int num_threads, FILE *csv_file) {
-    pthread_t threads[num_threads * 2];
-    thread_data_t thread_data[num_threads * 2];
-    double latencies[num_threads * 2];
+// Pool task performing memory access operations: workers below 'num_readers' read, the rest write
+void memory_access_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    access_task_t *task = (access_task_t *)arg;
+    char *mem_block = task->mem_block;
+    size_t size = task->size;
+    long operations = task->operations;
+    int is_read = thread_id < task->num_readers;
+    (void)num_threads;
+
+    // Perform memory access (read or write)
+    for (long i = 0; i < operations; i++) {
+        volatile char temp;
+        if (is_read) {
+            temp = mem_block[i % size];  // Simulate read operation
+            (void)temp;
+        } else {
+            mem_block[i % size] = (char)i;  // Simulate write operation
+        }
+    }
+    slot->ops = operations;
+}
+
+// State of one repeated thread-sweep measurement: each trial is one pool round
+typedef struct {
+    thread_pool_t *pool;
+    int active;
+    access_task_t *task;
+    double latency[MEASURE_MAX_TRIALS];   // Per-round average per-operation latency, in us
+    int num_rounds;
+} access_rounds_t;
+
+// Function to run one pool round, recording the workers' average per-operation latency and
+// returning throughput as total operations over the round's global wall clock
+static double access_round(void *arg) {
+    access_rounds_t *r = (access_rounds_t *)arg;
+    double wall_ns = pool_run(r->pool, r->active, memory_access_task, r->task);
     double total_latency = 0;
-    long operations_per_thread = REPEAT / num_threads;
-    char *mem_block = (char *)malloc(MEM_SIZE);
+    uint64_t total_ops = 0;
 
-    // Initialize memory block
-    for (long i = 0; i < MEM_SIZE; i++) {
-        mem_block[i] = (char)(i % 256);
+    for (int i = 0; i < r->active; i++) {
+        const pool_slot_t *slot = pool_slot(r->pool, i);
+        double ns = elapsed_ns(&slot->start, &slot->end);
+        total_ops += slot->ops;
+        total_latency += slot->ops ? ns / slot->ops / 1e3 : 0;  // Latency in microseconds
     }
+    r->latency[r->num_rounds++] = total_latency / r->active;
+    return (double)total_ops / (wall_ns / 1e9);  // Throughput in operations per second
+}
 
-    // Start threads to simulate combined memory access (reads and writes)
-    for (int i = 0; i < num_threads * 2; i++) {
-        thread_data[i].mem_block = mem_block;
-        thread_data[i].operations = operations_per_thread / 2;
-        thread_data[i].latency = &latencies[i];
-        thread_data[i].is_read = (i < num_threads);  // First half reads, second half writes
-        pthread_create(&threads[i], NULL, memory_access_thread, (void *)&thread_data[i]);
+// Function to repeat pool rounds until throughput converges (at most 'rounds' by default)
+// and summarize per-round latency and throughput
+static void run_access_rounds(thread_pool_t *pool, int active, access_task_t *task, int rounds,
+                              measure_stats_t *latency, measure_stats_t *throughput) {
+    static access_rounds_t r;
+    measure_config_t cfg;
+
+    measure_config_default(&cfg, rounds);
+    r.pool = pool;
+    r.active = active;
+    r.task = task;
+    for (int i = 0; i < cfg.warmup; i++) {
+        pool_run(pool, active, memory_access_task, task);  // Untimed warm-up rounds
     }
+    cfg.warmup = 0;
+    r.num_rounds = 0;
+    measure_run(&cfg, access_round, &r, throughput);
+    measure_summarize(r.latency, r.num_rounds, cfg.unstable_cv, cfg.ci_target, latency);
+}
 
-    // Wait for threads to finish
-    for (int i = 0; i < num_threads * 2; i++) {
-        pthread_join(threads[i], NULL);
-        total_latency += latencies[i];
+// Function to print and save one thread-sweep point
+static void report_access_point(FILE *csv_file, int num_threads, const char *op, const char *label,
+                                const measure_stats_t *latency, const measure_stats_t *throughput) {
+    printf("%d threads (%s): Average Latency = %.4f us (p99 %.4f), Throughput = %.4f ops/sec (+-%.1f%%, %d rounds)%s\n",
+           num_threads, label, latency->median, latency->p99, throughput->median,
+           throughput->mean > 0 ? 100 * throughput->ci95 / throughput->mean : 0, throughput->trials,
+           throughput->unstable ? " UNSTABLE" : "");
+    fprintf(csv_file, "%d,%s,%.4f,%.4f,%.4f", num_threads, op, latency->median, throughput->median, latency->p99);
+    measure_write_csv_values(csv_file, ",", throughput);
+    fprintf(csv_file, "\n");
+}
+
+// Function to measure latency and throughput for a given number of threads (reads or writes)
+void measure_latency_throughput(thread_pool_t *pool, const sweep_config_t *cfg, int num_threads, int is_read,
+                                FILE *csv_file) {
+    access_task_t task = {cfg->mem_block, cfg->size, cfg->repeat / num_threads, is_read ? num_threads : 0};
+    measure_stats_t latency, throughput;
+
+    run_access_rounds(pool, num_threads, &task, cfg->rounds, &latency, &throughput);
+
+    // Output results
+    if (is_read) {
+        report_access_point(csv_file, num_threads, "read", "Read", &latency, &throughput);
+    } else {
+        report_access_point(csv_file, num_threads, "write", "Write", &latency, &throughput);
     }
+}
 
-    // Calculate average latency and throughput
-    double avg_latency = total_latency / (num_threads * 2);
-    double throughput = (double)(REPEAT) / (avg_latency / 1e6);  // Throughput in operations per second
+// Function to measure combined read and write operations
+void measure_combined_latency_throughput(thread_pool_t *pool, const sweep_config_t *cfg, int num_threads,
+                                         FILE *csv_file) {
+    // First half of the workers read, second half write
+    access_task_t task = {cfg->mem_block, cfg->size, cfg->repeat / num_threads / 2, num_threads};
+    measure_stats_t latency, throughput;
+
+    run_access_rounds(pool, num_threads * 2, &task, cfg->rounds, &latency, &throughput);
 
     // Output results
-    printf("%d threads (Combined Read/Write): Average Latency = %.4f us, Throughput = %.4f ops/sec\n", 
-           num_threads, avg_latency, throughput);
-    fprintf(csv_file, "%d,combined,%.4f,%.4f\n", num_threads, avg_latency, throughput);
+    report_access_point(csv_file, num_threads, "combined", "Combined Read/Write", &latency, &throughput);
+}
+
+// Function to compare thread placements: the read and write sweeps run under each policy
+// from one thread up to max_threads or the CPUs the policy offers, never more, so at equal
+// thread counts the compact and smt curves share physical cores where scatter does not
+void run_placement_study(const sweep_config_t *cfg, int max_threads) {
+    static const char *policies[] = {"compact", "scatter", "smt", "llc"};
+    enum { num_policies = sizeof(policies) / sizeof(policies[0]) };
+    static double throughput_ops[2][num_policies][MAX_THREADS_STUDY];
+    int offered[num_policies];
+    int cpus[MAX_THREADS_STUDY];
+
+    FILE *csv_file = bench_csv_open("placement_throughput.csv");
+    fprintf(csv_file, "# Latency and throughput are medians over pool rounds; summary columns describe per-round throughput\n");
+    fprintf(csv_file, "Placement,Threads,Cores,LLC Domains,CPUs,Operation Type,Latency (us),Throughput (ops/sec),Latency P99 (us)");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    for (int p = 0; p < num_policies; p++) {
+        int num_cpus = get_placement_cpus(policies[p], cpus, max_threads);
+        offered[p] = num_cpus > 0 ? num_cpus : 0;
+        if (num_cpus <= 0) {
+            printf("Skipping placement '%s'\n\n", policies[p]);
+            continue;
+        }
+        // The Placement and CPUs columns carry the policy's CPUs in the CSV
+        placement_write_header(stdout, policies[p], cpus, num_cpus);
+        thread_pool_t *pool = pool_create(num_cpus, cpus, num_cpus);
+
+        for (int is_read = 1; is_read >= 0; is_read--) {
+            for (int num_threads = 1; num_threads <= num_cpus; num_threads++) {
+                access_task_t task = {cfg->mem_block, cfg->size, cfg->repeat / num_threads, is_read ? num_threads : 0};
+                measure_stats_t latency, throughput;
+                char used[16 * MAX_THREADS_STUDY];
+                int cores, llcs, len = 0;
+
+                run_access_rounds(pool, num_threads, &task, cfg->rounds, &latency, &throughput);
+                throughput_ops[is_read][p][num_threads - 1] = throughput.median;
+                placement_spread(cpus, num_threads, &cores, &llcs);
+                for (int i = 0; i < num_threads; i++) {
+                    len += snprintf(used + len, sizeof(used) - len, "%s%d", i ? " " : "", cpus[i]);
+                }
+                printf("%-8s %2d threads on %2d core(s), %d LLC(s) (%s): Latency = %.4f us, Throughput = %.4f ops/sec%s\n",
+                       policies[p], num_threads, cores, llcs, is_read ? "read" : "write", latency.median,
+                       throughput.median, throughput.unstable ? " UNSTABLE" : "");
+                fprintf(csv_file, "%s,%d,%d,%d,%s,%s,%.4f,%.4f,%.4f", policies[p], num_threads, cores, llcs, used,
+                        is_read ? "read" : "write", latency.median, throughput.median, latency.p99);
+                measure_write_csv_values(csv_file, ",", &throughput);
+                fprintf(csv_file, "\n");
+            }
+        }
+        pool_destroy(pool);
+        printf("\n");
+    }
 
-    // Free memory block
-    free(mem_block);
+    // Side by side: at equal thread counts, compact over scatter is the cost of sharing cores
+    for (int is_read = 1; is_read >= 0; is_read--) {
+        printf("%s throughput (ops/sec) by placement:\nThreads", is_read ? "Read" : "Write");
+        for (int p = 0; p < num_policies; p++) {
+            printf(" %14s", policies[p]);
+        }
+        printf(" %16s\n", "compact/scatter");
+        for (int t = 1; t <= max_threads; t++) {
+            printf("%7d", t);
+            for (int p = 0; p < num_policies; p++) {
+                if (t <= offered[p]) {
+                    printf(" %14.4g", throughput_ops[is_read][p][t - 1]);
+                } else {
+                    printf(" %14s", "-");
+                }
+            }
+            if (t <= offered[0] && t <= offered[1]) {
+                printf(" %16.3f", throughput_ops[is_read][0][t - 1] / throughput_ops[is_read][1][t - 1]);
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    bench_csv_close(csv_file);
+    printf("Results saved to 'placement_throughput.csv'\n");
 }
 
-int main() {
-    FILE *csv_file = fopen("memory_latency_throughput.csv", "w");
-    if (!csv_file) {
-        perror("Error opening CSV file");
+// Entry point of the latency/throughput benchmark (membench throughput)
+int throughput_main(int argc, char *argv[]) {
+    // "loaded [injectors]" runs the loaded-latency curve instead of the thread sweep, and
+    // "histogram [max threads]" records per-load latency distributions per level and thread count,
+    // and "placement [max threads]" compares the sweep under the compact, scatter, smt and llc
+    // placements. Parameters: mode, placement (affinity.h, default allowed), threads, repeat,
+    // rounds, size, injectors, hops, hist_hops, sample_every, mem_size (per histogram thread,
+    // default 4 x L3 capped so all threads together take about HIST_MAX_TOTAL), plus the
+    // repetition parameters of measure_config_default() for the sweep.
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "sweep");
+    const char *placement = bench_param_str("placement", "allowed");
+    int cpus[PLACE_MAX_CPUS];
+    int num_cpus = get_placement_cpus(placement, cpus, PLACE_MAX_CPUS);
+    if (num_cpus <= 0) {
+        return 1;
+    }
+    if (strcmp(mode, "histogram") == 0) {
+        const topology_t *topo = get_topology();
+        int max_threads = argc > 2 ? atoi(argv[2]) : (int)bench_param_long("threads", num_cpus);
+        // Every worker gets its own mem_size buffer, so the default shrinks with the thread count
+        // (never below the L3) to keep the total near HIST_MAX_TOTAL
+        size_t hist_default = max_threads > 0 ? HIST_MAX_TOTAL / max_threads : 0;
+        hist_default = hist_default > topo->l3_size * 4 ? topo->l3_size * 4
+                       : hist_default < topo->l3_size ? topo->l3_size : hist_default;
+        size_t mem_size = bench_param_size("mem_size", hist_default);
+        long hops = bench_param_long("hist_hops", HIST_HOPS);
+        int sample_every = (int)bench_param_long("sample_every", HIST_SAMPLE_EVERY);
+        if (max_threads <= 0 || max_threads > POOL_MAX_THREADS || mem_size < topo->l3_size || hops <= 0 ||
+            sample_every <= 0) {
+            fprintf(stderr, "Usage: %s histogram [max threads] [mem_size=BYTES per thread, at least the L3;"
+                    " max threads x mem_size are allocated, by default about %lu MB]\n", argv[0],
+                    HIST_MAX_TOTAL >> 20);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        printf("Histogram buffers: %d x %zu MB = %zu MB\n", max_threads, mem_size >> 20,
+               max_threads * (mem_size >> 20));
+        placement_write_header(stdout, placement, cpus, num_cpus < max_threads ? num_cpus : max_threads);
+        run_latency_histograms(max_threads, mem_size, hops, sample_every, placement, cpus,
+                               num_cpus < max_threads ? num_cpus : max_threads);
+        return 0;
+    }
+    if (strcmp(mode, "loaded") == 0) {
+        int num_injectors = argc > 2 ? atoi(argv[2]) : (int)bench_param_long("injectors", 0);
+        long hops = bench_param_long("hops", LOADED_HOPS);
+        if (hops <= 0) {
+            fprintf(stderr, "hops must be positive\n");
+            return 1;
+        }
+        topology_write_header(stdout, get_topology());
+        run_loaded_latency(num_injectors, hops, placement, cpus, num_cpus < MAX_INJECTORS + 1 ? num_cpus : MAX_INJECTORS + 1);
+        return 0;
+    }
+    int max_threads = (int)bench_param_long("threads", MAX_THREADS);
+    sweep_config_t cfg;
+    cfg.size = bench_param_size("size", MEM_SIZE);
+    cfg.repeat = bench_param_long("repeat", REPEAT);
+    cfg.rounds = (int)bench_param_long("rounds", ROUNDS);
+    if (strcmp(mode, "placement") == 0) {
+        max_threads = argc > 2 ? atoi(argv[2]) : (int)bench_param_long("threads", get_allowed_cpus(cpus, PLACE_MAX_CPUS));
+        if (max_threads <= 0 || max_threads > MAX_THREADS_STUDY || cfg.size == 0 || cfg.repeat < max_threads ||
+            cfg.rounds <= 0) {
+            fprintf(stderr, "Usage: %s placement [max threads]\n", argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, get_topology());
+        cfg.mem_block = (char *) bench_alloc(cfg.size, 4096);
+        for (size_t i = 0; i < cfg.size; i++) {
+            cfg.mem_block[i] = (char)(i % 256);
+        }
+        run_placement_study(&cfg, max_threads);
+        free(cfg.mem_block);
+        return 0;
+    }
+    if (strcmp(mode, "sweep") != 0 || max_threads <= 0 || cfg.size == 0 || cfg.repeat < 2 * max_threads ||
+        cfg.rounds <= 0) {
+        fprintf(stderr, "Usage: %s [sweep|loaded [injectors]|histogram [max threads]|placement [max threads]]\n", argv[0]);
         return 1;
     }
 
-    // Write CSV headers
-    fprintf(csv_file, "Threads,Operation Type,Latency (us),Throughput (ops/sec)\n");
+    FILE *csv_file = bench_csv_open("memory_latency_throughput.csv");
+    placement_write_header(csv_file, placement, cpus, num_cpus < 2 * max_threads ? num_cpus : 2 * max_threads);
+    fprintf(csv_file, "# Latency and throughput are medians over pool rounds; summary columns describe per-round throughput\n");
+    fprintf(csv_file, "Threads,Operation Type,Latency (us),Throughput (ops/sec),Latency P99 (us)");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
 
     printf("Demonstrating the trade-off between read/write latency and throughput with increasing threads\n");
-    printf("Using memory size = %d MB\n\n", MEM_SIZE / (1024 * 1024));
+    printf("Using memory size = %zu MB\n\n", cfg.size / (1024 * 1024));
+
+    // Allocate and pre-fault the memory block once for every measurement
+    cfg.mem_block = (char *) bench_alloc(cfg.size, 4096);
+    for (size_t i = 0; i < cfg.size; i++) {
+        cfg.mem_block[i] = (char)(i % 256);
+    }
 
-    // Simulate read latency/throughput from 1 to 16 threads
-    for (int num_threads = 1; num_threads <= 16; num_threads++) {
-        measure_latency_throughput(num_threads, 1, csv_file);  // Measure read performance
+    // Workers are created and pinned once, in placement order; combined runs need twice the
+    // thread count
+    thread_pool_t *pool = pool_create(2 * max_threads, cpus, num_cpus);
+
+    // Simulate read latency/throughput from 1 to max_threads threads
+    for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+        measure_latency_throughput(pool, &cfg, num_threads, 1, csv_file);  // Measure read performance
     }
 
     printf("\n");
 
-    // Simulate write latency/throughput from 1 to 16 threads
-    for (int num_threads = 1; num_threads <= 16; num_threads++) {
-        measure_latency_throughput(num_threads, 0, csv_file);  // Measure write performance
+    // Simulate write latency/throughput from 1 to max_threads threads
+    for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+        measure_latency_throughput(pool, &cfg, num_threads, 0, csv_file);  // Measure write performance
     }
 
     printf("\n");
 
-    // Simulate combined read and write latency/throughput from 1 to 16 threads
-    for (int num_threads = 1; num_threads <= 16; num_threads++) {
-        measure_combined_latency_throughput(num_threads, csv_file);  // Measure combined read/write performance
+    // Simulate combined read and write latency/throughput from 1 to max_threads threads
+    for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+        measure_combined_latency_throughput(pool, &cfg, num_threads, csv_file);  // Measure combined read/write performance
     }
 
-    fclose(csv_file);
+    pool_destroy(pool);
+    free(cfg.mem_block);
+    bench_csv_close(csv_file);
     printf("\nResults saved to 'memory_latency_throughput.csv'\n");
 
     return 0;
 }
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "throughput");
+    return throughput_main(argc, argv);
+}
+#endif
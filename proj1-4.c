@@ -1,73 +1,326 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
-#define L1D_CACHE_SIZE (48 * 1024)  // 48 KiB per core for L1 data cache
-#define L2_CACHE_SIZE  (1.25 * 1024 * 1024)  // 1.25 MiB per core for L2 cache
-#define L3_CACHE_SIZE  (24 * 1024 * 1024)  // 24 MiB shared L3 cache
-#define CACHE_LINE_SIZE 64  // Cache line size is 64 bytes
+#include "bench.h"
+#include "topology.h"
+#include "perf_counters.h"
+#include "tsc.h"
+#include "measure.h"
+#include "compute_kernels.h"
+
 #define MULTIPLICATION_CONSTANT 3  // Lightweight computation constant
 #define REPEAT 1000  // Repeat the operation to get average values
+#define PEAK_ITERS 1000000  // Iterations of a peak kernel per trial
+#define ROOF_TRIAL_FLOPS 64e6  // Flops per intensity trial; low intensities stream more bytes
+#define ROOF_TRIAL_BYTES (64UL * 1024 * 1024)  // Bytes per bandwidth-ceiling trial
+#define ROOF_TRIALS 10  // Default cap on repeated trials per roofline point
+#define MAX_INTENSITIES 16  // Upper bound on intensities in one run
+#define NUM_ROOF_LEVELS 4  // L1d, L2, L3 and main memory
+#define ROOF_DEFAULT_INTENSITIES "1,2,4,8,16,32,64"  // Flops per byte run when none are given
 
-// Function to get the current CPU cycle count
-static inline uint64_t rdtsc() {
-    unsigned int lo, hi;
-    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-    return ((uint64_t)hi << 32) | lo;
-}
-
-// Function to perform computation and measure latency and CPU cycles
-void compute_with_size(int data_size, int num_elements, double *latency, double *cpu_cycles) {
+// Function to perform computation and measure latency, TSC and core cycles and hardware counters
+void compute_with_size(size_t data_size, size_t num_elements, int repeat, double *latency, tsc_sample_t *cycles,
+                       perf_sample_t *counters) {
+    perf_counters_t *pc = get_perf_counters();
     struct timespec start, end;
-    int *array = (int *)malloc(data_size);
-    uint64_t cycles_start, cycles_end;
+    int *array = (int *)bench_alloc(data_size, 64);
+    tsc_region_t region;
 
     // Initialize the array
-    for (int i = 0; i < num_elements; i++) {
+    for (size_t i = 0; i < num_elements; i++) {
         array[i] = i;
     }
 
-    // Start measuring time and CPU cycles
+    // Start measuring time, cycles and hardware counters
+    perf_counters_start(pc);
     clock_gettime(CLOCK_MONOTONIC, &start);
-    cycles_start = rdtsc();
+    tsc_region_start(&region);
 
     // Perform lightweight multiplication
-    for (int j = 0; j < REPEAT; j++) {
-        for (int i = 0; i < num_elements; i++) {
+    for (int j = 0; j < repeat; j++) {
+        for (size_t i = 0; i < num_elements; i++) {
             array[i] *= MULTIPLICATION_CONSTANT;
         }
     }
 
-    // Stop measuring time and CPU cycles
-    cycles_end = rdtsc();
+    // Stop measuring time, cycles and hardware counters
+    tsc_region_stop(&region, cycles);
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, counters);
 
-    // Calculate elapsed time in seconds and CPU cycles
+    // Calculate elapsed time in seconds
     *latency = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-    *cpu_cycles = (double)(cycles_end - cycles_start);
 
     free(array);  // Clean up
 }
 
-int main() {
+// State of one repeated pass over a working set, by either the read kernel of the bandwidth
+// ceilings or an intensity kernel. Trials continue where the previous one stopped, so a
+// trial shorter than the working set still streams all of it.
+typedef struct {
+    const bw_kernel_t *read;
+    const roof_kernel_t *roof;
+    const char *buffer;
+    size_t size;
+    size_t trial_bytes;
+    size_t pos;
+    double units_per_byte;            // Bytes or flops counted per byte read
+    volatile double sink;
+} roof_trial_t;
+
+// Function to time one trial over the working set, returning GB/s or GFLOP/s
+static double roof_trial(void *arg) {
+    roof_trial_t *t = arg;
+    struct timespec start, end;
+    double sum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t done = 0; done < t->trial_bytes;) {
+        size_t n = t->size - t->pos < t->trial_bytes - done ? t->size - t->pos : t->trial_bytes - done;
+        if (t->roof) {
+            sum += t->roof->fn((const double *)(t->buffer + t->pos), n);
+        } else {
+            sum += t->read->fn(NULL, t->buffer + t->pos, NULL, n);
+        }
+        done += n;
+        t->pos = t->pos + n == t->size ? 0 : t->pos + n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t->sink = sum;
+    return t->units_per_byte * t->trial_bytes / measure_elapsed_ns(&start, &end);
+}
+
+// State of one repeated peak-kernel measurement
+typedef struct {
+    const peak_kernel_t *kernel;
+    volatile double sink;
+} peak_trial_t;
+
+// Function to time one call of a peak kernel, returning GFLOP/s or GOP/s
+static double peak_trial(void *arg) {
+    peak_trial_t *t = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t->sink = t->kernel->fn(PEAK_ITERS);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return t->kernel->ops_per_iter * PEAK_ITERS / measure_elapsed_ns(&start, &end);
+}
+
+// Round a working set down to whole kernel blocks
+static size_t roof_round(size_t size) {
+    return size / ROOF_BLOCK_BYTES > 0 ? size / ROOF_BLOCK_BYTES * ROOF_BLOCK_BYTES : ROOF_BLOCK_BYTES;
+}
+
+// Function to build a roofline on one core: peak FP64 and integer throughput of every
+// instruction set, the read bandwidth of each level as the memory ceilings, and the achieved
+// GFLOP/s of intensity kernels at each level. A point well under a memory ceiling calls for a
+// better data layout; one under the compute ceiling, for better vectorization.
+void run_roofline(const int *fmas, int num_intensities, bw_isa_t isa, size_t mem_size) {
+    const topology_t *topo = get_topology();
+    const char *level_names[NUM_ROOF_LEVELS] = {"L1d", "L2", "L3", "Memory"};
+    size_t level_sizes[NUM_ROOF_LEVELS] = {roof_round(topo->l1d_size / 2), roof_round(topo->l2_size / 2),
+                                           roof_round(topo->l3_size / 2), roof_round(mem_size)};
+    double level_bw[NUM_ROOF_LEVELS];
+    double peak[PEAK_NUM_KINDS] = {0}, scalar_peak = 0;
+    const char *peak_isa[PEAK_NUM_KINDS] = {"-", "-"};
+    measure_stats_t stats;
+    measure_config_t cfg;
+    int count;
+
+    measure_config_default(&cfg, ROOF_TRIALS);
+    char *buffer = (char *) bench_alloc(level_sizes[NUM_ROOF_LEVELS - 1], ROOF_ALIGNMENT);
+    for (size_t i = 0; i < level_sizes[NUM_ROOF_LEVELS - 1] / sizeof(double); i++) {
+        ((double *)buffer)[i] = 1.0;
+    }
+
+    FILE *ceil_file = bench_csv_open("roofline_ceilings.csv");
+    fprintf(ceil_file, "Ceiling,Kernel,Working Set (bytes),Value,Unit");
+    measure_write_csv_header(ceil_file, ",");
+    fprintf(ceil_file, "\n");
+
+    // Compute ceilings
+    printf("Peak throughput (one core):\n");
+    const peak_kernel_t *pk = peak_kernels(&count);
+    for (int i = 0; i < count; i++) {
+        if (!compute_isa_supported(pk[i].isa)) {
+            continue;
+        }
+        peak_trial_t trial = {&pk[i]};
+        const char *unit = pk[i].kind == PEAK_FP64 ? "GFLOP/s" : "GOP/s";
+        measure_run(&cfg, peak_trial, &trial, &stats);
+        printf("  %-14s %8.2f %s\n", pk[i].name, stats.median, unit);
+        fprintf(ceil_file, "%s peak,%s,0,%.3f,%s", peak_kind_name(pk[i].kind), pk[i].name, stats.median, unit);
+        measure_write_csv_values(ceil_file, ",", &stats);
+        fprintf(ceil_file, "\n");
+        if (stats.median > peak[pk[i].kind]) {
+            peak[pk[i].kind] = stats.median;
+            peak_isa[pk[i].kind] = bw_isa_name(pk[i].isa);
+        }
+        if (pk[i].kind == PEAK_FP64 && pk[i].isa == BW_SCALAR) {
+            scalar_peak = stats.median;
+        }
+    }
+    printf("  FP64 ceiling %.2f GFLOP/s (%s), scalar %.2f GFLOP/s; int64 ceiling %.2f GOP/s (%s)\n\n",
+           peak[PEAK_FP64], peak_isa[PEAK_FP64], scalar_peak, peak[PEAK_INT64], peak_isa[PEAK_INT64]);
+
+    // Memory ceilings: read bandwidth of each level with the widest read kernel
+    const bw_kernel_t *read = bw_best_kernel(BW_READ, 0);
+    printf("Read bandwidth ceilings (%s):\n", read->name);
+    for (int l = 0; l < NUM_ROOF_LEVELS; l++) {
+        roof_trial_t trial = {read, NULL, buffer, level_sizes[l], ROOF_TRIAL_BYTES, 0, 1.0};
+        measure_run(&cfg, roof_trial, &trial, &stats);
+        level_bw[l] = stats.median;
+        printf("  %-6s %10zu bytes %8.2f GB/s, ridge point %.2f flop/byte\n", level_names[l], level_sizes[l],
+               level_bw[l], peak[PEAK_FP64] / level_bw[l]);
+        fprintf(ceil_file, "%s bandwidth,%s,%zu,%.3f,GB/s", level_names[l], read->name, level_sizes[l], level_bw[l]);
+        measure_write_csv_values(ceil_file, ",", &stats);
+        fprintf(ceil_file, "\n");
+    }
+    bench_csv_close(ceil_file);
+
+    // Achieved points: each intensity kernel at each level, against the roof min(peak, I x BW)
+    FILE *csv_file = bench_csv_open("roofline_points.csv");
+    fprintf(csv_file, "# FP64 ceiling %.3f GFLOP/s (%s); roof = min(ceiling, intensity x level read bandwidth)\n",
+            peak[PEAK_FP64], peak_isa[PEAK_FP64]);
+    fprintf(csv_file, "Level,Working Set (bytes),Kernel,Intensity (flop/byte),GFLOP/s,Roof (GFLOP/s),Percent of Roof,Bound");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    printf("\nAchieved GFLOP/s (percent of roof, m = memory bound, c = compute bound):\n");
+    printf("%-8s", "Level");
+    for (int i = 0; i < num_intensities; i++) {
+        printf(" %14g", 2.0 * fmas[i] / sizeof(double));
+    }
+    printf("  flop/byte\n");
+    for (int l = 0; l < NUM_ROOF_LEVELS; l++) {
+        printf("%-8s", level_names[l]);
+        for (int i = 0; i < num_intensities; i++) {
+            const roof_kernel_t *kernel = roof_find_kernel(fmas[i], isa);
+            double intensity = roof_intensity(kernel);
+            size_t trial_bytes = roof_round((size_t)(ROOF_TRIAL_FLOPS / intensity));
+            roof_trial_t trial = {NULL, kernel, buffer, level_sizes[l], trial_bytes, 0, intensity};
+            measure_run(&cfg, roof_trial, &trial, &stats);
+
+            double memory_roof = intensity * level_bw[l];
+            double roof = memory_roof < peak[PEAK_FP64] ? memory_roof : peak[PEAK_FP64];
+            const char *bound = memory_roof < peak[PEAK_FP64] ? "memory" : "compute";
+            printf(" %7.2f (%3.0f%%%c)", stats.median, 100 * stats.median / roof, bound[0]);
+            fprintf(csv_file, "%s,%zu,%s,%g,%.3f,%.3f,%.1f,%s", level_names[l], level_sizes[l], kernel->name,
+                    intensity, stats.median, roof, 100 * stats.median / roof, bound);
+            measure_write_csv_values(csv_file, ",", &stats);
+            fprintf(csv_file, "\n");
+        }
+        printf("\n");
+    }
+
+    bench_csv_close(csv_file);
+    free(buffer);
+    printf("\nCeilings have been saved to 'roofline_ceilings.csv' and points to 'roofline_points.csv'\n");
+}
+
+// Parse a comma-separated list of intensities in flops per byte into multiply-adds per
+// element of the intensity kernels. Returns how many were parsed, or -1 on one no kernel has.
+int parse_intensities(const char *list, int *fmas, int max_intensities) {
+    char buf[256];
+    int n = 0;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *save, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int k = (int)(atof(tok) * sizeof(double) / 2 + 0.5);
+        if (n == max_intensities || k < 1 || k > ROOF_MAX_FMAS || (k & (k - 1)) != 0) {
+            return -1;
+        }
+        fmas[n++] = k;
+    }
+    return n;
+}
+
+// Entry point of the computation benchmark (membench compute). "roofline" measures the
+// compute and bandwidth ceilings and the intensity kernels instead of the fixed multiply.
+// Parameters: mode, repeat (sweep); intensities, isa, mem_size plus the repetition parameters
+// of measure_config_default() (roofline).
+int compute_main(int argc, char *argv[]) {
     // Array sizes that fit within L1d, L2, L3 cache, and exceed L3 cache for memory access
-    int cache_levels[] = {L1D_CACHE_SIZE, L2_CACHE_SIZE, L3_CACHE_SIZE, L3_CACHE_SIZE * 2}; 
+    const topology_t *topo = get_topology();
+    size_t cache_levels[] = {topo->l1d_size, topo->l2_size, topo->l3_size, topo->l3_size * 2};
     const char *cache_names[] = {"L1d Cache", "L2 Cache", "L3 Cache", "Main Memory"};
     int num_levels = sizeof(cache_levels) / sizeof(cache_levels[0]);
+    int repeat = (int)bench_param_long("repeat", REPEAT);
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "sweep");
 
-    // Variables to store latency and CPU cycles
-    double latency, cpu_cycles;
+    if (strcmp(mode, "roofline") == 0) {
+        const char *isa_name = bench_param_str("isa", "auto");
+        size_t mem_size = bench_param_size("mem_size", topo->l3_size * 2);
+        int fmas[MAX_INTENSITIES];
+        int num_intensities = parse_intensities(bench_param_str("intensities", ROOF_DEFAULT_INTENSITIES), fmas,
+                                                MAX_INTENSITIES);
+        bw_isa_t isa = BW_NUM_ISAS;
+        for (int i = 0; i < BW_NUM_ISAS; i++) {
+            if (strcmp(isa_name, bw_isa_name((bw_isa_t)i)) == 0) {
+                isa = (bw_isa_t)i;
+            }
+        }
+        if (num_intensities <= 0 || (isa == BW_NUM_ISAS && strcmp(isa_name, "auto") != 0) ||
+            (isa != BW_NUM_ISAS && !compute_isa_supported(isa)) || mem_size <= topo->l3_size) {
+            fprintf(stderr, "Usage: %s roofline [intensities=0.25,...,64 (powers of two)] "
+                    "[isa=auto|scalar|sse|avx2|avx512] [mem_size=N]\n", argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_roofline(fmas, num_intensities, isa, mem_size);
+        return 0;
+    }
+    if (strcmp(mode, "sweep") != 0 || repeat <= 0) {
+        fprintf(stderr, "Usage: %s [sweep|roofline] [repeat=N]\n", argv[0]);
+        return 1;
+    }
+
+    // Variables to store latency and TSC/core cycles
+    double latency;
+    tsc_sample_t cycles;
+    tsc_cycles_t pass_cycles;
+    perf_sample_t counters;
+
+    topology_write_header(stdout, topo);
+
+    FILE *csv_file = bench_csv_open("compute_latency.csv");
+    fprintf(csv_file, "# Latency and cycles are per pass; counters are totals over the %d timed passes\n", repeat);
+    fprintf(csv_file, "Cache Level, Total Size (bytes), Latency (seconds)");
+    tsc_write_csv_header(csv_file, ", ");
+    perf_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
 
     // Loop over each cache level and measure performance
     for (int i = 0; i < num_levels; i++) {
-        int num_elements = cache_levels[i] / sizeof(int);  // Number of elements in the array
+        size_t num_elements = cache_levels[i] / sizeof(int);  // Number of elements in the array
 
         printf("Testing %s:\n", cache_names[i]);
-        compute_with_size(cache_levels[i], num_elements, &latency, &cpu_cycles);
-        printf("%s: Size = %d bytes, Average Latency = %.9f seconds, CPU Cycles = %.0f\n\n",
-               cache_names[i], cache_levels[i], latency / REPEAT, cpu_cycles / REPEAT);
+        compute_with_size(cache_levels[i], num_elements, repeat, &latency, &cycles, &counters);
+        tsc_cycles_per_op(&cycles, repeat, &pass_cycles);
+        printf("%s: Size = %zu bytes, Average Latency = %.9f seconds, ", cache_names[i], cache_levels[i], latency / repeat);
+        tsc_print_cycles(stdout, &pass_cycles);
+        printf("\n");
+        perf_print_per_op(stdout, &counters, (double)num_elements * repeat, "element");
+        printf("\n");
+
+        fprintf(csv_file, "%s, %zu, %.9f", cache_names[i], cache_levels[i], latency / repeat);
+        tsc_write_csv_values(csv_file, ", ", &pass_cycles);
+        perf_write_csv_values(csv_file, ", ", &counters);
+        fprintf(csv_file, "\n");
     }
 
+    bench_csv_close(csv_file);
+    printf("Data has been saved to compute_latency.csv\n");
     return 0;
 }
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "compute");
+    return compute_main(argc, argv);
+}
+#endif
@@ -1,86 +1,336 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "perf_counters.h"
+#include "tsc.h"
+#include "page_alloc.h"
+#include "measure.h"
+#include "affinity.h"
+#include "thread_pool.h"
 
-#define L1D_CACHE_SIZE (48 * 1024)  // 48 KiB per core for L1 data cache
-#define L2_CACHE_SIZE (1.25 * 1024 * 1024)  // 1.25 MiB per core for L2 cache
-#define L3_CACHE_SIZE (24 * 1024 * 1024)  // 24 MiB shared L3 cache
-#define PAGE_SIZE_4KB (4 * 1024)  // 4KB page size
-#define PAGE_SIZE_2MB (2 * 1024 * 1024)  // 2MB page size
 #define MULTIPLICATION_CONSTANT 3  // Lightweight multiplication constant
 #define REPEAT 1000  // Repeat the operation to get average values
+#define FAULT_SIZE (256UL * 1024 * 1024)  // Default bytes populated per fault measurement
+#define FAULT_TRIALS 5  // Default cap on repeated trials per strategy and thread count
+#define BASE_PAGE 4096  // Touch stride: every base page, whatever backing the kernel chose
 
-// Function to get the current CPU cycle count
-static inline uint64_t rdtsc() {
-    unsigned int lo, hi;
-    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-    return ((uint64_t)hi << 32) | lo;
-}
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23  // Linux 5.14+
+#endif
+
+// Ways of populating a fresh mapping
+typedef enum {
+    POP_TOUCH,              // One store per page, each taking a page fault
+    POP_MEMSET,             // Zero the whole buffer
+    POP_MAP_POPULATE,       // MAP_POPULATE on the mmap itself (one thread)
+    POP_WILLNEED,           // MADV_WILLNEED, then one store per page
+    POP_POPULATE_WRITE,     // MADV_POPULATE_WRITE over each thread's slice
+    POP_NUM
+} populate_t;
+
+static const char *populate_names[POP_NUM] = {"first-touch", "memset", "MAP_POPULATE", "MADV_WILLNEED+touch",
+                                              "MADV_POPULATE_WRITE"};
 
-// Function to perform computation and measure latency and CPU cycles with varying page sizes
-void compute_with_page_size(int page_size, int total_size, int num_pages, double *latency, double *cpu_cycles) {
+// Function to perform computation and measure latency, TSC and core cycles over a buffer with the
+// given page backing, along with the hardware counters over the same region. Returns 0 and
+// fills in the backing the kernel actually provided.
+int compute_with_page_backing(page_backing_t backing, size_t total_size, int repeat, page_buffer_t *buf,
+                              page_backing_info_t *info, double *latency, tsc_sample_t *cycles,
+                              perf_sample_t *counters) {
+    perf_counters_t *pc = get_perf_counters();
     struct timespec start, end;
-    int **pages = (int **)malloc(num_pages * sizeof(int *));
-    uint64_t cycles_start, cycles_end;
-
-    // Allocate memory in chunks of 'page_size' to simulate memory accesses across multiple pages
-    for (int i = 0; i < num_pages; i++) {
-        pages[i] = (int *)malloc(page_size);
-        for (int j = 0; j < page_size / sizeof(int); j++) {
-            pages[i][j] = i + j;
-        }
+    tsc_region_t region;
+    size_t num_elements = total_size / sizeof(int);
+
+    if (page_alloc(buf, total_size, backing) != 0) {
+        return -1;
+    }
+    int *array = (int *)buf->addr;
+
+    // Touch every page before timing so the kernel has picked the real backing
+    for (size_t i = 0; i < num_elements; i++) {
+        array[i] = (int)i;
     }
+    page_backing_verify(buf, info);
 
-    // Start measuring time and CPU cycles
+    // Start measuring time, cycles and hardware counters
+    perf_counters_start(pc);
     clock_gettime(CLOCK_MONOTONIC, &start);
-    cycles_start = rdtsc();
+    tsc_region_start(&region);
 
-    // Perform multiplication across all pages
-    for (int r = 0; r < REPEAT; r++) {
-        for (int i = 0; i < num_pages; i++) {
-            for (int j = 0; j < page_size / sizeof(int); j++) {
-                pages[i][j] *= MULTIPLICATION_CONSTANT;
-            }
+    // Perform multiplication across the whole buffer
+    for (int r = 0; r < repeat; r++) {
+        for (size_t i = 0; i < num_elements; i++) {
+            array[i] *= MULTIPLICATION_CONSTANT;
         }
     }
 
-    // Stop measuring time and CPU cycles
-    cycles_end = rdtsc();
+    // Stop measuring time, cycles and hardware counters
+    tsc_region_stop(&region, cycles);
     clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, counters);
 
-    // Calculate elapsed time in seconds and CPU cycles
+    // Calculate elapsed time in seconds
     *latency = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-    *cpu_cycles = (double)(cycles_end - cycles_start);
 
-    // Free memory
-    for (int i = 0; i < num_pages; i++) {
-        free(pages[i]);
+    page_free(buf);
+    return 0;
+}
+
+// State of one repeated populate measurement; every trial maps a fresh buffer
+typedef struct {
+    page_backing_t backing;
+    populate_t how;
+    size_t size;
+    thread_pool_t *pool;
+    int threads;
+    page_buffer_t buf;
+    long faults;                      // Minor faults taken in the last trial
+    page_backing_info_t info;         // Backing of the last trial's buffer
+    int failed;                       // The backing or the madvise() is unavailable
+} fault_trial_t;
+
+// Populate this worker's share of the buffer's base pages
+static void populate_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    fault_trial_t *t = arg;
+    size_t pages = t->size / BASE_PAGE;
+    size_t first = pages * thread_id / num_threads, last = pages * (thread_id + 1) / num_threads;
+    char *base = (char *)t->buf.addr + first * BASE_PAGE;
+    size_t len = (last - first) * BASE_PAGE;
+
+    slot->value = 0;
+    switch (t->how) {
+        case POP_MEMSET:
+            memset(base, 0, len);
+            break;
+        case POP_POPULATE_WRITE:
+            if (len && madvise(base, len, MADV_POPULATE_WRITE) != 0) {
+                slot->value = -1;
+            }
+            break;
+        case POP_WILLNEED:
+            madvise(base, len, MADV_WILLNEED);  // Only reads ahead swap and files; kept to show it
+            /* fall through */
+        default:
+            for (size_t off = 0; off < len; off += BASE_PAGE) {
+                ((volatile char *)base)[off] = 1;
+            }
+            break;
     }
-    free(pages);
+    slot->ops = last - first;
 }
 
-int main() {
-    // Total data size to simulate accesses across different cache levels
-    int total_size = L3_CACHE_SIZE * 2;  // Exceeding L3 cache size to force main memory access
+static long minor_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);  // Summed over all threads
+    return usage.ru_minflt;
+}
 
-    // Define page sizes to simulate TLB miss impacts (4KB and 2MB pages)
-    int page_sizes[] = {PAGE_SIZE_4KB, PAGE_SIZE_2MB};
-    const char *page_size_names[] = {"4KB Pages", "2MB Pages"};
-    int num_page_sizes = sizeof(page_sizes) / sizeof(page_sizes[0]);
+// Function to map a fresh buffer, time populating it and unmap it, returning GB/s
+static double fault_trial(void *arg) {
+    fault_trial_t *t = arg;
+    struct timespec start, end;
+    double ns;
+    long faults;
 
-    // Variables to store latency and CPU cycles
-    double latency, cpu_cycles;
+    if (t->failed) {
+        return 0;
+    }
+    if (t->how == POP_MAP_POPULATE) {
+        faults = minor_faults();
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int rc = page_map(&t->buf, t->size, t->backing, MAP_POPULATE);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (rc != 0) {
+            t->failed = 1;
+            return 0;
+        }
+        ns = measure_elapsed_ns(&start, &end);
+    } else {
+        if (page_map(&t->buf, t->size, t->backing, 0) != 0) {
+            t->failed = 1;
+            return 0;
+        }
+        faults = minor_faults();
+        ns = pool_run(t->pool, t->threads, populate_task, t);
+        for (int i = 0; i < t->threads; i++) {
+            if (pool_slot(t->pool, i)->value < 0) {
+                t->failed = 1;
+            }
+        }
+    }
+    t->faults = minor_faults() - faults;
+    page_backing_verify(&t->buf, &t->info);
+    page_free(&t->buf);
+    return (double)t->size / ns;
+}
+
+// Function to measure the cost of populating fresh memory for each backing, populate
+// strategy and thread count: throughput, minor faults and the time each thread spends per fault
+void run_fault_benchmark(size_t size, int max_threads) {
+    const char *placement = bench_param_str("placement", "allowed");
+    int cpus[POOL_MAX_THREADS];
+    int num_cpus = get_placement_cpus(placement, cpus, POOL_MAX_THREADS);
+    if (num_cpus <= 0) {
+        exit(EXIT_FAILURE);
+    }
+    thread_pool_t *pool = pool_create(max_threads, cpus, num_cpus);
+    measure_stats_t stats;
+    measure_config_t cfg;
 
-    // Loop over each page size to simulate different TLB miss ratios
-    for (int p = 0; p < num_page_sizes; p++) {
-        int num_pages = total_size / page_sizes[p];  // Calculate the number of pages for each size
+    measure_config_default(&cfg, FAULT_TRIALS);
+    FILE *csv_file = bench_csv_open("page_faults.csv");
+    fprintf(csv_file, "# %zu bytes per trial (hugetlb rounds up to whole pages), freshly mapped; ns per fault is per"
+            " thread (elapsed x threads / faults)\n", size);
+    placement_write_header(csv_file, placement, cpus, num_cpus < max_threads ? num_cpus : max_threads);
+    fprintf(csv_file, "Backing, Bytes, Strategy, Threads, Faults, Huge-Page Backed (%%), GB/s, ns per Fault");
+    measure_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
 
-        printf("Testing with %s:\n", page_size_names[p]);
-        compute_with_page_size(page_sizes[p], total_size, num_pages, &latency, &cpu_cycles);
-        printf("%s: Total Size = %d bytes, Pages = %d, Average Latency = %.9f seconds, CPU Cycles = %.0f\n\n",
-               page_size_names[p], total_size, num_pages, latency / REPEAT, cpu_cycles / REPEAT);
+    for (int b = 0; b < BACKING_NUM; b++) {
+        page_buffer_t probe;
+
+        printf("%s:\n", page_backing_name((page_backing_t)b));
+        if (page_map(&probe, size, (page_backing_t)b, 0) != 0) {
+            printf("  unavailable (no pages reserved or not supported)\n\n");
+            continue;
+        }
+        // hugetlb maps, faults in and zeroes whole pages, so the throughput is over all of them
+        size_t trial_size = b == BACKING_HUGETLB_2M || b == BACKING_HUGETLB_1G ? probe.map_size : size;
+        page_free(&probe);
+        if (trial_size != size) {
+            printf("  %zu MB per trial, rounded up to whole pages\n", trial_size >> 20);
+        }
+        printf("  %-22s %7s %10s %7s %10s %12s\n", "Strategy", "Threads", "Faults", "Huge %", "GB/s", "ns/Fault");
+        for (int how = 0; how < POP_NUM; how++) {
+            for (int threads = 1; threads <= max_threads; threads = threads * 2 > max_threads && threads < max_threads
+                                                                    ? max_threads : threads * 2) {
+                fault_trial_t trial = {(page_backing_t)b, (populate_t)how, trial_size, pool, threads};
+                if (how == POP_MAP_POPULATE && threads > 1) {
+                    break;
+                }
+                measure_run(&cfg, fault_trial, &trial, &stats);
+                if (trial.failed) {
+                    printf("  %-22s unavailable\n", populate_names[how]);
+                    break;
+                }
+
+                double huge_percent = trial.info.rss_bytes ? 100.0 * trial.info.huge_bytes / trial.info.rss_bytes : 0.0;
+                double ns_per_fault = trial.faults > 0 ? trial_size / stats.median * threads / trial.faults : 0;
+                printf("  %-22s %7d %10ld %6.1f%% %10.2f %12.1f\n", populate_names[how], threads, trial.faults,
+                       huge_percent, stats.median, ns_per_fault);
+                fprintf(csv_file, "%s, %zu, %s, %d, %ld, %.1f, %.3f, %.1f", page_backing_name((page_backing_t)b),
+                        trial_size, populate_names[how], threads, trial.faults, huge_percent, stats.median, ns_per_fault);
+                measure_write_csv_values(csv_file, ", ", &stats);
+                fprintf(csv_file, "\n");
+            }
+        }
+        printf("\n");
+    }
+
+    bench_csv_close(csv_file);
+    pool_destroy(pool);
+    printf("Fault data has been saved to page_faults.csv\n");
+}
+
+// Entry point of the page-backing benchmark (membench page-backing). "faults" measures the
+// cost of populating fresh memory instead of computing over it.
+// Parameters: mode, size, repeat (latency); fault_size, threads, placement plus the
+// repetition parameters of measure_config_default() (faults).
+int page_backing_main(int argc, char *argv[]) {
+    // Total data size to simulate accesses across different cache levels; the default
+    // exceeds the L3 cache size to force main memory access
+    const topology_t *topo = get_topology();
+    size_t total_size = bench_param_size("size", topo->l3_size * 2);
+    int repeat = (int)bench_param_long("repeat", REPEAT);
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "latency");
+
+    if (strcmp(mode, "faults") == 0) {
+        int cpus[POOL_MAX_THREADS];
+        size_t fault_size = bench_param_size("fault_size", FAULT_SIZE);
+        int max_threads = argc > 2 ? atoi(argv[2])
+                                   : (int)bench_param_long("threads", get_allowed_cpus(cpus, POOL_MAX_THREADS));
+        if (fault_size < BASE_PAGE || max_threads <= 0 || max_threads > POOL_MAX_THREADS) {
+            fprintf(stderr, "Usage: %s faults [max threads] [fault_size=BYTES]\n", argv[0]);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_fault_benchmark(fault_size / BASE_PAGE * BASE_PAGE, max_threads);
+        return 0;
+    }
+    if (strcmp(mode, "latency") != 0 || total_size < sizeof(int) || repeat <= 0) {
+        fprintf(stderr, "Usage: %s [latency|faults [max threads]] [size=BYTES] [repeat=N]\n", argv[0]);
+        return 1;
     }
 
+    // Variables to store latency and TSC/core cycles
+    double latency;
+    tsc_sample_t cycles;
+    tsc_cycles_t pass_cycles;
+    perf_sample_t counters;
+    int measured[BACKING_NUM] = {0};
+
+    topology_write_header(stdout, topo);
+
+    FILE *csv_file = bench_csv_open("page_backing_latency.csv");
+    fprintf(csv_file, "# Latency and cycles are per pass; counters are totals over the %d timed passes\n", repeat);
+    fprintf(csv_file, "Requested Backing, Backing, Total Size (bytes), Kernel Page Size (bytes), Huge-Page Backed (%%), "
+                      "Latency (seconds)");
+    tsc_write_csv_header(csv_file, ", ");
+    perf_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
+
+    // Loop over each page backing to simulate different TLB miss ratios
+    for (int b = 0; b < BACKING_NUM; b++) {
+        page_buffer_t buf;
+        page_backing_info_t info;
+
+        printf("Testing with %s:\n", page_backing_name((page_backing_t)b));
+        if (compute_with_page_backing((page_backing_t)b, total_size, repeat, &buf, &info, &latency, &cycles, &counters) != 0) {
+            printf("Memory allocation failed\n\n");
+            continue;
+        }
+
+        // Say so when the backend was unavailable or the kernel did not honour it
+        if (buf.backing != buf.requested) {
+            printf("%s unavailable, fell back to %s\n", page_backing_name(buf.requested), page_backing_name(buf.backing));
+        }
+        if (buf.backing == BACKING_THP && info.huge_bytes == 0) {
+            printf("THP requested but no huge pages were provided (check /sys/kernel/mm/transparent_hugepage)\n");
+        }
+        double huge_percent = info.rss_bytes ? 100.0 * info.huge_bytes / info.rss_bytes : 0.0;
+        tsc_cycles_per_op(&cycles, repeat, &pass_cycles);
+        printf("%s: Total Size = %zu bytes, Kernel Page Size = %zu KB, Huge-Page Backed = %.1f%%, "
+               "Average Latency = %.9f seconds, ",
+               page_backing_name(buf.backing), total_size, info.kernel_page_size / 1024, huge_percent, latency / repeat);
+        tsc_print_cycles(stdout, &pass_cycles);
+        printf("%s\n", measured[buf.backing] ? " (repeat of an earlier backing)" : "");
+        perf_print_per_op(stdout, &counters, (double)(total_size / sizeof(int)) * repeat, "element");
+        printf("\n");
+        measured[buf.backing] = 1;
+
+        fprintf(csv_file, "%s, %s, %zu, %zu, %.1f, %.9f", page_backing_name(buf.requested),
+                page_backing_name(buf.backing), total_size, info.kernel_page_size, huge_percent, latency / repeat);
+        tsc_write_csv_values(csv_file, ", ", &pass_cycles);
+        perf_write_csv_values(csv_file, ", ", &counters);
+        fprintf(csv_file, "\n");
+    }
+
+    bench_csv_close(csv_file);
+    printf("Data has been saved to page_backing_latency.csv\n");
     return 0;
 }
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "page-backing");
+    return page_backing_main(argc, argv);
+}
+#endif
@@ -1,93 +1,251 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 
-#define L1D_CACHE_SIZE (48 * 1024)  // 48 KiB per instance for L1 data cache
-#define L2_CACHE_SIZE (1.25 * 1024 * 1024)  // 1.25 MiB per instance for L2 cache
-#define L3_CACHE_SIZE (24 * 1024 * 1024)  // 24 MiB shared L3 cache
-#define PAGE_SIZE_4KB (4 * 1024)  // 4KB page size
-#define PAGE_SIZE_2MB (2 * 1024 * 1024)  // 2MB page size
-#define MULTIPLICATION_CONSTANT 3  // Lightweight multiplication constant
-#define REPEAT 5  // Number of times to repeat the operation
-
-// Function to get the current CPU cycle count
-static inline uint64_t rdtsc() {
-    unsigned int lo, hi;
-    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-    return ((uint64_t)hi << 32) | lo;
-}
-
-// Function to perform computation with memory accesses that generate TLB misses
-void compute_with_tlb_pressure(int page_size, int num_pages, double *latency) {
+#include "bench.h"
+#include "topology.h"
+#include "page_alloc.h"
+#include "pointer_chase.h"
+#include "perf_counters.h"
+#include "measure.h"
+#include "tsc.h"
+
+#define TLB_HOPS 500000             // Dependent loads timed per trial at each point
+#define TLB_TRIALS 10               // Default cap on repeated trials per point
+#define TLB_MIN_PAGES 4             // Smallest number of pages in the sweep
+#define TLB_POINTS_PER_OCTAVE 8     // Page counts per doubling
+#define TLB_ARENA_MB 1024           // Default arena size per page backing (1GB)
+#define SIZE_2MB (2UL * 1024 * 1024)
+#define SIZE_1GB (1024UL * 1024 * 1024)
+
+// State of one repeated TLB-point measurement
+typedef struct {
+    void **p;                   // Current position in the page chain
+    long hops;                  // Dependent loads per trial
+    double ns;                  // Elapsed ns summed over the trials
+    tsc_sample_t tsc;           // TSC ticks and core cycles summed over the trials
+    perf_sample_t counters;     // Counters over the last trial
+} tlb_trial_t;
+
+// Function to time one pass of 'hops' dependent loads through the page chain, returning ns per hop
+static double tlb_trial(void *arg) {
+    tlb_trial_t *t = arg;
+    perf_counters_t *pc = get_perf_counters();
     struct timespec start, end;
-    int **pages = (int **)malloc(num_pages * sizeof(int *));
-    uint64_t cycles_start, cycles_end;
-
-    // Allocate memory in page-sized chunks to simulate memory access across multiple pages
-    for (int i = 0; i < num_pages; i++) {
-        pages[i] = (int *)malloc(page_size);
-        for (int j = 0; j < page_size / sizeof(int); j++) {
-            pages[i][j] = i + j;  // Initialize memory
-        }
-    }
+    tsc_region_t region;
+    tsc_sample_t tsc;
 
-    // Start measuring time
+    perf_counters_start(pc);
     clock_gettime(CLOCK_MONOTONIC, &start);
+    tsc_region_start(&region);
+    t->p = chase_pointers(t->p, t->hops);  // Storing p keeps the chase live
+    tsc_region_stop(&region, &tsc);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_counters_stop(pc, &t->counters);
 
-    // Perform lightweight multiplication across pages
-    for (int r = 0; r < REPEAT; r++) {
-        for (int i = 0; i < num_pages; i++) {
-            for (int j = 0; j < page_size / sizeof(int); j++) {
-                pages[i][j] *= MULTIPLICATION_CONSTANT;
-            }
+    double ns = measure_elapsed_ns(&start, &end);
+    t->ns += ns;
+    tsc_accumulate(&t->tsc, &tsc);
+    return ns / t->hops;
+}
+
+// Function to measure the latency of one dependent load per page over 'num_pages' pages
+// of the arena, visited in shuffled order at a random line inside each page. Returns the
+// median ns per hop over repeated trials (the warmup trials leave the translations as warm
+// as they can get), with TSC and core cycles scaled to the median and the counters of the
+// last trial.
+double measure_tlb_point(void *arena, size_t num_pages, size_t page_size, long hops, measure_stats_t *stats,
+                         tsc_cycles_t *cycles, perf_sample_t *counters) {
+    tlb_trial_t trial = {build_page_chain(arena, num_pages, page_size, get_topology()->line_size), hops};
+    measure_config_t cfg;
+
+    measure_config_default(&cfg, TLB_TRIALS);
+    measure_run(&cfg, tlb_trial, &trial, stats);
+
+    tsc_cycles_at_ns(&trial.tsc, trial.ns > 0 ? stats->median * trial.tsc.ns / trial.ns : 0, cycles);
+    *counters = trial.counters;
+    return stats->median;
+}
+
+// Which translation structure should cover 'num_pages' pages, from the advertised TLB sizes
+const char *tlb_region(const topology_t *topo, size_t page_size, size_t num_pages) {
+    for (int i = 0; i < topo->num_tlbs; i++) {
+        const tlb_info_t *t = &topo->tlbs[i];
+        if (t->page_size != page_size || t->l1_entries == 0) {
+            continue;
+        }
+        if (num_pages <= (size_t)t->l1_entries) {
+            return "L1 dTLB";
+        }
+        if (num_pages <= (size_t)(t->l2_entries > t->l1_entries ? t->l2_entries : t->l1_entries)) {
+            return "STLB";
         }
+        return "page walk";
     }
+    return "unknown";
+}
 
-    // Stop measuring time
-    clock_gettime(CLOCK_MONOTONIC, &end);
+// Print one counter per timed hop as a table column, or "-" if it was not measured
+static void print_per_hop(const perf_sample_t *counters, perf_counter_id_t id, long hops, int width) {
+    if (counters->valid[id]) {
+        printf("%*.3f  |  ", width, (double)counters->value[id] / hops);
+    } else {
+        printf("%*s  |  ", width, "-");
+    }
+}
 
-    // Calculate elapsed time in seconds
-    *latency = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+// Compare doubles for qsort
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
 
-    // Free allocated memory
-    for (int i = 0; i < num_pages; i++) {
-        free(pages[i]);
+// Function to sweep the number of pages touched for one page backing and report the
+// latency of each TLB region
+void run_tlb_sweep(page_backing_t backing, size_t arena_size, long hops, FILE *csv_file, int *measured) {
+    const topology_t *topo = get_topology();
+    const char *regions[] = {"L1 dTLB", "STLB", "page walk"};
+    page_buffer_t buf;
+    page_backing_info_t info;
+
+    if (page_alloc(&buf, arena_size, backing) != 0) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(buf.addr, 1, arena_size);  // Fault everything in before checking the backing
+    page_backing_verify(&buf, &info);
+
+    // Stride by the page size the kernel actually used
+    size_t page_size = topo->page_sizes[0];
+    if (buf.backing == BACKING_HUGETLB_1G) {
+        page_size = SIZE_1GB;
+    } else if (buf.backing == BACKING_HUGETLB_2M || (buf.backing == BACKING_THP && info.huge_bytes * 2 > info.rss_bytes)) {
+        page_size = SIZE_2MB;
     }
-    free(pages);
-}
 
-int main() {
-    // Define the page size to use for testing (4KB and 2MB pages)
-    int page_size = PAGE_SIZE_4KB;  // Focus on 4KB pages for this example
+    printf("\nTesting with %s", page_backing_name(backing));
+    if (buf.backing != backing) {
+        printf(" (unavailable, got %s)", page_backing_name(buf.backing));
+    }
+    printf(", %zu KB stride:\n", page_size / 1024);
+
+    size_t max_pages = arena_size / page_size;
+    int key = page_size == SIZE_1GB ? 2 : page_size == SIZE_2MB ? 1 : 0;
+    if (measured[key] || max_pages < TLB_MIN_PAGES) {
+        printf("Skipped: %s\n", measured[key] ? "same page size already measured" : "arena holds too few pages");
+        page_free(&buf);
+        return;
+    }
+    measured[key] = 1;
 
-    // Variables to store latency
-    double latency;
+    printf("Pages     |  Latency (ns)  |  Core Cycles  |  dTLB Misses/Hop  |  Walks/Hop  |  Region\n");
+    printf("-----------------------------------------------------------------------------------\n");
 
-    // Total number of pages to test increasing TLB miss ratios
-    int max_pages = 100000;  // Adjust as needed to ensure enough TLB misses
-    int step_size = 500;  // Step size for increasing TLB pressure
+    int max_points = (int)(log2((double)max_pages / TLB_MIN_PAGES) * TLB_POINTS_PER_OCTAVE) + 2;
+    double region_latency[3][max_points];
+    int region_count[3] = {0, 0, 0};
+    size_t last = 0;
 
-    // Open a CSV file to write the data
-    FILE *csv_file = fopen("tlb_miss_vs_latency.csv", "w");
-    if (csv_file == NULL) {
-        perror("Error opening file");
-        return 1;
+    for (int k = 0; k < max_points; k++) {
+        size_t num_pages = (size_t)(TLB_MIN_PAGES * pow(2.0, (double)k / TLB_POINTS_PER_OCTAVE));
+        if (num_pages > max_pages) {
+            break;
+        }
+        if (num_pages == last) {
+            continue;
+        }
+        last = num_pages;
+
+        tsc_cycles_t cycles;
+        perf_sample_t counters;
+        measure_stats_t stats;
+        double latency = measure_tlb_point(buf.addr, num_pages, page_size, hops, &stats, &cycles, &counters);
+        const char *region = tlb_region(topo, page_size, num_pages);
+
+        printf("%8zu  |  %12.3f  |  ", num_pages, latency);
+        if (cycles.core_valid) {
+            printf("%11.1f  |  ", cycles.core);
+        } else {
+            printf("%11s  |  ", "-");
+        }
+        print_per_hop(&counters, PC_DTLB_LOAD_MISSES, hops, 15);
+        print_per_hop(&counters, PC_PAGE_WALKS, hops, 9);
+        printf("%s%s\n", region, stats.unstable ? " (unstable)" : "");
+        fprintf(csv_file, "%zu, %zu, %.3f", page_size, num_pages, latency);
+        tsc_write_csv_values(csv_file, ", ", &cycles);
+        fprintf(csv_file, ", %s", region);
+        measure_write_csv_values(csv_file, ", ", &stats);
+        perf_write_csv_values(csv_file, ", ", &counters);
+        fprintf(csv_file, "\n");
+
+        for (int r = 0; r < 3; r++) {
+            if (strcmp(region, regions[r]) == 0) {
+                region_latency[r][region_count[r]++] = latency;
+            }
+        }
     }
 
-    // Write CSV header
-    fprintf(csv_file, "Number of Pages, Latency (seconds)\n");
+    // Median latency of each region and the cost of stepping from one to the next
+    double prev = 0;
+    for (int r = 0; r < 3; r++) {
+        if (region_count[r] == 0) {
+            continue;
+        }
+        qsort(region_latency[r], region_count[r], sizeof(double), compare_double);
+        double median = region_latency[r][region_count[r] / 2];
+        printf("%-9s: median %.3f ns", regions[r], median);
+        if (prev > 0) {
+            printf(" (+%.3f ns per access over the previous level)", median - prev);
+        }
+        printf("\n");
+        prev = median;
+    }
+
+    page_free(&buf);
+}
 
-    // Loop over increasing numbers of pages to simulate increasing TLB misses
-    for (int num_pages = step_size; num_pages <= max_pages; num_pages += step_size) {
-        compute_with_tlb_pressure(page_size, num_pages, &latency);
-        // Write number of pages and latency to the CSV file
-        fprintf(csv_file, "%d, %.9f\n", num_pages, latency);
+// Entry point of the TLB reach sweep (membench tlb). Parameters: arena_size, hops, plus the
+// repetition parameters of measure_config_default().
+int tlb_main(int argc, char *argv[]) {
+    // Arena size per page backing, in MB on the command line
+    size_t arena_size = argc > 1 ? strtoull(argv[1], NULL, 10) * 1024 * 1024
+                                 : bench_param_size("arena_size", (size_t)TLB_ARENA_MB * 1024 * 1024);
+    long hops = bench_param_long("hops", TLB_HOPS);
+    if (arena_size == 0 || hops <= 0) {
+        fprintf(stderr, "Usage: %s [arena MB]\n", argv[0]);
+        return 1;
+    }
+    int measured[3] = {0, 0, 0};
+
+    // Open a CSV file to write the data, starting with the host topology
+    FILE *csv_file = bench_csv_open("tlb_miss_vs_latency.csv");
+    topology_write_header(stdout, get_topology());
+    fprintf(csv_file, "# Latency is the median over trials of %ld hops; counters are totals over the last trial\n", hops);
+    fprintf(csv_file, "Page Size (bytes), Number of Pages, Latency (ns)");
+    tsc_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, ", TLB Region");
+    measure_write_csv_header(csv_file, ", ");
+    perf_write_csv_header(csv_file, ", ");
+    fprintf(csv_file, "\n");
+
+    // One sweep per page backing; backends that fall back to an already measured page size are skipped
+    for (int b = 0; b < BACKING_NUM; b++) {
+        run_tlb_sweep((page_backing_t)b, arena_size, hops, csv_file, measured);
     }
 
     // Close the CSV file
-    fclose(csv_file);
+    bench_csv_close(csv_file);
 
-    printf("Data has been saved to tlb_miss_vs_latency.csv\n");
+    printf("\nData has been saved to tlb_miss_vs_latency.csv\n");
     return 0;
 }
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "tlb");
+    return tlb_main(argc, argv);
+}
+#endif
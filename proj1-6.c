@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "affinity.h"
+#include "thread_pool.h"
+#include "measure.h"
+#include "tsc.h"
+
+#define MAX_CPUS 256                  // Upper bound on CPUs in the matrix
+#define ROUND_TRIPS 2000              // Handshakes timed per trial
+#define PAIR_TRIALS 20                // Default cap on trials per CPU pair
+#define FS_UPDATES 1000000            // Counter updates per thread per false-sharing trial
+#define FS_TRIALS 20                  // Default cap on trials per false-sharing point
+#define PAD_BYTES 128                 // Padded counters sit two lines apart, clear of the adjacent-line prefetcher
+
+// The ping-pong line, with the stop flag on a line of its own so polling it adds no traffic
+typedef struct {
+    volatile uint64_t flag __attribute__((aligned(PAD_BYTES)));
+    volatile int stop __attribute__((aligned(PAD_BYTES)));
+} pingpong_line_t;
+
+// How the two threads hand the line back and forth
+typedef enum {
+    HANDSHAKE_STORE,                  // Plain store, then spin on a load until the reply arrives
+    HANDSHAKE_CAS                     // Locked compare-and-swap, then spin on a load
+} handshake_t;
+
+// One side of a ping-pong pair
+typedef struct {
+    pingpong_line_t *line;
+    handshake_t method;
+    int cpu;
+    long round_trips;                 // Handshakes per trial (initiator only)
+    uint64_t next;                    // Next odd value the initiator writes
+    const measure_config_t *cfg;
+    measure_stats_t stats;            // One-way latency in ns (initiator only)
+} pingpong_t;
+
+// Thread function for the responder: wait for each odd value and answer with the next even one
+static void *pong_thread(void *arg) {
+    pingpong_t *pp = (pingpong_t *)arg;
+    pingpong_line_t *line = pp->line;
+    uint64_t expect = 1;
+
+    pin_thread(pp->cpu);
+    while (1) {
+        while (line->flag != expect) {
+            if (line->stop) {
+                return NULL;
+            }
+        }
+        if (pp->method == HANDSHAKE_CAS) {
+            __sync_bool_compare_and_swap(&line->flag, expect, expect + 1);
+        } else {
+            line->flag = expect + 1;
+        }
+        expect += 2;
+    }
+}
+
+// Function to time 'round_trips' handshakes, returning the one-way transfer latency in ns
+static double ping_trial(void *arg) {
+    pingpong_t *pp = (pingpong_t *)arg;
+    pingpong_line_t *line = pp->line;
+    uint64_t v = pp->next;
+    tsc_region_t region;
+    tsc_sample_t sample;
+
+    tsc_region_start(&region);
+    for (long i = 0; i < pp->round_trips; i++) {
+        if (pp->method == HANDSHAKE_CAS) {
+            __sync_bool_compare_and_swap(&line->flag, v - 1, v);
+        } else {
+            line->flag = v;
+        }
+        while (line->flag != v + 1) {
+        }
+        v += 2;
+    }
+    tsc_region_stop(&region, &sample);
+
+    pp->next = v;
+    return sample.ns / (2.0 * pp->round_trips);  // Each round trip moves the line twice
+}
+
+// Thread function for the initiator: repeat trials until the latency converges, then stop the responder
+static void *ping_thread(void *arg) {
+    pingpong_t *pp = (pingpong_t *)arg;
+
+    pin_thread(pp->cpu);
+    measure_run(pp->cfg, ping_trial, pp, &pp->stats);
+    pp->line->stop = 1;
+    return NULL;
+}
+
+// Function to measure the one-way cache-line transfer latency from CPU 'from' to CPU 'to'
+void measure_pair(int from, int to, handshake_t method, long round_trips, const measure_config_t *cfg,
+                  measure_stats_t *stats) {
+    pingpong_line_t *line = (pingpong_line_t *) bench_alloc(sizeof(pingpong_line_t), PAD_BYTES);
+    pingpong_t ping = {line, method, from, round_trips, 1, cfg};
+    pingpong_t pong = {line, method, to, 0, 0, cfg};
+    pthread_t ping_tid, pong_tid;
+
+    line->flag = 0;
+    line->stop = 0;
+    pthread_create(&pong_tid, NULL, pong_thread, &pong);
+    pthread_create(&ping_tid, NULL, ping_thread, &ping);
+    pthread_join(ping_tid, NULL);
+    pthread_join(pong_tid, NULL);
+
+    *stats = ping.stats;
+    free(line);
+}
+
+// Compare doubles for qsort
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to measure every ordered pair of allowed CPUs and save the NxN matrix, plus one
+// row per pair with its topological relation
+void run_c2c_matrix(int num_cpus, const int *cpus, handshake_t method, long round_trips) {
+    double *matrix = (double *) bench_alloc((size_t)num_cpus * num_cpus * sizeof(double), 64);
+    double *by_relation[CPU_NUM_RELATIONS];
+    int relation_count[CPU_NUM_RELATIONS] = {0};
+    measure_config_t cfg;
+
+    measure_config_default(&cfg, PAIR_TRIALS);
+    for (int r = 0; r < CPU_NUM_RELATIONS; r++) {
+        by_relation[r] = (double *) bench_alloc((size_t)num_cpus * num_cpus * sizeof(double), 64);
+    }
+
+    FILE *pairs_csv = bench_csv_open("c2c_pairs.csv");
+    fprintf(pairs_csv, "# One-way line transfer latency in ns, %s handshake, %ld round trips per trial\n",
+            method == HANDSHAKE_CAS ? "CAS" : "store/load", round_trips);
+    fprintf(pairs_csv, "From CPU,To CPU,Relation,Latency (ns)");
+    measure_write_csv_header(pairs_csv, ",");
+    fprintf(pairs_csv, "\n");
+
+    printf("Core-to-core latency (ns, %s handshake) over %d CPUs\n", method == HANDSHAKE_CAS ? "CAS" : "store/load",
+           num_cpus);
+    for (int i = 0; i < num_cpus; i++) {
+        for (int j = 0; j < num_cpus; j++) {
+            if (i == j) {
+                matrix[i * num_cpus + j] = 0;
+                continue;
+            }
+            measure_stats_t stats;
+            cpu_relation_t rel = cpu_relation(cpus[i], cpus[j]);
+
+            measure_pair(cpus[i], cpus[j], method, round_trips, &cfg, &stats);
+            matrix[i * num_cpus + j] = stats.median;
+            by_relation[rel][relation_count[rel]++] = stats.median;
+
+            fprintf(pairs_csv, "%d,%d,%s,%.2f", cpus[i], cpus[j], cpu_relation_name(rel), stats.median);
+            measure_write_csv_values(pairs_csv, ",", &stats);
+            fprintf(pairs_csv, "\n");
+        }
+    }
+    bench_csv_close(pairs_csv);
+
+    // Print and save the matrix, rows are the initiating CPU
+    FILE *matrix_csv = bench_csv_open("c2c_latency_matrix.csv");
+    fprintf(matrix_csv, "# One-way line transfer latency in ns; rows initiate, columns respond\n");
+    fprintf(matrix_csv, "From \\ To");
+    printf("\n From\\To");
+    for (int j = 0; j < num_cpus; j++) {
+        fprintf(matrix_csv, ",%d", cpus[j]);
+        printf(" %7d", cpus[j]);
+    }
+    fprintf(matrix_csv, "\n");
+    printf("\n");
+    for (int i = 0; i < num_cpus; i++) {
+        fprintf(matrix_csv, "%d", cpus[i]);
+        printf("%8d", cpus[i]);
+        for (int j = 0; j < num_cpus; j++) {
+            if (i == j) {
+                fprintf(matrix_csv, ",");
+                printf(" %7s", "-");
+            } else {
+                fprintf(matrix_csv, ",%.2f", matrix[i * num_cpus + j]);
+                printf(" %7.1f", matrix[i * num_cpus + j]);
+            }
+        }
+        fprintf(matrix_csv, "\n");
+        printf("\n");
+    }
+    bench_csv_close(matrix_csv);
+
+    // Median over the pairs of each relation, to guide thread placement
+    printf("\nMedian latency by relation:\n");
+    for (int r = 0; r < CPU_NUM_RELATIONS; r++) {
+        if (relation_count[r] == 0) {
+            continue;
+        }
+        qsort(by_relation[r], relation_count[r], sizeof(double), compare_double);
+        printf("%-13s: %7.1f ns over %d pair(s)\n", cpu_relation_name((cpu_relation_t)r),
+               by_relation[r][relation_count[r] / 2], relation_count[r]);
+    }
+    for (int r = 0; r < CPU_NUM_RELATIONS; r++) {
+        free(by_relation[r]);
+    }
+    free(matrix);
+
+    printf("\nData has been saved to 'c2c_latency_matrix.csv' and 'c2c_pairs.csv'\n");
+}
+
+// Counters updated by the false-sharing workers; 'stride' is the distance between two
+// workers' counters in uint64_t slots (1 packs them into one line)
+typedef struct {
+    volatile uint64_t *counters;
+    size_t stride;
+    long updates;
+    int atomic;                       // Locked add instead of a plain increment
+} fs_task_t;
+
+// Pool task incrementing this worker's counter
+static void fs_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    fs_task_t *task = (fs_task_t *)arg;
+    volatile uint64_t *counter = &task->counters[thread_id * task->stride];
+    (void)num_threads;
+
+    if (task->atomic) {
+        for (long i = 0; i < task->updates; i++) {
+            __sync_fetch_and_add(counter, 1);
+        }
+    } else {
+        for (long i = 0; i < task->updates; i++) {
+            (*counter)++;
+        }
+    }
+    slot->ops = task->updates;
+}
+
+// State of one repeated false-sharing measurement
+typedef struct {
+    thread_pool_t *pool;
+    int active;
+    fs_task_t *task;
+} fs_round_t;
+
+// Function to run one pool round, returning the wall time per update of one worker in ns
+static double fs_round(void *arg) {
+    fs_round_t *r = (fs_round_t *)arg;
+    return pool_run(r->pool, r->active, fs_task, r->task) / r->task->updates;
+}
+
+// Function to compare counters that share a cache line against padded ones for 1..max_threads workers
+void run_false_sharing(int max_threads, const char *placement, const int *cpus, int num_cpus, long updates,
+                       int atomic) {
+    volatile uint64_t *counters = (volatile uint64_t *) bench_alloc((size_t)max_threads * PAD_BYTES, PAD_BYTES);
+    thread_pool_t *pool = pool_create(max_threads, cpus, num_cpus);
+    fs_task_t task = {counters, 1, updates, atomic};
+    fs_round_t round = {pool, 0, &task};
+    const char *layouts[] = {"packed", "padded"};
+    size_t strides[] = {1, PAD_BYTES / sizeof(uint64_t)};
+    measure_config_t cfg;
+
+    if (num_cpus < max_threads) {
+        printf("Warning: only %d CPU(s) available; workers will share CPUs and hide coherence traffic\n", num_cpus);
+    }
+    measure_config_default(&cfg, FS_TRIALS);
+
+    FILE *csv_file = bench_csv_open("false_sharing.csv");
+    placement_write_header(csv_file, placement, cpus, num_cpus < max_threads ? num_cpus : max_threads);
+    fprintf(csv_file, "# ns per update of one worker (%s), %ld updates per worker per trial\n",
+            atomic ? "locked add" : "plain increment", updates);
+    fprintf(csv_file, "Layout,Threads,Latency (ns/update),Throughput (M updates/s)");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    printf("False sharing (%s): adjacent counters in one line vs %d-byte padded counters\n",
+           atomic ? "locked add" : "plain increment", PAD_BYTES);
+    printf("Threads  |  Packed (ns)  |  Padded (ns)  |  Slowdown\n");
+    printf("-------------------------------------------------\n");
+    for (int n = 1; n <= max_threads; n++) {
+        measure_stats_t stats[2];
+
+        round.active = n;
+        for (int l = 0; l < 2; l++) {
+            task.stride = strides[l];
+            memset((void *)counters, 0, (size_t)max_threads * PAD_BYTES);
+            measure_run(&cfg, fs_round, &round, &stats[l]);
+
+            fprintf(csv_file, "%s,%d,%.3f,%.2f", layouts[l], n, stats[l].median,
+                    stats[l].median > 0 ? n / stats[l].median * 1e3 : 0);
+            measure_write_csv_values(csv_file, ",", &stats[l]);
+            fprintf(csv_file, "\n");
+        }
+        printf("%7d  |  %11.3f  |  %11.3f  |  %7.2fx%s\n", n, stats[0].median, stats[1].median,
+               stats[1].median > 0 ? stats[0].median / stats[1].median : 0,
+               stats[0].unstable || stats[1].unstable ? "  (unstable)" : "");
+    }
+
+    pool_destroy(pool);
+    free((void *)counters);
+    bench_csv_close(csv_file);
+    printf("\nData has been saved to 'false_sharing.csv'\n");
+}
+
+// Entry point of the coherence benchmark (membench coherence)
+int coherence_main(int argc, char *argv[]) {
+    // "matrix" ping-pongs a line between every ordered pair of CPUs; "false-sharing [max threads]"
+    // compares counters packed into one line against padded ones.
+    // Parameters: mode, handshake (store|cas), round_trips, cpus (max CPUs in the matrix),
+    // threads, updates, atomic, placement (false-sharing), plus the repetition parameters of
+    // measure_config_default().
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "matrix");
+    int cpus[MAX_CPUS];
+    int num_cpus = get_allowed_cpus(cpus, MAX_CPUS);
+
+    if (strcmp(mode, "matrix") == 0) {
+        const char *handshake = bench_param_str("handshake", "store");
+        long round_trips = bench_param_long("round_trips", ROUND_TRIPS);
+        int max_cpus = (int)bench_param_long("cpus", num_cpus);
+        if ((strcmp(handshake, "store") != 0 && strcmp(handshake, "cas") != 0) || round_trips <= 0 || max_cpus <= 0) {
+            fprintf(stderr, "Usage: %s matrix [handshake=store|cas] [round_trips=N] [cpus=N]\n", argv[0]);
+            return 1;
+        }
+        if (max_cpus < num_cpus) {
+            num_cpus = max_cpus;
+        }
+        topology_write_header(stdout, get_topology());
+        if (num_cpus < 2) {
+            printf("The core-to-core matrix needs at least 2 CPUs; %d available\n", num_cpus);
+            return 0;
+        }
+        run_c2c_matrix(num_cpus, cpus, strcmp(handshake, "cas") == 0 ? HANDSHAKE_CAS : HANDSHAKE_STORE, round_trips);
+        return 0;
+    }
+    if (strcmp(mode, "false-sharing") == 0) {
+        int max_threads = argc > 2 ? atoi(argv[2]) : (int)bench_param_long("threads", num_cpus > 2 ? num_cpus : 2);
+        long updates = bench_param_long("updates", FS_UPDATES);
+        int atomic = (int)bench_param_long("atomic", 0);
+        if (max_threads <= 0 || max_threads > POOL_MAX_THREADS || updates <= 0) {
+            fprintf(stderr, "Usage: %s false-sharing [max threads]\n", argv[0]);
+            return 1;
+        }
+        const char *placement = bench_param_str("placement", "allowed");
+        num_cpus = get_placement_cpus(placement, cpus, MAX_CPUS);
+        if (num_cpus <= 0) {
+            return 1;
+        }
+        topology_write_header(stdout, get_topology());
+        placement_write_header(stdout, placement, cpus, num_cpus < max_threads ? num_cpus : max_threads);
+        run_false_sharing(max_threads, placement, cpus, num_cpus, updates, atomic);
+        return 0;
+    }
+
+    fprintf(stderr, "Usage: %s [matrix|false-sharing [max threads]]\n", argv[0]);
+    return 1;
+}
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "coherence");
+    return coherence_main(argc, argv);
+}
+#endif
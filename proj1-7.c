@@ -0,0 +1,412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "page_alloc.h"
+#include "pointer_chase.h"
+#include "measure.h"
+
+#define ASSOC_HOPS 200000           // Dependent loads timed per trial at each point
+#define ASSOC_TRIALS 10             // Default cap on repeated trials per point
+#define ASSOC_MIN_WAYS 32           // Smallest default number of addresses per stride
+#define ASSOC_MAX_WAYS 128          // Upper bound on addresses per stride
+#define MAX_STRIDES 32              // Upper bound on strides in the sweep
+#define CLIFF_FACTOR 1.3            // Latency growth, held for two points, that marks a conflict cliff
+#define ALIAS_FACTOR 1.2            // Slowdown over the neighbouring offsets flagged as aliasing
+#define MAX_JUMPS 4                 // Cliffs recorded per stride
+#define NUM_REF_LEVELS 4            // L1d, L2, L3 and main memory
+#define ALIAS_PERIOD 4096           // Address bits compared by the store-to-load disambiguation
+#define ALIAS_BYTES 1024            // Bytes loaded and stored per pass in the aliasing mode
+#define ALIAS_MAX_OFFSET (9 * 1024)  // Default largest store-to-load distance: two aliasing periods
+#define ALIAS_REPEAT 2000           // Passes over the arrays per aliasing trial
+#define ALIAS_TRIALS 20             // Default cap on repeated trials per offset
+#define ALIAS_WINDOW 8              // Offsets on each side whose median is an offset's baseline
+#define SIZE_2MB (2UL * 1024 * 1024)
+#define SIZE_1GB (1024UL * 1024 * 1024)
+
+// A latency cliff in the ways sweep: 'fits' addresses at one stride stay in a level,
+// one more does not
+typedef struct {
+    int fits;
+    double from_ns;
+    double to_ns;
+    int level;                      // Level the addresses fell out of (index into the references)
+} cliff_t;
+
+// State of one repeated chase at a fixed set of addresses
+typedef struct {
+    void **p;
+    long hops;
+} assoc_trial_t;
+
+// Function to time one pass of 'hops' dependent loads, returning ns per hop
+static double assoc_trial(void *arg) {
+    assoc_trial_t *t = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t->p = chase_pointers(t->p, t->hops);  // Storing p keeps the chase live
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return measure_elapsed_ns(&start, &end) / t->hops;
+}
+
+// Function to measure the dependent-load latency of 'ways' addresses 'stride' bytes apart
+double measure_ways_point(void *buffer, size_t stride, int ways, long hops, measure_stats_t *stats) {
+    assoc_trial_t trial = {build_pointer_chain(buffer, stride * ways, stride), hops};
+    measure_config_t cfg;
+
+    measure_config_default(&cfg, ASSOC_TRIALS);
+    measure_run(&cfg, assoc_trial, &trial, stats);
+    return stats->median;
+}
+
+// Nearest reference level to a latency, compared on a log scale
+static int nearest_level(const double *ref_ns, double ns) {
+    int best = 0;
+    for (int l = 1; l < NUM_REF_LEVELS; l++) {
+        if (fabs(log(ns / ref_ns[l])) < fabs(log(ns / ref_ns[best]))) {
+            best = l;
+        }
+    }
+    return best;
+}
+
+// Function to find the cliffs in the latency of one stride as the number of addresses grows.
+// A cliff must persist for the next point too: the first address past a level's ways often
+// spikes once before the replacement policy settles, and that is not a new level.
+int find_cliffs(const double *latency, int max_ways, const double *ref_ns, cliff_t *cliffs) {
+    double plateau = latency[0];
+    int n = 0;
+
+    for (int w = 1; w < max_ways && n < MAX_JUMPS; w++) {
+        double next = w + 1 < max_ways ? latency[w + 1] : latency[w];
+        if (latency[w] > plateau * CLIFF_FACTOR && next > plateau * CLIFF_FACTOR) {
+            cliffs[n].fits = w;  // latency[w] is for w + 1 addresses
+            cliffs[n].from_ns = plateau;
+            cliffs[n].to_ns = latency[w] < next ? latency[w] : next;
+            cliffs[n].level = nearest_level(ref_ns, plateau);
+            plateau = cliffs[n].to_ns;
+            n++;
+        } else if (latency[w] < plateau) {
+            plateau = latency[w];
+        }
+    }
+    return n;
+}
+
+// Function to chase 1..max_ways addresses at each power-of-two stride and infer every level's
+// associativity and set indexing from where the latency jumps. At strides of a multiple of a
+// level's way size (sets x line) all addresses share one set, so the latency leaves that level
+// once there are more addresses than ways; at half that stride the cliff moves to twice the ways.
+void run_ways_sweep(size_t max_stride, int max_ways, long hops) {
+    const topology_t *topo = get_topology();
+    const char *ref_names[NUM_REF_LEVELS] = {"L1d", "L2", "L3", "Memory"};
+    size_t strides[MAX_STRIDES];
+    static double latency[MAX_STRIDES][ASSOC_MAX_WAYS];
+    static measure_stats_t point_stats[MAX_STRIDES][ASSOC_MAX_WAYS];
+    static cliff_t cliffs[MAX_STRIDES][MAX_JUMPS];
+    int num_cliffs[MAX_STRIDES];
+    double ref_ns[NUM_REF_LEVELS];
+    char summary[NUM_REF_LEVELS - 1][256];
+    int num_strides = 0;
+    page_buffer_t buf;
+    page_backing_info_t info;
+    measure_stats_t stats;
+
+    for (size_t s = 2 * (size_t)topo->line_size; s <= max_stride && num_strides < MAX_STRIDES; s *= 2) {
+        strides[num_strides++] = s;
+    }
+
+    // Large pages keep the strides physically contiguous, which physically indexed levels need
+    size_t arena_size = max_stride * max_ways;
+    if (arena_size < topo->l3_size * 4) {
+        arena_size = topo->l3_size * 4;
+    }
+    if (page_alloc(&buf, arena_size, BACKING_HUGETLB_1G) != 0) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(buf.addr, 0, arena_size);
+    page_backing_verify(&buf, &info);
+    size_t page_size = topo->page_sizes[0];
+    if (buf.backing == BACKING_HUGETLB_1G) {
+        page_size = SIZE_1GB;
+    } else if (buf.backing == BACKING_HUGETLB_2M || (buf.backing == BACKING_THP && info.huge_bytes * 2 > info.rss_bytes)) {
+        page_size = SIZE_2MB;
+    }
+    printf("Arena: %zu MB, %s (%zu KB contiguous); strides above that map to arbitrary physical pages\n",
+           arena_size / (1024 * 1024), page_backing_name(buf.backing), page_size / 1024);
+
+    // Reference latency of each level: a chase over half of it (or the whole arena for memory)
+    size_t ref_sizes[NUM_REF_LEVELS] = {topo->l1d_size / 2, topo->l2_size / 2, topo->l3_size / 2, arena_size};
+    printf("Reference latency:");
+    for (int l = 0; l < NUM_REF_LEVELS; l++) {
+        assoc_trial_t trial = {build_pointer_chain(buf.addr, ref_sizes[l], topo->line_size), hops};
+        measure_config_t cfg;
+        measure_config_default(&cfg, ASSOC_TRIALS);
+        measure_run(&cfg, assoc_trial, &trial, &stats);
+        ref_ns[l] = stats.median;
+        printf(" %s %.2f ns%s", ref_names[l], ref_ns[l], l < NUM_REF_LEVELS - 1 ? "," : "\n");
+    }
+
+    printf("\nStride (bytes)  |  Cliffs (addresses that fit: ns before -> after)\n");
+    printf("--------------------------------------------------------------------\n");
+    for (int s = 0; s < num_strides; s++) {
+        for (int w = 0; w < max_ways; w++) {
+            latency[s][w] = measure_ways_point(buf.addr, strides[s], w + 1, hops, &point_stats[s][w]);
+        }
+        num_cliffs[s] = find_cliffs(latency[s], max_ways, ref_ns, cliffs[s]);
+
+        printf("%14zu  |", strides[s]);
+        for (int c = 0; c < num_cliffs[s]; c++) {
+            printf("  %s %d: %.1f -> %.1f", ref_names[cliffs[s][c].level], cliffs[s][c].fits, cliffs[s][c].from_ns,
+                   cliffs[s][c].to_ns);
+        }
+        printf("%s\n", num_cliffs[s] ? "" : "  none");
+    }
+
+    // Per level: the fewest addresses that fit at any stride is the associativity, and the
+    // smallest stride reaching it is the way size. Larger strides that still hit the same cliff
+    // show plain power-of-two set indexing; ones that lose it show hashed or physical indexing.
+    printf("\nInferred cache geometry:\n");
+    for (int l = 0; l < NUM_REF_LEVELS - 1; l++) {
+        int ways = 0, first = -1, same = 0, larger = 0;
+        for (int s = 0; s < num_strides; s++) {
+            for (int c = 0; c < num_cliffs[s]; c++) {
+                if (cliffs[s][c].level == l && (ways == 0 || cliffs[s][c].fits < ways)) {
+                    ways = cliffs[s][c].fits;
+                    first = s;
+                }
+            }
+        }
+        const cache_info_t *advertised = NULL;
+        for (int c = 0; c < topo->num_caches; c++) {
+            if (topo->caches[c].level == l + 1 && strcmp(topo->caches[c].type, "Instruction") != 0) {
+                advertised = &topo->caches[c];
+            }
+        }
+
+        printf("%-4s ", ref_names[l]);
+        if (first < 0) {
+            printf("no conflict cliff up to %d addresses", max_ways);
+            snprintf(summary[l], sizeof(summary[l]), "%s: no conflict cliff up to %d addresses", ref_names[l],
+                     max_ways);
+        } else {
+            for (int s = first + 1; s < num_strides; s++) {
+                larger++;
+                for (int c = 0; c < num_cliffs[s]; c++) {
+                    if (cliffs[s][c].level == l && cliffs[s][c].fits == ways) {
+                        same++;
+                        break;
+                    }
+                }
+            }
+            const char *indexing = larger == 0 ? "indexing not checked (largest stride)"
+                                   : same == larger ? "power-of-two set indexing"
+                                   : "hashed or physically indexed beyond the contiguous pages";
+            printf("%d ways, way size %zu bytes (%zu sets), capacity %zu KB, %s", ways, strides[first],
+                   strides[first] / topo->line_size, ways * strides[first] / 1024, indexing);
+            snprintf(summary[l], sizeof(summary[l]), "%s: %d ways, way size %zu bytes, %s", ref_names[l], ways,
+                     strides[first], indexing);
+        }
+        if (advertised) {
+            printf("; advertised %d ways x %d sets", advertised->ways, advertised->sets);
+        }
+        printf("\n");
+    }
+
+    // The inferred geometry goes above the column header, with the other comment lines
+    FILE *csv_file = bench_csv_open("associativity_sweep.csv");
+    fprintf(csv_file, "# Arena backed by %s; reference latency (ns): L1d %.2f, L2 %.2f, L3 %.2f, Memory %.2f\n",
+            page_backing_name(buf.backing), ref_ns[0], ref_ns[1], ref_ns[2], ref_ns[3]);
+    for (int l = 0; l < NUM_REF_LEVELS - 1; l++) {
+        fprintf(csv_file, "# %s\n", summary[l]);
+    }
+    fprintf(csv_file, "Stride (bytes),Addresses,Latency (ns),Nearest Level");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+    for (int s = 0; s < num_strides; s++) {
+        for (int w = 0; w < max_ways; w++) {
+            fprintf(csv_file, "%zu,%d,%.3f,%s", strides[s], w + 1, latency[s][w],
+                    ref_names[nearest_level(ref_ns, latency[s][w])]);
+            measure_write_csv_values(csv_file, ",", &point_stats[s][w]);
+            fprintf(csv_file, "\n");
+        }
+    }
+    bench_csv_close(csv_file);
+    page_free(&buf);
+    printf("\nSweep data has been saved to 'associativity_sweep.csv'\n");
+}
+
+// One pass of the aliasing kernel: dst[i] is stored after src[i] is loaded, with dst 'offset'
+// bytes above src, so a load can only falsely match stores to earlier elements. src[i] and
+// dst[i - k] share their low 12 address bits when offset mod ALIAS_PERIOD is 8 x k, so at
+// small positive multiples of 8 (4096 x n + 8, + 16, ...) each load looks like it depends
+// on a store still in the store buffer until the full addresses are compared
+__attribute__((optimize("no-tree-vectorize")))
+static uint64_t alias_pass(uint64_t *dst, const uint64_t *src, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = src[i];
+        dst[i] = v + 1;
+        sum += v;
+    }
+    return sum;
+}
+
+// State of one repeated aliasing measurement
+typedef struct {
+    uint64_t *dst;
+    const uint64_t *src;
+    size_t n;
+    volatile uint64_t sink;
+} alias_trial_t;
+
+// Function to time ALIAS_REPEAT passes, returning ns per element
+static double alias_trial(void *arg) {
+    alias_trial_t *t = arg;
+    struct timespec start, end;
+    uint64_t sum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < ALIAS_REPEAT; r++) {
+        sum += alias_pass(t->dst, t->src, t->n);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t->sink = sum;
+    return measure_elapsed_ns(&start, &end) / ((double)ALIAS_REPEAT * t->n);
+}
+
+// Compare doubles for qsort
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to sweep the distance between a loaded and a stored array and report the offsets
+// where loads are falsely held behind stores (4K aliasing), all within L1d
+void run_aliasing_sweep(size_t max_offset, size_t step) {
+    int num_offsets = (int)((max_offset - ALIAS_BYTES) / step) + 1;
+    double *ns = (double *) malloc(num_offsets * sizeof(double));
+    double *baseline = (double *) malloc(num_offsets * sizeof(double));
+    double *window = (double *) malloc((2 * ALIAS_WINDOW + 1) * sizeof(double));
+    char *buffer = (char *) bench_alloc(max_offset + ALIAS_BYTES, ALIAS_PERIOD);
+    measure_stats_t stats;
+    measure_config_t cfg;
+
+    if (!ns || !baseline || !window) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(buffer, 0, max_offset + ALIAS_BYTES);
+    measure_config_default(&cfg, ALIAS_TRIALS);
+
+    // The stored array starts 'offset' bytes above the loaded one and never overlaps it
+    for (int i = 0; i < num_offsets; i++) {
+        size_t offset = ALIAS_BYTES + i * step;
+        alias_trial_t trial = {(uint64_t *)(buffer + offset), (const uint64_t *)buffer, ALIAS_BYTES / sizeof(uint64_t)};
+        measure_run(&cfg, alias_trial, &trial, &stats);
+        ns[i] = stats.median;
+    }
+
+    // Baseline of each offset: the median of its neighbours, so a slow phase of the host
+    // (frequency, a co-tenant) shifts the baseline with it instead of looking like aliasing
+    for (int i = 0; i < num_offsets; i++) {
+        int first = i > ALIAS_WINDOW ? i - ALIAS_WINDOW : 0;
+        int last = i + ALIAS_WINDOW < num_offsets ? i + ALIAS_WINDOW : num_offsets - 1;
+        memcpy(window, ns + first, (last - first + 1) * sizeof(double));
+        qsort(window, last - first + 1, sizeof(double), compare_double);
+        baseline[i] = window[(last - first) / 2];
+    }
+
+    FILE *csv_file = bench_csv_open("aliasing_offsets.csv");
+    fprintf(csv_file, "# %d-byte arrays, loads from the lower one and stores to the upper one; slowdown vs the median of the %d offsets around each\n",
+            ALIAS_BYTES, 2 * ALIAS_WINDOW + 1);
+    fprintf(csv_file, "Offset (bytes),Offset mod %d,ns per Element,Slowdown,Cliff\n", ALIAS_PERIOD);
+
+    printf("Store-to-load offsets slower than %.1fx the neighbouring offsets:\n", ALIAS_FACTOR);
+    int cliffs = 0;
+    for (int i = 0; i < num_offsets; i++) {
+        size_t offset = ALIAS_BYTES + i * step;
+        int cliff = ns[i] > baseline[i] * ALIAS_FACTOR;
+        fprintf(csv_file, "%zu,%zu,%.4f,%.2f,%s\n", offset, offset % ALIAS_PERIOD, ns[i], ns[i] / baseline[i],
+                cliff ? "yes" : "no");
+        if (cliff) {
+            printf("  offset %6zu (mod %d = %4zu): %.3f ns, %.2fx\n", offset, ALIAS_PERIOD, offset % ALIAS_PERIOD,
+                   ns[i], ns[i] / baseline[i]);
+            cliffs++;
+        }
+    }
+    if (cliffs == 0) {
+        printf("  none\n");
+    }
+
+    bench_csv_close(csv_file);
+    free(buffer);
+    free(ns);
+    free(baseline);
+    free(window);
+    printf("\nAliasing data has been saved to 'aliasing_offsets.csv'\n");
+}
+
+// Entry point of the associativity benchmark (membench associativity)
+int associativity_main(int argc, char *argv[]) {
+    // "ways [max stride KB]" chases addresses at power-of-two strides to find each level's
+    // associativity; "aliasing" sweeps store-to-load distances for 4K aliasing.
+    // Parameters: mode, max_stride, max_ways, hops (ways mode), max_offset and step (aliasing
+    // mode), plus the repetition parameters of measure_config_default().
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "ways");
+    const topology_t *topo = get_topology();
+
+    if (strcmp(mode, "ways") == 0) {
+        size_t largest_way = 0;
+        int largest_ways = 0;
+        for (int c = 0; c < topo->num_caches; c++) {
+            const cache_info_t *cache = &topo->caches[c];
+            if (cache->ways > 0 && cache->size / cache->ways > largest_way) {
+                largest_way = cache->size / cache->ways;
+            }
+            if (cache->ways > largest_ways) {
+                largest_ways = cache->ways;
+            }
+        }
+        size_t max_stride = argc > 2 ? strtoull(argv[2], NULL, 10) * 1024
+                                     : bench_param_size("max_stride", largest_way ? 2 * largest_way : SIZE_2MB);
+        int max_ways = (int)bench_param_long("max_ways", 2 * largest_ways > ASSOC_MIN_WAYS ? 2 * largest_ways
+                                                                                           : ASSOC_MIN_WAYS);
+        long hops = bench_param_long("hops", ASSOC_HOPS);
+        if (max_stride < 2 * (size_t)topo->line_size || max_ways < 2 || max_ways > ASSOC_MAX_WAYS || hops <= 0) {
+            fprintf(stderr, "Usage: %s ways [max stride KB] (max_ways 2..%d)\n", argv[0], ASSOC_MAX_WAYS);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_ways_sweep(max_stride, max_ways, hops);
+        return 0;
+    }
+    if (strcmp(mode, "aliasing") == 0) {
+        size_t max_offset = bench_param_size("max_offset", ALIAS_MAX_OFFSET);
+        size_t step = bench_param_size("step", sizeof(uint64_t));
+        if (max_offset < ALIAS_BYTES || step == 0 || step % sizeof(uint64_t) != 0) {
+            fprintf(stderr, "max_offset must be at least %d bytes and step a positive multiple of 8\n", ALIAS_BYTES);
+            return 1;
+        }
+        topology_write_header(stdout, topo);
+        run_aliasing_sweep(max_offset, step);
+        return 0;
+    }
+
+    fprintf(stderr, "Usage: %s [ways [max stride KB]|aliasing]\n", argv[0]);
+    return 1;
+}
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "associativity");
+    return associativity_main(argc, argv);
+}
+#endif
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "affinity.h"
+#include "corunner.h"
+#include "pointer_chase.h"
+#include "bandwidth_kernels.h"
+#include "measure.h"
+
+#define INTERF_HOPS 200000          // Dependent loads timed per latency trial
+#define INTERF_BYTES (64UL << 20)   // Bytes read per bandwidth trial, in repeated passes
+#define INTERF_ELEMENTS (16UL << 20)  // Elements updated per cache-pressure trial, in repeated passes
+#define INTERF_TRIALS 20            // Default cap on repeated trials per probe
+#define INTERF_MEM_SIZE (256UL << 20)  // Default working set of the main-memory probes
+#define MAX_CONDITIONS 16           // Co-runner sets compared in one run
+#define NUM_LEVELS 4                // L1d, L2, L3 and main memory
+#define MULTIPLICATION_CONSTANT 3   // Update of the cache-pressure kernel (as in proj1-4b)
+
+// What a probe measures; each runs the kernel of one of the other experiments
+typedef enum {
+    PROBE_LATENCY,      // Dependent pointer chase (proj1-1), ns per load
+    PROBE_BANDWIDTH,    // Widest read kernel (proj1-2), GB/s
+    PROBE_PRESSURE,     // array[i] *= 3 over the level (proj1-4b), ns per element
+    NUM_PROBE_KINDS
+} probe_kind_t;
+
+static const char *probe_names[NUM_PROBE_KINDS] = {"latency", "bandwidth", "cache-pressure"};
+static const char *probe_units[NUM_PROBE_KINDS] = {"ns per Load", "GB/s", "ns per Element"};
+
+// One probe at one level, with its buffer prepared once and reused under every condition
+typedef struct {
+    probe_kind_t kind;
+    const char *level;
+    size_t size;
+    void *buffer;
+    void **p;                       // Chase position (latency probes)
+    long passes;                    // Passes over the buffer per trial (other probes)
+    const bw_kernel_t *kernel;      // Read kernel (bandwidth probes)
+    double sink;                    // Keeps the checksums live
+} probe_t;
+
+// Function to run one trial of a probe, returning its metric
+static double probe_trial(void *arg) {
+    probe_t *probe = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    switch (probe->kind) {
+        case PROBE_LATENCY:
+            probe->p = chase_pointers(probe->p, INTERF_HOPS);
+            break;
+        case PROBE_BANDWIDTH:
+            for (long r = 0; r < probe->passes; r++) {
+                probe->sink += probe->kernel->fn(NULL, probe->buffer, NULL, probe->size);
+            }
+            break;
+        default: {
+            // Unsigned, so the repeated multiplications wrap instead of overflowing
+            unsigned int *array = probe->buffer;
+            size_t num_elements = probe->size / sizeof(unsigned int);
+            for (long r = 0; r < probe->passes; r++) {
+                for (size_t i = 0; i < num_elements; i++) {
+                    array[i] *= MULTIPLICATION_CONSTANT;
+                }
+            }
+            break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ns = measure_elapsed_ns(&start, &end);
+    switch (probe->kind) {
+        case PROBE_LATENCY:
+            return ns / INTERF_HOPS;
+        case PROBE_BANDWIDTH:
+            return (double)probe->size * probe->passes / ns;
+        default:
+            return ns / ((double)probe->passes * (probe->size / sizeof(unsigned int)));
+    }
+}
+
+// Slowdown of a metric against running alone: time-like metrics grow, bandwidth shrinks
+static double slowdown(probe_kind_t kind, double value, double alone) {
+    return kind == PROBE_BANDWIDTH ? alone / value : value / alone;
+}
+
+// Function to prepare the probes: latency and bandwidth at every level at half its size
+// (the whole working set for memory), cache pressure at the L1d, L2 and L3 sizes
+static int build_probes(probe_t *probes, size_t mem_size) {
+    const topology_t *topo = get_topology();
+    const char *levels[NUM_LEVELS] = {"L1d Cache", "L2 Cache", "L3 Cache", "Main Memory"};
+    size_t half[NUM_LEVELS] = {topo->l1d_size / 2, topo->l2_size / 2, topo->l3_size / 2, mem_size};
+    size_t full[NUM_LEVELS - 1] = {topo->l1d_size, topo->l2_size, topo->l3_size};
+    int n = 0;
+
+    for (int kind = 0; kind < NUM_PROBE_KINDS; kind++) {
+        for (int l = 0; l < NUM_LEVELS; l++) {
+            if (kind == PROBE_PRESSURE && l == NUM_LEVELS - 1) {
+                continue;
+            }
+            probe_t *probe = &probes[n++];
+            memset(probe, 0, sizeof(*probe));
+            probe->kind = (probe_kind_t)kind;
+            probe->level = levels[l];
+            probe->size = kind == PROBE_PRESSURE ? full[l] : half[l];
+            probe->size -= probe->size % BW_BLOCK_BYTES;
+            probe->buffer = bench_alloc(probe->size, BW_ALIGNMENT);
+            memset(probe->buffer, 1, probe->size);
+
+            if (kind == PROBE_LATENCY) {
+                probe->p = build_pointer_chain(probe->buffer, probe->size, topo->line_size);
+            } else if (kind == PROBE_BANDWIDTH) {
+                probe->kernel = bw_best_kernel(BW_READ, 0);
+                probe->passes = INTERF_BYTES / probe->size > 0 ? INTERF_BYTES / probe->size : 1;
+            } else {
+                size_t elements = probe->size / sizeof(unsigned int);
+                probe->passes = INTERF_ELEMENTS / elements > 0 ? INTERF_ELEMENTS / elements : 1;
+            }
+        }
+    }
+    return n;
+}
+
+// Function to measure every probe alone and then under each co-runner set, reporting how
+// much each metric degrades. The measuring thread keeps the first allowed CPU until it
+// returns and the co-runners take the others, highest first. Returns 0, or -1 if a set's
+// co-runners could not start (the rows measured so far are kept).
+int run_interference(const corun_spec_t sets[][CORUN_MAX_SPECS], const int *set_sizes, int num_sets,
+                      size_t mem_size) {
+    probe_t probes[NUM_PROBE_KINDS * NUM_LEVELS];
+    double alone[NUM_PROBE_KINDS * NUM_LEVELS];
+    int cpus[CORUN_MAX_THREADS];
+    int num_cpus = corun_default_cpus(cpus, CORUN_MAX_THREADS);
+    int first, failed = 0;
+    measure_stats_t stats;
+    measure_config_t cfg;
+    char desc[256];
+    cpu_mask_t saved;
+
+    get_allowed_cpus(&first, 1);
+    save_thread_affinity(&saved);
+    pin_thread(first);
+    if (cpus[0] == first) {
+        printf("Only one CPU is available: co-runners time-share it with the probes\n");
+    }
+
+    int num_probes = build_probes(probes, mem_size);
+    measure_config_default(&cfg, INTERF_TRIALS);
+
+    FILE *csv_file = bench_csv_open("interference.csv");
+    fprintf(csv_file, "# Probes on CPU %d, co-runners on %d other CPU(s); slowdown is against the same probe alone\n",
+            first, cpus[0] == first ? 0 : num_cpus);
+    fprintf(csv_file, "Condition,Probe,Level,Size (bytes),Metric,Value,Alone,Slowdown,Degradation (%%)");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    for (int c = -1; c < num_sets; c++) {
+        if (c < 0) {
+            snprintf(desc, sizeof(desc), "alone");
+        } else {
+            corun_describe(sets[c], set_sizes[c], desc, sizeof(desc));
+            if (corun_start(sets[c], set_sizes[c], cpus, num_cpus) < 0) {
+                failed = 1;
+                break;
+            }
+        }
+        printf("\n%s:\n", desc);
+        printf("%-15s %-12s %12s %15s %10s %12s\n", "Probe", "Level", "Size (KB)", "Value", "Slowdown", "Degradation");
+
+        for (int i = 0; i < num_probes; i++) {
+            probe_t *probe = &probes[i];
+            measure_run(&cfg, probe_trial, probe, &stats);
+            if (c < 0) {
+                alone[i] = stats.median;
+            }
+            double factor = slowdown(probe->kind, stats.median, alone[i]);
+
+            printf("%-15s %-12s %12zu %9.3f %-5s %9.2fx %11.1f%%%s\n", probe_names[probe->kind], probe->level,
+                   probe->size / 1024, stats.median, probe->kind == PROBE_BANDWIDTH ? "GB/s" : "ns", factor,
+                   (factor - 1) * 100, stats.unstable ? " UNSTABLE" : "");
+            fprintf(csv_file, "%s,%s,%s,%zu,%s,%.4f,%.4f,%.3f,%.1f", desc, probe_names[probe->kind], probe->level,
+                    probe->size, probe_units[probe->kind], stats.median, alone[i], factor, (factor - 1) * 100);
+            measure_write_csv_values(csv_file, ",", &stats);
+            fprintf(csv_file, "\n");
+        }
+        fflush(stdout);
+        corun_stop();
+    }
+
+    bench_csv_close(csv_file);
+    for (int i = 0; i < num_probes; i++) {
+        free(probes[i].buffer);
+    }
+    restore_thread_affinity(&saved);
+    printf("\nInterference data has been saved to 'interference.csv'\n");
+    return failed ? -1 : 0;
+}
+
+// Entry point of the interference benchmark (membench interference)
+int interference_main(int argc, char *argv[]) {
+    // "[sets]" runs the latency, bandwidth and cache-pressure probes alone and then under each
+    // comma-separated co-runner set (corunner.h syntax, e.g. "llc,stream,llc:8M+writer").
+    // Parameters: antagonists (the sets), corun_threads (threads per co-runner kind when a set
+    // does not say, default one per other CPU), mem_size, plus the repetition parameters of
+    // measure_config_default().
+    const char *list = argc > 1 ? argv[1] : bench_param_str("antagonists", "llc,stream,writer");
+    size_t mem_size = bench_param_size("mem_size", INTERF_MEM_SIZE);
+    int cpus[CORUN_MAX_THREADS];
+    int threads = (int)bench_param_long("corun_threads", corun_default_cpus(cpus, CORUN_MAX_THREADS));
+    corun_spec_t sets[MAX_CONDITIONS][CORUN_MAX_SPECS];
+    int set_sizes[MAX_CONDITIONS];
+    int num_sets = 0;
+    char buf[256];
+    char *save = NULL;
+
+    if (corun_active()) {
+        fprintf(stderr, "interference starts its own co-runners; leave out corunners=\n");
+        return 1;
+    }
+    if (threads <= 0 || mem_size < (size_t)BW_BLOCK_BYTES) {
+        fprintf(stderr, "Usage: %s [set,set,...] (corun_threads > 0)\n", argv[0]);
+        return 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *set = strtok_r(buf, ",", &save); set; set = strtok_r(NULL, ",", &save)) {
+        if (num_sets == MAX_CONDITIONS) {
+            fprintf(stderr, "At most %d co-runner sets\n", MAX_CONDITIONS);
+            return 1;
+        }
+        set_sizes[num_sets] = corun_parse(set, threads, sets[num_sets], CORUN_MAX_SPECS);
+        if (set_sizes[num_sets] < 0) {
+            fprintf(stderr, "Usage: %s [set,set,...], a set being kind[:footprint[:threads]][+...] with kind llc, stream or writer\n",
+                    argv[0]);
+            return 1;
+        }
+        // Every kind of a set gets corun_threads unless it says otherwise, so check the total
+        // before the "alone" pass rather than when the set is started
+        int total = 0;
+        for (int i = 0; i < set_sizes[num_sets]; i++) {
+            total += sets[num_sets][i].threads;
+        }
+        if (total > CORUN_MAX_THREADS) {
+            fprintf(stderr, "Co-runner set '%s' needs %d threads, at most %d; lower corun_threads or give each kind"
+                    " a thread count\n", set, total, CORUN_MAX_THREADS);
+            return 1;
+        }
+        num_sets++;
+    }
+
+    topology_write_header(stdout, get_topology());
+    return run_interference(sets, set_sizes, num_sets, mem_size) == 0 ? 0 : 1;
+}
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "interference");
+    return interference_main(argc, argv);
+}
+#endif
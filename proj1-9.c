@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "bench.h"
+#include "topology.h"
+#include "affinity.h"
+#include "numa.h"
+#include "page_alloc.h"
+#include "pointer_chase.h"
+#include "bandwidth_kernels.h"
+#include "thread_pool.h"
+#include "measure.h"
+
+#define NUMA_HOPS 200000            // Dependent loads timed per latency trial
+#define NUMA_PASSES 2               // Passes over the buffer per bandwidth trial
+#define NUMA_TRIALS 10              // Default cap on repeated trials per cell
+#define NUMA_MIN_SIZE (256UL << 20) // Smallest default buffer: well past any LLC
+#define MAX_POLICIES (NUMA_MAX_NODES + 1)  // One column per memory node, plus interleave
+#define NUM_METRICS 2
+
+static const char *metric_names[NUM_METRICS] = {"Latency (ns)", "Bandwidth (GB/s)"};
+
+// Where a buffer's pages should come from: one node, or interleaved over all of them
+typedef struct {
+    int node;                       // Memory node, or -1 for interleave
+    char name[16];
+} mem_policy_t;
+
+// State of one latency trial on the calling thread
+typedef struct {
+    void **p;
+    long hops;
+} numa_chase_t;
+
+// Shared state of one bandwidth trial: every worker reads its own slice of the buffer
+typedef struct {
+    const char *buffer;
+    size_t slice;
+    int passes;
+    const bw_kernel_t *kernel;
+    double sink[POOL_MAX_THREADS];
+} numa_stream_t;
+
+// Function to time one pass of dependent loads, returning ns per hop
+static double numa_chase_trial(void *arg) {
+    numa_chase_t *t = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t->p = chase_pointers(t->p, t->hops);  // Storing p keeps the chase live
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return measure_elapsed_ns(&start, &end) / t->hops;
+}
+
+// Pool task reading one worker's slice of the buffer
+static void numa_stream_task(int thread_id, int num_threads, void *arg, pool_slot_t *slot) {
+    numa_stream_t *t = (numa_stream_t *)arg;
+    const char *slice = t->buffer + (size_t)thread_id * t->slice;
+    (void)num_threads;
+
+    for (int r = 0; r < t->passes; r++) {
+        t->sink[thread_id] += t->kernel->fn(NULL, slice, NULL, t->slice);
+    }
+    slot->ops = (uint64_t)t->passes * t->slice;
+}
+
+// One bandwidth round: the pool and how many of its workers read
+typedef struct {
+    thread_pool_t *pool;
+    int threads;
+    numa_stream_t *task;
+} numa_stream_round_t;
+
+// Function to run one bandwidth round, returning GB/s over the round's wall clock
+static double numa_stream_trial(void *arg) {
+    numa_stream_round_t *r = arg;
+    double ns = pool_run(r->pool, r->threads, numa_stream_task, r->task);
+    return (double)r->task->slice * r->task->passes * r->threads / ns;
+}
+
+// Function to map a buffer, bind it by the policy and fault it in, reporting where its pages
+// landed as "node:percent ..."; returns 0 on success
+static int map_on_policy(page_buffer_t *buf, size_t size, const mem_policy_t *policy, const int *nodes,
+                         int num_nodes, char *placed, size_t placed_len) {
+    int counts[NUMA_MAX_NODES];
+    int rc;
+
+    // Transparent huge pages keep TLB misses out of the latency where the host allows them
+    if (page_map(buf, size, BACKING_THP, 0) != 0 && page_map(buf, size, BACKING_4K, 0) != 0) {
+        return -1;
+    }
+    rc = policy->node >= 0 ? numa_bind_range(buf->addr, size, policy->node)
+                           : numa_interleave_range(buf->addr, size, nodes, num_nodes);
+    if (rc != 0) {
+        fprintf(stderr, "Warning: mbind for %s failed (%s); pages follow first touch\n", policy->name,
+                strerror(errno));
+    }
+    memset(buf->addr, 1, size);
+
+    int sampled = numa_page_nodes(buf->addr, size, counts, NUMA_MAX_NODES);
+    size_t used = 0;
+    placed[0] = '\0';
+    if (sampled <= 0) {
+        snprintf(placed, placed_len, "unknown");
+        return 0;
+    }
+    for (int n = 0; n < NUMA_MAX_NODES && used < placed_len; n++) {
+        if (counts[n] > 0) {
+            used += snprintf(placed + used, placed_len - used, "%s%d:%.0f%%", used ? " " : "", n,
+                             100.0 * counts[n] / sampled);
+        }
+    }
+    return 0;
+}
+
+// Function to measure dependent-load latency and streaming read bandwidth from every node
+// with CPUs to every node with memory, and to memory interleaved over all nodes. Latency is
+// one thread pinned to the CPU node's first CPU; bandwidth uses up to 'max_threads' of its
+// CPUs, each reading its own slice.
+void run_numa_matrix(size_t size, int max_threads) {
+    const topology_t *topo = get_topology();
+    int nodes[NUMA_MAX_NODES], cpu_nodes[NUMA_MAX_NODES];
+    int num_nodes = numa_memory_nodes(nodes, NUMA_MAX_NODES);
+    int num_cpu_nodes = 0;
+    mem_policy_t policies[MAX_POLICIES];
+    int num_policies = 0;
+    static measure_stats_t stats[NUMA_MAX_NODES][MAX_POLICIES][NUM_METRICS];
+    static char placed[MAX_POLICIES][128];
+    static int threads_used[NUMA_MAX_NODES];
+    static int cpus[POOL_MAX_THREADS];
+    static numa_stream_t stream;
+    measure_config_t cfg;
+    cpu_mask_t saved;
+
+    // The latency trials pin this thread; its mask is put back once the matrix is done
+    save_thread_affinity(&saved);
+
+    for (int n = 0; n < NUMA_MAX_NODES; n++) {
+        if (numa_node_cpus(n, cpus, 1) > 0) {
+            cpu_nodes[num_cpu_nodes++] = n;
+        }
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        policies[num_policies].node = nodes[i];
+        snprintf(policies[num_policies].name, sizeof(policies[num_policies].name), "node %d", nodes[i]);
+        num_policies++;
+    }
+    if (num_nodes > 1) {
+        policies[num_policies].node = -1;
+        snprintf(policies[num_policies].name, sizeof(policies[num_policies].name), "interleave");
+        num_policies++;
+    } else {
+        printf("Single NUMA node: only the local row\n");
+    }
+
+    measure_config_default(&cfg, NUMA_TRIALS);
+    for (int p = 0; p < num_policies; p++) {
+        page_buffer_t buf;
+        if (map_on_policy(&buf, size, &policies[p], nodes, num_nodes, placed[p], sizeof(placed[p])) != 0) {
+            perror("Error mapping the NUMA buffer");
+            exit(EXIT_FAILURE);
+        }
+        printf("Memory on %s (pages %s)\n", policies[p].name, placed[p]);
+        numa_chase_t chase = {build_pointer_chain(buf.addr, size, topo->line_size), NUMA_HOPS};
+
+        for (int c = 0; c < num_cpu_nodes; c++) {
+            int num_cpus = numa_node_cpus(cpu_nodes[c], cpus, max_threads);
+            threads_used[c] = num_cpus;
+            if (num_cpus <= 0) {
+                printf("  CPUs of node %d: none usable, skipped\n", cpu_nodes[c]);
+                continue;
+            }
+            numa_bind_thread(cpu_nodes[c]);
+            pin_thread(cpus[0]);
+            measure_run(&cfg, numa_chase_trial, &chase, &stats[c][p][0]);
+
+            thread_pool_t *pool = pool_create(num_cpus, cpus, num_cpus);
+            stream.buffer = buf.addr;
+            stream.slice = size / num_cpus - size / num_cpus % BW_BLOCK_BYTES;
+            stream.passes = NUMA_PASSES;
+            stream.kernel = bw_best_kernel(BW_READ, 0);
+            numa_stream_round_t round = {pool, num_cpus, &stream};
+            measure_run(&cfg, numa_stream_trial, &round, &stats[c][p][1]);
+            pool_destroy(pool);
+
+            printf("  CPUs of node %d: %.1f ns, %.2f GB/s with %d thread(s)\n", cpu_nodes[c],
+                   stats[c][p][0].median, stats[c][p][1].median, num_cpus);
+        }
+        numa_bind_thread(-1);
+        page_free(&buf);
+    }
+    restore_thread_affinity(&saved);
+
+    FILE *csv_file = bench_csv_open("numa_matrix.csv");
+    fprintf(csv_file, "# %zu MB per buffer; latency from one thread, bandwidth from the CPU node's threads reading"
+            " disjoint slices; relative to the CPU node's own memory\n", size >> 20);
+    fprintf(csv_file, "CPU Node,Memory,Pages on Nodes,Threads,Metric,Value,Relative to Local");
+    measure_write_csv_header(csv_file, ",");
+    fprintf(csv_file, "\n");
+
+    for (int m = 0; m < NUM_METRICS; m++) {
+        printf("\n%s, rows are CPU nodes:\n%8s", metric_names[m], "");
+        for (int p = 0; p < num_policies; p++) {
+            printf(" %12s", policies[p].name);
+        }
+        printf("\n");
+        for (int c = 0; c < num_cpu_nodes; c++) {
+            double local = 0;
+            if (threads_used[c] <= 0) {
+                continue;
+            }
+            for (int p = 0; p < num_policies; p++) {
+                if (policies[p].node == cpu_nodes[c]) {
+                    local = stats[c][p][m].median;
+                }
+            }
+            printf("node %-3d", cpu_nodes[c]);
+            for (int p = 0; p < num_policies; p++) {
+                const measure_stats_t *s = &stats[c][p][m];
+                double relative = local > 0 ? s->median / local : 0;
+                printf(" %12.2f", s->median);
+                fprintf(csv_file, "%d,%s,%s,%d,%s,%.3f,", cpu_nodes[c], policies[p].name, placed[p],
+                        m == 0 ? 1 : threads_used[c], m == 0 ? "latency" : "bandwidth", s->median);
+                if (local > 0) {
+                    fprintf(csv_file, "%.3f", relative);
+                }
+                measure_write_csv_values(csv_file, ",", s);
+                fprintf(csv_file, "\n");
+            }
+            printf("\n");
+        }
+    }
+
+    bench_csv_close(csv_file);
+    printf("\nNUMA data has been saved to 'numa_matrix.csv'\n");
+}
+
+// Entry point of the NUMA benchmark (membench numa)
+int numa_main(int argc, char *argv[]) {
+    // "matrix" measures latency and bandwidth from every CPU node to every memory node and to
+    // interleaved memory. Parameters: mode, size (bytes per buffer, default the larger of 4 x L3
+    // and 256MB), threads (bandwidth threads per node, default all of its CPUs), plus the
+    // repetition parameters of measure_config_default().
+    const char *mode = argc > 1 ? argv[1] : bench_param_str("mode", "matrix");
+    const topology_t *topo = get_topology();
+    size_t size = bench_param_size("size", topo->l3_size * 4 > NUMA_MIN_SIZE ? topo->l3_size * 4 : NUMA_MIN_SIZE);
+    int max_threads = (int)bench_param_long("threads", POOL_MAX_THREADS);
+
+    if (strcmp(mode, "matrix") != 0 || size < (size_t)BW_BLOCK_BYTES * POOL_MAX_THREADS || max_threads <= 0 ||
+        max_threads > POOL_MAX_THREADS) {
+        fprintf(stderr, "Usage: %s [matrix] [size=BYTES] [threads=N]\n", argv[0]);
+        return 1;
+    }
+    topology_write_header(stdout, topo);
+    run_numa_matrix(size, max_threads);
+    return 0;
+}
+
+#ifndef MEMBENCH
+int main(int argc, char *argv[]) {
+    bench_init(&argc, argv, "numa");
+    return numa_main(argc, argv);
+}
+#endif
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "thread_pool.h"
+#include "affinity.h"
+
+#define SPINS_BEFORE_YIELD 4096  // Give the CPU away when spinning this long (oversubscribed hosts)
+
+// One-shot spin barrier, reset by pool_run() before each round; the counter lives on its
+// own cache line
+typedef struct {
+    volatile int count;
+    int total;
+} __attribute__((aligned(64))) spin_barrier_t;
+
+typedef struct {
+    thread_pool_t *pool;
+    int id;
+} worker_arg_t;
+
+struct thread_pool {
+    pthread_t threads[POOL_MAX_THREADS];
+    int cpus[POOL_MAX_THREADS];
+    int num_threads;
+
+    // Round description, published under 'lock' by bumping 'generation'. Idle workers and
+    // the caller block on condition variables so they never steal CPU from active workers;
+    // only the start of a round is a spin barrier.
+    pthread_mutex_t lock;
+    pthread_cond_t round_start;
+    pthread_cond_t round_done;
+    unsigned long generation;
+    int active;
+    int stop;
+    int done;
+    pool_task_fn fn;
+    void *arg;
+
+    spin_barrier_t start_barrier;
+
+    pool_slot_t slots[POOL_MAX_THREADS];
+    worker_arg_t args[POOL_MAX_THREADS];
+};
+
+// Spin with pause, yielding now and then so oversubscribed workers still make progress
+static inline void spin_wait(unsigned long *spins) {
+    __builtin_ia32_pause();
+    if (++*spins % SPINS_BEFORE_YIELD == 0) {
+        sched_yield();
+    }
+}
+
+static void spin_barrier_wait(spin_barrier_t *b) {
+    unsigned long spins = 0;
+    __atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&b->count, __ATOMIC_ACQUIRE) < b->total) {
+        spin_wait(&spins);
+    }
+}
+
+static void *pool_worker(void *arg) {
+    worker_arg_t *w = (worker_arg_t *)arg;
+    thread_pool_t *pool = w->pool;
+    unsigned long seen = 0;
+
+    if (pool->cpus[w->id] >= 0) {
+        pin_thread(pool->cpus[w->id]);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen) {
+            pthread_cond_wait(&pool->round_start, &pool->lock);
+        }
+        seen = pool->generation;
+        int stop = pool->stop;
+        int active = pool->active;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop) {
+            break;
+        }
+        if (w->id >= active) {
+            continue;
+        }
+
+        pool_slot_t *slot = &pool->slots[w->id];
+        spin_barrier_wait(&pool->start_barrier);
+        clock_gettime(CLOCK_MONOTONIC, &slot->start);
+        pool->fn(w->id, active, pool->arg, slot);
+        clock_gettime(CLOCK_MONOTONIC, &slot->end);
+
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->done == active) {
+            pthread_cond_signal(&pool->round_done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+thread_pool_t *pool_create(int num_threads, const int *cpus, int num_cpus) {
+    thread_pool_t *pool = (thread_pool_t *) aligned_alloc(64, sizeof(thread_pool_t));
+    if (!pool || num_threads > POOL_MAX_THREADS) {
+        fprintf(stderr, "Could not create a pool of %d threads\n", num_threads);
+        exit(EXIT_FAILURE);
+    }
+    pool->num_threads = num_threads;
+    pool->generation = 0;
+    pool->active = 0;
+    pool->stop = 0;
+    pool->done = 0;
+    pool->start_barrier.count = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->round_start, NULL);
+    pthread_cond_init(&pool->round_done, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        pool->cpus[i] = num_cpus > 0 ? cpus[i % num_cpus] : -1;
+        pool->args[i].pool = pool;
+        pool->args[i].id = i;
+        pthread_create(&pool->threads[i], NULL, pool_worker, &pool->args[i]);
+    }
+    return pool;
+}
+
+double pool_run(thread_pool_t *pool, int active, pool_task_fn fn, void *arg) {
+    if (active > pool->num_threads) {
+        active = pool->num_threads;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->active = active;
+    pool->done = 0;
+    pool->start_barrier.count = 0;
+    pool->start_barrier.total = active;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->round_start);
+    while (pool->done < active) {
+        pthread_cond_wait(&pool->round_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // Global wall clock: earliest start to latest end across the active workers
+    double first_start = 0, last_end = 0;
+    for (int i = 0; i < active; i++) {
+        double ts = pool->slots[i].start.tv_sec * 1e9 + pool->slots[i].start.tv_nsec;
+        double te = pool->slots[i].end.tv_sec * 1e9 + pool->slots[i].end.tv_nsec;
+        if (i == 0 || ts < first_start) first_start = ts;
+        if (i == 0 || te > last_end) last_end = te;
+    }
+    return last_end - first_start;
+}
+
+const pool_slot_t *pool_slot(const thread_pool_t *pool, int thread_id) {
+    return &pool->slots[thread_id];
+}
+
+void pool_destroy(thread_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->round_start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->round_start);
+    pthread_cond_destroy(&pool->round_done);
+    free(pool);
+}
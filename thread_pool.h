@@ -0,0 +1,36 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define POOL_MAX_THREADS 256  // Upper bound on workers in one pool
+
+// Per-thread result slot, padded to its own cache line so workers never share one
+typedef struct {
+    struct timespec start;    // When the worker left the start barrier
+    struct timespec end;      // When the worker finished its task
+    uint64_t ops;             // Operations the task reports having done
+    double value;             // Free-form result (e.g. a checksum) the task may fill in
+} __attribute__((aligned(64))) pool_slot_t;
+
+// Work run by each active worker in a round; 'slot' is that worker's private result slot
+typedef void (*pool_task_fn)(int thread_id, int num_threads, void *arg, pool_slot_t *slot);
+
+typedef struct thread_pool thread_pool_t;
+
+// Start 'num_threads' workers, worker i pinned to cpus[i % num_cpus] (no pinning if num_cpus is 0).
+// The workers stay alive, blocked between rounds, until pool_destroy().
+thread_pool_t *pool_create(int num_threads, const int *cpus, int num_cpus);
+
+// Run 'fn' on the first 'active' workers. They meet at a spin barrier, stamp their start,
+// run the task and stamp their end. Returns the global wall time in ns from the earliest
+// start to the latest end.
+double pool_run(thread_pool_t *pool, int active, pool_task_fn fn, void *arg);
+
+// Result slot of worker 'thread_id' from the last round
+const pool_slot_t *pool_slot(const thread_pool_t *pool, int thread_id);
+
+void pool_destroy(thread_pool_t *pool);
+
+#endif
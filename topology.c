@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <cpuid.h>
+
+#include "topology.h"
+#include "bench.h"
+
+#define SYSFS_CACHE_DIR "/sys/devices/system/cpu/cpu0/cache"
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+#define SYSFS_HUGEPAGES_DIR "/sys/kernel/mm/hugepages"
+
+// Read a single line from a sysfs file, stripping the trailing newline
+static int read_sysfs_line(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    if (!fgets(buf, (int)len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// Count the CPUs in a list such as "0-3,8-11"
+static int count_cpu_list(const char *list) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        long hi = lo;
+        if (end == p) {
+            break;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+        }
+        count += (int)(hi - lo + 1);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+// Read every cache index of CPU 0 from sysfs
+static int detect_caches_sysfs(topology_t *topo) {
+    char path[256], buf[128];
+
+    for (int i = 0; i < MAX_CACHES; i++) {
+        cache_info_t *c = &topo->caches[topo->num_caches];
+
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/level", i);
+        if (read_sysfs_line(path, buf, sizeof(buf)) != 0) {
+            break;
+        }
+        memset(c, 0, sizeof(*c));
+        c->level = atoi(buf);
+
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/type", i);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            snprintf(c->type, sizeof(c->type), "%.15s", buf);
+        }
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/size", i);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            c->size = bench_parse_size(buf);  // sysfs gives sizes such as "48K" or "32768K"
+        }
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/coherency_line_size", i);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            c->line_size = atoi(buf);
+        }
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/ways_of_associativity", i);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            c->ways = atoi(buf);
+        }
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/number_of_sets", i);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            c->sets = atoi(buf);
+        }
+        snprintf(path, sizeof(path), SYSFS_CACHE_DIR "/index%d/shared_cpu_list", i);
+        if (read_sysfs_line(path, c->shared_cpu_list, sizeof(c->shared_cpu_list)) == 0) {
+            c->num_sharing = count_cpu_list(c->shared_cpu_list);
+        }
+
+        if (c->size > 0) {
+            topo->num_caches++;
+        }
+    }
+    return topo->num_caches;
+}
+
+// Read the deterministic cache parameters leaf (4 on Intel, 0x8000001D on AMD)
+static int detect_caches_cpuid(topology_t *topo) {
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int leaf = 4;
+
+    if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 22))) {
+        leaf = 0x8000001D;  // AMD topology extensions
+    }
+
+    for (unsigned int i = 0; i < MAX_CACHES; i++) {
+        if (!__get_cpuid_count(leaf, i, &eax, &ebx, &ecx, &edx)) {
+            break;
+        }
+        unsigned int type = eax & 0x1f;
+        if (type == 0) {
+            break;
+        }
+
+        cache_info_t *c = &topo->caches[topo->num_caches++];
+        memset(c, 0, sizeof(*c));
+        c->level = (eax >> 5) & 0x7;
+        snprintf(c->type, sizeof(c->type), "%s",
+                 type == 1 ? "Data" : type == 2 ? "Instruction" : "Unified");
+        c->line_size = (ebx & 0xfff) + 1;
+        c->ways = ((ebx >> 22) & 0x3ff) + 1;
+        c->sets = ecx + 1;
+        c->size = (size_t)c->ways * (((ebx >> 12) & 0x3ff) + 1) * c->line_size * c->sets;
+        c->num_sharing = ((eax >> 14) & 0xfff) + 1;
+    }
+    return topo->num_caches;
+}
+
+// Return the TLB slot for a page size, creating it if needed
+static tlb_info_t *tlb_slot(topology_t *topo, size_t page_size) {
+    for (int i = 0; i < topo->num_tlbs; i++) {
+        if (topo->tlbs[i].page_size == page_size) {
+            return &topo->tlbs[i];
+        }
+    }
+    if (topo->num_tlbs == MAX_PAGE_SIZES) {
+        return NULL;
+    }
+    tlb_info_t *t = &topo->tlbs[topo->num_tlbs++];
+    t->page_size = page_size;
+    t->l1_entries = 0;
+    t->l2_entries = 0;
+    return t;
+}
+
+// Read data TLB sizes from CPUID (leaf 0x18 on Intel, 0x80000005/6/19 on AMD)
+static void detect_tlbs_cpuid(topology_t *topo) {
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int max_leaf = __get_cpuid_max(0, NULL);
+    tlb_info_t *t;
+
+    if (max_leaf >= 0x18) {
+        unsigned int max_sub = 0;
+        __get_cpuid_count(0x18, 0, &max_sub, &ebx, &ecx, &edx);
+        for (unsigned int i = 0; i <= max_sub && i < 16; i++) {
+            if (!__get_cpuid_count(0x18, i, &eax, &ebx, &ecx, &edx)) {
+                break;
+            }
+            unsigned int type = edx & 0x1f;
+            unsigned int level = (edx >> 5) & 0x7;
+            // Skip invalid and instruction-only entries
+            if (type == 0 || type == 2) {
+                continue;
+            }
+            int entries = (int)(((ebx >> 16) & 0xffff) * ecx);
+            size_t sizes[] = {4096, 2 * 1024 * 1024, 4 * 1024 * 1024, 1024 * 1024 * 1024};
+            for (int b = 0; b < 4; b++) {
+                if (!(ebx & (1u << b)) || b == 2) {
+                    continue;
+                }
+                if ((t = tlb_slot(topo, sizes[b])) == NULL) {
+                    continue;
+                }
+                // Load-only and store-only entries are reported separately; keep the larger
+                if (level == 1 && entries > t->l1_entries) {
+                    t->l1_entries = entries;
+                } else if (level >= 2 && entries > t->l2_entries) {
+                    t->l2_entries = entries;
+                }
+            }
+        }
+        if (topo->num_tlbs > 0) {
+            return;
+        }
+    }
+
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) && eax >= 0x80000006) {
+        unsigned int max_ext = eax;
+        __get_cpuid(0x80000005, &eax, &ebx, &ecx, &edx);
+        if ((t = tlb_slot(topo, 4096)) != NULL) {
+            t->l1_entries = (ebx >> 16) & 0xff;
+        }
+        if ((t = tlb_slot(topo, 2 * 1024 * 1024)) != NULL) {
+            t->l1_entries = (eax >> 16) & 0xff;
+        }
+        __get_cpuid(0x80000006, &eax, &ebx, &ecx, &edx);
+        if ((t = tlb_slot(topo, 4096)) != NULL) {
+            t->l2_entries = (ebx >> 16) & 0xfff;
+        }
+        if ((t = tlb_slot(topo, 2 * 1024 * 1024)) != NULL) {
+            t->l2_entries = (eax >> 16) & 0xfff;
+        }
+        if (max_ext >= 0x80000019) {
+            __get_cpuid(0x80000019, &eax, &ebx, &ecx, &edx);
+            if ((t = tlb_slot(topo, 1024 * 1024 * 1024)) != NULL) {
+                t->l1_entries = (eax >> 16) & 0xfff;
+                t->l2_entries = (ebx >> 16) & 0xfff;
+            }
+        }
+    }
+}
+
+// List the base page size and every huge page size the kernel exposes
+static void detect_page_sizes(topology_t *topo) {
+    topo->page_sizes[topo->num_page_sizes++] = (size_t)sysconf(_SC_PAGESIZE);
+
+    DIR *dir = opendir(SYSFS_HUGEPAGES_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && topo->num_page_sizes < MAX_PAGE_SIZES) {
+        unsigned long kb;
+        if (sscanf(entry->d_name, "hugepages-%lukB", &kb) == 1) {
+            topo->page_sizes[topo->num_page_sizes++] = (size_t)kb * 1024;
+        }
+    }
+    closedir(dir);
+
+    // Keep huge page sizes in ascending order
+    for (int i = 1; i < topo->num_page_sizes; i++) {
+        for (int j = i + 1; j < topo->num_page_sizes; j++) {
+            if (topo->page_sizes[j] < topo->page_sizes[i]) {
+                size_t tmp = topo->page_sizes[i];
+                topo->page_sizes[i] = topo->page_sizes[j];
+                topo->page_sizes[j] = tmp;
+            }
+        }
+    }
+}
+
+// Read the CPU brand string from CPUID leaves 0x80000002-0x80000004
+static void detect_cpu_model(topology_t *topo) {
+    unsigned int regs[12];
+    snprintf(topo->cpu_model, sizeof(topo->cpu_model), "unknown");
+    for (unsigned int i = 0; i < 3; i++) {
+        if (!__get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3])) {
+            return;
+        }
+    }
+    char brand[49];
+    memcpy(brand, regs, 48);
+    brand[48] = '\0';
+    char *start = brand;
+    while (*start == ' ') {
+        start++;
+    }
+    snprintf(topo->cpu_model, sizeof(topo->cpu_model), "%s", start);
+}
+
+void topology_detect(topology_t *topo) {
+    memset(topo, 0, sizeof(*topo));
+    detect_cpu_model(topo);
+    topo->num_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (detect_caches_sysfs(topo) == 0) {
+        detect_caches_cpuid(topo);
+    }
+    detect_tlbs_cpuid(topo);
+    detect_page_sizes(topo);
+
+    // Pick out the data-side capacity of each level
+    for (int i = 0; i < topo->num_caches; i++) {
+        cache_info_t *c = &topo->caches[i];
+        if (strcmp(c->type, "Instruction") == 0) {
+            continue;
+        }
+        if (c->level == 1) {
+            topo->l1d_size = c->size;
+            topo->line_size = c->line_size;
+        } else if (c->level == 2) {
+            topo->l2_size = c->size;
+        } else if (c->level == 3) {
+            topo->l3_size = c->size;
+        }
+    }
+
+    if (topo->l1d_size == 0) topo->l1d_size = DEFAULT_L1D_SIZE;
+    if (topo->l2_size == 0) topo->l2_size = DEFAULT_L2_SIZE;
+    if (topo->l3_size == 0) topo->l3_size = DEFAULT_L3_SIZE;
+    if (topo->line_size == 0) topo->line_size = DEFAULT_LINE_SIZE;
+}
+
+const topology_t *get_topology(void) {
+    static topology_t topo;
+    static int detected = 0;
+    if (!detected) {
+        topology_detect(&topo);
+        detected = 1;
+    }
+    return &topo;
+}
+
+// Read an integer sysfs attribute of one CPU, or return 'def'
+static int read_cpu_attr(int cpu, const char *attr, int def) {
+    char path[256], buf[64];
+    snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/%s", cpu, attr);
+    return read_sysfs_line(path, buf, sizeof(buf)) == 0 ? atoi(buf) : def;
+}
+
+void get_cpu_location(int cpu, cpu_location_t *loc) {
+    char attr[64], path[256], buf[128];
+    int llc_level = 0;
+
+    loc->package = read_cpu_attr(cpu, "topology/physical_package_id", -1);
+    loc->die = read_cpu_attr(cpu, "topology/die_id", 0);
+    loc->core = read_cpu_attr(cpu, "topology/core_id", -1);
+    loc->llc = -1;
+
+    // The highest-level cache index names the LLC; its first sharing CPU identifies it
+    for (int i = 0; i < MAX_CACHES; i++) {
+        snprintf(attr, sizeof(attr), "cache/index%d/level", i);
+        int level = read_cpu_attr(cpu, attr, -1);
+        if (level < 0) {
+            break;
+        }
+        snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/cache/index%d/shared_cpu_list", cpu, i);
+        if (level >= llc_level && read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            llc_level = level;
+            loc->llc = atoi(buf);
+        }
+    }
+    if (loc->llc < 0) {
+        loc->llc = 1000000 + loc->package;  // One LLC per package when sysfs is silent
+    }
+}
+
+cpu_relation_t cpu_relation(int a, int b) {
+    cpu_location_t la, lb;
+
+    if (a == b) {
+        return CPU_SAME;
+    }
+    get_cpu_location(a, &la);
+    get_cpu_location(b, &lb);
+    if (la.package != lb.package) {
+        return CPU_CROSS_PACKAGE;
+    }
+    if (la.die == lb.die && la.core >= 0 && la.core == lb.core) {
+        return CPU_SMT_SIBLING;
+    }
+    if (la.llc == lb.llc) {
+        return CPU_SAME_LLC;
+    }
+    return CPU_SAME_PACKAGE;
+}
+
+const char *cpu_relation_name(cpu_relation_t relation) {
+    static const char *names[CPU_NUM_RELATIONS] = {
+        "same CPU", "SMT sibling", "same LLC", "cross-LLC", "cross-socket",
+    };
+    return relation < CPU_NUM_RELATIONS ? names[relation] : "?";
+}
+
+void topology_write_header(FILE *out, const topology_t *topo) {
+    fprintf(out, "# CPU: %s (%d logical CPUs)\n", topo->cpu_model, topo->num_cpus);
+    for (int i = 0; i < topo->num_caches; i++) {
+        const cache_info_t *c = &topo->caches[i];
+        fprintf(out, "# L%d %s: %zu KB, %d B line, %d-way, %d sets, shared by %d CPU(s) [%s]\n",
+                c->level, c->type, c->size / 1024, c->line_size, c->ways, c->sets,
+                c->num_sharing, c->shared_cpu_list[0] ? c->shared_cpu_list : "?");
+    }
+    for (int i = 0; i < topo->num_tlbs; i++) {
+        const tlb_info_t *t = &topo->tlbs[i];
+        fprintf(out, "# dTLB %zu KB pages: L1 %d entries, L2 %d entries\n",
+                t->page_size / 1024, t->l1_entries, t->l2_entries);
+    }
+    fprintf(out, "# Page sizes:");
+    for (int i = 0; i < topo->num_page_sizes; i++) {
+        fprintf(out, " %zu KB", topo->page_sizes[i] / 1024);
+    }
+    fprintf(out, "\n");
+}
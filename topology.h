@@ -0,0 +1,91 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define MAX_CACHES 8       // Maximum number of cache indexes tracked per CPU
+#define MAX_PAGE_SIZES 4   // Base page plus up to three huge page sizes
+
+// Fallback values used when neither sysfs nor CPUID report a cache
+#define DEFAULT_L1D_SIZE (48 * 1024)           // 48KB L1d cache
+#define DEFAULT_L2_SIZE  (1280 * 1024)         // 1.25MB L2 cache
+#define DEFAULT_L3_SIZE  (24 * 1024 * 1024)    // 24MB L3 cache
+#define DEFAULT_LINE_SIZE 64                   // 64B cache line
+
+// One cache as seen from CPU 0
+typedef struct {
+    int level;                 // 1, 2, 3, ...
+    char type[16];             // "Data", "Instruction" or "Unified"
+    size_t size;               // Capacity in bytes
+    int line_size;             // Coherency line size in bytes
+    int ways;                  // Ways of associativity
+    int sets;                  // Number of sets
+    int num_sharing;           // Number of logical CPUs sharing this cache
+    char shared_cpu_list[64];  // CPUs sharing this cache, as reported by sysfs
+} cache_info_t;
+
+// Data TLB capacity for one page size
+typedef struct {
+    size_t page_size;          // Page size in bytes
+    int l1_entries;            // First-level dTLB entries (0 if unknown)
+    int l2_entries;            // Second-level (STLB) entries (0 if unknown)
+} tlb_info_t;
+
+// Cache and TLB topology of the host
+typedef struct {
+    char cpu_model[64];
+    int num_cpus;
+
+    cache_info_t caches[MAX_CACHES];
+    int num_caches;
+
+    // Convenience copies of the data-side capacities used to size working sets
+    size_t l1d_size;
+    size_t l2_size;
+    size_t l3_size;
+    int line_size;
+
+    tlb_info_t tlbs[MAX_PAGE_SIZES];
+    int num_tlbs;
+
+    size_t page_sizes[MAX_PAGE_SIZES];  // Base page first, then supported huge pages
+    int num_page_sizes;
+} topology_t;
+
+// Where one logical CPU sits, from /sys/devices/system/cpu/cpuN/topology and its caches
+typedef struct {
+    int package;               // Socket (physical_package_id)
+    int die;                   // Die within the package (die_id, 0 if not reported)
+    int core;                  // Core id within the package; SMT siblings share it
+    int llc;                   // Lowest CPU sharing this CPU's last-level cache (an L3 / CCX id)
+} cpu_location_t;
+
+// How close two logical CPUs are, nearest first
+typedef enum {
+    CPU_SAME,                  // The same logical CPU
+    CPU_SMT_SIBLING,           // Hyperthreads of one physical core
+    CPU_SAME_LLC,              // Different cores sharing the last-level cache (same CCX / die)
+    CPU_SAME_PACKAGE,          // Same socket, different LLC (cross-CCX / cross-die)
+    CPU_CROSS_PACKAGE,         // Different sockets
+    CPU_NUM_RELATIONS
+} cpu_relation_t;
+
+// Detect the host topology once and return the cached result
+const topology_t *get_topology(void);
+
+// Fill in the topology from sysfs, falling back to CPUID and then to the defaults
+void topology_detect(topology_t *topo);
+
+// Location of one logical CPU; package and core are -1 if sysfs does not report them, and
+// without cache information every package counts as one LLC
+void get_cpu_location(int cpu, cpu_location_t *loc);
+
+// Relation between two logical CPUs
+cpu_relation_t cpu_relation(int a, int b);
+const char *cpu_relation_name(cpu_relation_t relation);
+
+// Write the topology as '#'-prefixed comment lines, suitable as a header in output files
+void topology_write_header(FILE *out, const topology_t *topo);
+
+#endif
@@ -0,0 +1,240 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <cpuid.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "tsc.h"
+#include "bench.h"
+
+#define CALIBRATION_NS 10000000     // Length of one calibration window (10ms)
+#define CALIBRATION_RUNS 3          // Windows measured; the median ratio is kept
+#define MSR_MPERF 0xE7              // Counts at the TSC rate while the core is in C0
+#define MSR_APERF 0xE8              // Counts actual core cycles while the core is in C0
+
+static tsc_info_t info;
+static int calibrated = 0;
+
+// Per-thread core-cycle sources, opened on first use by each thread
+static __thread int perf_fd = -2;   // -2 not tried yet, -1 unavailable
+static __thread int msr_fd = -1;
+static __thread int msr_cpu = -1;
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// Open a free-running user-space cycles counter for the calling thread
+static int thread_perf_fd(void) {
+    if (perf_fd == -2) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.pinned = 1;                    // Keep it on the PMU while the counter groups multiplex
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        perf_fd = (int)perf_event_open(&attr, 0, -1, -1, 0);
+    }
+    return perf_fd;
+}
+
+// MSR device of 'cpu', kept open per thread while the thread stays there
+static int thread_msr_fd(int cpu) {
+    if (cpu != msr_cpu) {
+        char path[64];
+        if (msr_fd >= 0) {
+            close(msr_fd);
+        }
+        snprintf(path, sizeof(path), "/dev/cpu/%d/msr", cpu);
+        msr_fd = open(path, O_RDONLY);
+        msr_cpu = cpu;
+    }
+    return msr_fd;
+}
+
+// Read the cycles counter along with the time it has spent enabled but descheduled, which
+// stays constant across a region only if the count covers all of it
+static int read_perf_cycles(uint64_t *value, uint64_t *idle) {
+    uint64_t buf[3];  // value, time enabled, time running
+    if (read(perf_fd, buf, sizeof(buf)) != sizeof(buf)) {
+        return -1;
+    }
+    *value = buf[0];
+    *idle = buf[1] - buf[2];
+    return 0;
+}
+
+static int read_msr(int fd, uint32_t reg, uint64_t *value) {
+    return pread(fd, value, sizeof(*value), reg) == sizeof(*value) ? 0 : -1;
+}
+
+// CPUID leaf 0x80000007 EDX bit 8 (both Intel and AMD)
+static int detect_invariant_tsc(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007 || !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (edx >> 8) & 1;
+}
+
+// Compare doubles for qsort
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// TSC ticks per ns over a few spin windows timed with CLOCK_MONOTONIC_RAW, which is not
+// slewed by NTP
+static double calibrate_ghz(void) {
+    double ratio[CALIBRATION_RUNS];
+    struct timespec start, now;
+
+    for (int r = 0; r < CALIBRATION_RUNS; r++) {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+        uint64_t tsc_start = rdtsc_start();
+        do {
+            clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+        } while (elapsed_ns(&start, &now) < CALIBRATION_NS);
+        uint64_t tsc_end = rdtscp_stop();
+        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+        ratio[r] = (double)(tsc_end - tsc_start) / elapsed_ns(&start, &now);
+    }
+    qsort(ratio, CALIBRATION_RUNS, sizeof(double), compare_double);
+    return ratio[CALIBRATION_RUNS / 2];
+}
+
+const tsc_info_t *get_tsc_info(void) {
+    if (!calibrated) {
+        uint64_t value;
+        info.invariant = detect_invariant_tsc();
+        info.ghz = calibrate_ghz();
+        if (thread_perf_fd() >= 0) {
+            info.core_source = CORE_CYCLES_PERF;
+        } else if (thread_msr_fd(sched_getcpu()) >= 0 && read_msr(msr_fd, MSR_APERF, &value) == 0) {
+            info.core_source = CORE_CYCLES_APERF_MPERF;
+        } else {
+            info.core_source = CORE_CYCLES_NONE;
+        }
+        if (!info.invariant) {
+            fprintf(stderr, "Warning: TSC is not invariant; ns from TSC ticks may drift with the core clock\n");
+        }
+        calibrated = 1;
+    }
+    return &info;
+}
+
+double tsc_to_ns(uint64_t ticks) {
+    return (double)ticks / get_tsc_info()->ghz;
+}
+
+void tsc_region_start(tsc_region_t *region) {
+    const tsc_info_t *ti = get_tsc_info();
+
+    region->core_ok = 0;
+    if (ti->core_source == CORE_CYCLES_PERF && thread_perf_fd() >= 0) {
+        region->core_ok = read_perf_cycles(&region->core, &region->idle) == 0;
+    } else if (ti->core_source == CORE_CYCLES_APERF_MPERF) {
+        region->cpu = sched_getcpu();
+        int fd = thread_msr_fd(region->cpu);
+        region->core_ok = fd >= 0 && read_msr(fd, MSR_APERF, &region->aperf) == 0 &&
+                          read_msr(fd, MSR_MPERF, &region->mperf) == 0;
+    }
+    region->tsc = rdtsc_start();
+}
+
+void tsc_region_stop(const tsc_region_t *region, tsc_sample_t *sample) {
+    uint64_t end = rdtscp_stop();
+    const tsc_info_t *ti = get_tsc_info();
+
+    sample->ticks = end - region->tsc;
+    sample->ns = sample->ticks / ti->ghz;
+    sample->core_cycles = 0;
+    sample->core_valid = 0;
+
+    if (!region->core_ok) {
+        return;
+    }
+    if (ti->core_source == CORE_CYCLES_PERF) {
+        uint64_t core, idle;
+        // Only trust the count if the counter was on the PMU for the whole region
+        if (read_perf_cycles(&core, &idle) == 0 && idle == region->idle) {
+            sample->core_cycles = core - region->core;
+            sample->core_valid = 1;
+        }
+    } else if (ti->core_source == CORE_CYCLES_APERF_MPERF && sched_getcpu() == region->cpu) {
+        uint64_t aperf, mperf;
+        if (read_msr(msr_fd, MSR_APERF, &aperf) == 0 && read_msr(msr_fd, MSR_MPERF, &mperf) == 0 &&
+            mperf > region->mperf) {
+            // MPERF ticks at the TSC rate, so APERF/MPERF is the core clock relative to the TSC
+            sample->core_cycles = (uint64_t)((double)sample->ticks * (aperf - region->aperf) / (mperf - region->mperf));
+            sample->core_valid = 1;
+        }
+    }
+}
+
+void tsc_accumulate(tsc_sample_t *total, const tsc_sample_t *sample) {
+    int first = total->ticks == 0 && total->ns == 0;
+    total->ticks += sample->ticks;
+    total->ns += sample->ns;
+    total->core_cycles += sample->core_cycles;
+    total->core_valid = (first || total->core_valid) && sample->core_valid;
+}
+
+void tsc_cycles_per_op(const tsc_sample_t *total, double ops, tsc_cycles_t *cycles) {
+    cycles->tsc = ops > 0 ? total->ticks / ops : 0;
+    cycles->core = ops > 0 ? total->core_cycles / ops : 0;
+    cycles->core_valid = total->core_valid;
+}
+
+void tsc_cycles_at_ns(const tsc_sample_t *total, double ns, tsc_cycles_t *cycles) {
+    cycles->tsc = ns * get_tsc_info()->ghz;
+    cycles->core = total->ns > 0 ? ns * total->core_cycles / total->ns : 0;
+    cycles->core_valid = total->core_valid;
+}
+
+void tsc_write_csv_header(FILE *out, const char *sep) {
+    fprintf(out, "%sTSC Cycles%sCore Cycles", sep, sep);
+}
+
+void tsc_write_csv_values(FILE *out, const char *sep, const tsc_cycles_t *cycles) {
+    fprintf(out, "%s%.1f%s", sep, cycles->tsc, sep);
+    if (cycles->core_valid) {
+        fprintf(out, "%.1f", cycles->core);
+    }
+}
+
+void tsc_print_cycles(FILE *out, const tsc_cycles_t *cycles) {
+    fprintf(out, "%.1f TSC cycles, ", cycles->tsc);
+    if (cycles->core_valid) {
+        fprintf(out, "%.1f core cycles", cycles->core);
+    } else {
+        fprintf(out, "core cycles n/a");
+    }
+}
+
+const char *core_cycles_source_name(core_cycles_source_t source) {
+    switch (source) {
+    case CORE_CYCLES_PERF:
+        return "perf cycles";
+    case CORE_CYCLES_APERF_MPERF:
+        return "APERF/MPERF";
+    default:
+        return "unavailable";
+    }
+}
+
+void tsc_write_header(FILE *out) {
+    const tsc_info_t *ti = get_tsc_info();
+    fprintf(out, "# TSC: %.3f GHz (%s, calibrated against CLOCK_MONOTONIC_RAW), core cycles from %s\n",
+            ti->ghz, ti->invariant ? "invariant" : "not invariant", core_cycles_source_name(ti->core_source));
+}
@@ -0,0 +1,95 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Serialized cycle count to open a short timed region: the lfence before rdtsc waits for
+// earlier instructions, the one after keeps later instructions from starting early
+static inline uint64_t rdtsc_start(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Serialized cycle count to close a timed region: rdtscp waits for the timed loads to
+// complete and the lfence keeps later instructions out of the region
+static inline uint64_t rdtscp_stop(void) {
+    unsigned int lo, hi, aux;
+    __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi), "=c" (aux) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Where real core cycles come from
+typedef enum {
+    CORE_CYCLES_NONE,
+    CORE_CYCLES_PERF,           // Per-thread perf_event cycles counter (user space only)
+    CORE_CYCLES_APERF_MPERF     // TSC ticks scaled by APERF/MPERF from /dev/cpu/N/msr
+} core_cycles_source_t;
+
+// TSC properties, detected and calibrated once per process
+typedef struct {
+    int invariant;                  // CPUID reports a constant-rate TSC that runs in all C-states
+    double ghz;                     // TSC ticks per ns, calibrated against CLOCK_MONOTONIC_RAW
+    core_cycles_source_t core_source;
+} tsc_info_t;
+
+// One timed region in TSC ticks, ns and core cycles
+typedef struct {
+    uint64_t ticks;
+    double ns;
+    uint64_t core_cycles;
+    int core_valid;                 // 0 if no core-cycle source is available or the thread migrated
+} tsc_sample_t;
+
+// State between tsc_region_start() and tsc_region_stop()
+typedef struct {
+    uint64_t tsc;
+    uint64_t core;
+    uint64_t idle;                  // Time the perf counter had spent descheduled
+    uint64_t aperf, mperf;
+    int cpu;                        // CPU the APERF/MPERF values were read on
+    int core_ok;                    // The start value of the core-cycle source was read
+} tsc_region_t;
+
+// Cycles per operation in TSC ticks and real core cycles
+typedef struct {
+    double tsc;
+    double core;
+    int core_valid;
+} tsc_cycles_t;
+
+// TSC properties, calibrated on the first call (about 30ms)
+const tsc_info_t *get_tsc_info(void);
+
+double tsc_to_ns(uint64_t ticks);
+
+// Open a timed region on the calling thread: read the core-cycle source, then a fenced TSC
+void tsc_region_start(tsc_region_t *region);
+
+// Close the region: fenced rdtscp, then the core-cycle source
+void tsc_region_stop(const tsc_region_t *region, tsc_sample_t *sample);
+
+// Add one region to a running total; the total's core cycles stay valid only if every region's were
+void tsc_accumulate(tsc_sample_t *total, const tsc_sample_t *sample);
+
+// Cycles per operation of a total over 'ops' operations
+void tsc_cycles_per_op(const tsc_sample_t *total, double ops, tsc_cycles_t *cycles);
+
+// Cycles matching 'ns' (e.g. a median ns per op), using the core/ns ratio of the total
+void tsc_cycles_at_ns(const tsc_sample_t *total, double ns, tsc_cycles_t *cycles);
+
+// Append the "TSC Cycles" and "Core Cycles" columns to a CSV header line / row; core cycles
+// are left empty when unavailable
+void tsc_write_csv_header(FILE *out, const char *sep);
+void tsc_write_csv_values(FILE *out, const char *sep, const tsc_cycles_t *cycles);
+
+// Print "X TSC cycles, Y core cycles" (or "core cycles n/a")
+void tsc_print_cycles(FILE *out, const tsc_cycles_t *cycles);
+
+const char *core_cycles_source_name(core_cycles_source_t source);
+
+// Write "# TSC: ..." describing the clock, in the style of the topology header
+void tsc_write_header(FILE *out);
+
+#endif